@@ -8,8 +8,6 @@ the silhouette scores for comparison.
 
 import sys
 import numpy as np
-from sklearn.metrics import silhouette_score
-import kmeans
 import symnmfmodule  # Import the C extension module
 
 # Constants for convergence
@@ -94,23 +92,12 @@ def main():
 
     # --- Perform SymNMF Clustering ---
     try:
-        W = np.array(symnmfmodule.norm(data.tolist()))
-
-        n = data.shape[0]
-        m = np.mean(W)
-        upper_bound = 2 * np.sqrt(m / k)
-        initial_H = np.random.uniform(0, upper_bound, size=(n, k))
-
-        # Optimize H using the C extension
-        final_H = np.array(symnmfmodule.symnmf(initial_H.tolist(), W.tolist()))
+        # Build W, initialize H (seeded like np.random.seed(1234)) and optimize it in C
+        final_H = np.asarray(symnmfmodule.fit(data, k, 1234))
 
         # Assign clusters based on the final H
         symnmf_labels = assign_clusters_symnmf(final_H)
 
-        # Calculate silhouette score for SymNMF
-        # Need at least 2 clusters and more than k data points for silhouette score
-        symnmf_silhouette = silhouette_score(data, symnmf_labels)
-
     except Exception as e:
         # Handle potential errors from C extension calls
         # print(f"Error during SymNMF: {e}") # For debugging
@@ -118,14 +105,24 @@ def main():
         sys.exit(1)
 
     try:
-        labels = kmeans.fit(data, k, MAX_ITER)
-        kmeans_silhouette = silhouette_score(data, labels)
+        # K-means in C, with the first-k initialization and stopping rule of kmeans.fit
+        _, labels = symnmfmodule.kmeans(data, k, MAX_ITER)
 
     except Exception as e:
         # Handle potential errors during K-means
         print("An Error Has Occurred")
         sys.exit(1)
 
+    try:
+        # Score both labelings in C with one pass over the pairwise distances
+        # Need at least 2 clusters and more than k data points for silhouette score
+        symnmf_silhouette, kmeans_silhouette = symnmfmodule.silhouette(data, [symnmf_labels, labels])
+
+    except Exception as e:
+        # Handle labelings that cannot be scored
+        print("An Error Has Occurred")
+        sys.exit(1)
+
     # --- Output Results ---
     # Format output to 4 decimal places
     print(f"nmf: {symnmf_silhouette:.4f}")
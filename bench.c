@@ -0,0 +1,496 @@
+#define _XOPEN_SOURCE 600 /* Required for clock_gettime and getrusage */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> /* Required for strcmp */
+#include <math.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "symnmf.h" /* Include the header file */
+
+/*
+ * Microbenchmark for the matrix multiplication kernel.
+ * Times multiply_matrices_into against the original i-j-l triple loop
+ * on square products and on the tall-skinny W * H shape of optimize_h,
+ * and reports GFLOP/s for both.
+ * Then compares the convergence of the H update engines (see solvers.c)
+ * on the same W and initial H.
+ * Finally times every stage of the dense pipeline on Gaussian blobs of
+ * several sizes, as CSV lines (see bench_stages) for tracking regressions.
+ * Usage: symnmf_bench [gemm | solvers | stages [n d k]]; all suites without
+ * arguments (make bench BENCH_ARGS="stages 4000 10 8" passes arguments).
+ * The cost of the Python bridge is measured by bench_bridge.py.
+ */
+
+/* Minimum wall time in seconds spent timing each kernel */
+#define BENCH_MIN_SECONDS 0.2
+
+/* Helper function to read a monotonic wall clock in seconds */
+static double wall_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* Helper function to fill a matrix with deterministic pseudo-random values in [0, 1) */
+static void fill_matrix(matrix_t *matrix, unsigned long seed)
+{
+    int i, j; /* Declare loop variables at the beginning of the block */
+    for (i = 0; i < matrix->rows; i++)
+    {
+        for (j = 0; j < matrix->cols; j++)
+        {
+            seed = seed * 1103515245UL + 12345UL;
+            MATRIX_AT(matrix, i, j) = (double)((seed >> 16) & 0x7fff) / 32768.0;
+        }
+    }
+}
+
+/* Reference kernel: the original triple loop, striding down B's columns */
+static void multiply_naive(const matrix_t *A, const matrix_t *B, matrix_t *C)
+{
+    double sum;
+    int i, j, l; /* Declare loop variables at the beginning of the block */
+    for (i = 0; i < A->rows; i++)
+    {
+        for (j = 0; j < B->cols; j++)
+        {
+            sum = 0.0;
+            for (l = 0; l < A->cols; l++)
+            {
+                sum += MATRIX_AT(A, i, l) * MATRIX_AT(B, l, j);
+            }
+            MATRIX_AT(C, i, j) = sum;
+        }
+    }
+}
+
+/* Helper function to time a kernel, repeating it until BENCH_MIN_SECONDS have passed
+ * Returns: Seconds per call
+ */
+static double time_kernel(void (*kernel)(const matrix_t *, const matrix_t *, matrix_t *),
+                          const matrix_t *A, const matrix_t *B, matrix_t *C)
+{
+    double start, elapsed;
+    int reps = 0;
+
+    start = wall_time();
+    do
+    {
+        kernel(A, B, C);
+        reps++;
+        elapsed = wall_time() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+    return elapsed / reps;
+}
+
+/* Helper function to benchmark one (m x k) * (k x n) product */
+static void bench_gemm(int m, int k, int n)
+{
+    matrix_t *A, *B, *C_naive, *C_blocked;
+    double t_naive, t_blocked, flops, diff, max_diff = 0.0;
+    int i, j; /* Declare loop variables at the beginning of the block */
+
+    A = allocate_matrix(m, k);
+    B = allocate_matrix(k, n);
+    C_naive = allocate_matrix(m, n);
+    C_blocked = allocate_matrix(m, n);
+    fill_matrix(A, 1UL);
+    fill_matrix(B, 2UL);
+
+    t_naive = time_kernel(multiply_naive, A, B, C_naive);
+    t_blocked = time_kernel(multiply_matrices_into, A, B, C_blocked);
+
+    for (i = 0; i < m; i++)
+    {
+        for (j = 0; j < n; j++)
+        {
+            diff = MATRIX_AT(C_naive, i, j) - MATRIX_AT(C_blocked, i, j);
+            diff = diff < 0 ? -diff : diff;
+            max_diff = diff > max_diff ? diff : max_diff;
+        }
+    }
+
+    flops = 2.0 * m * k * n;
+    printf("%6d %6d %6d %12.3f %12.3f %8.2fx %10.2e\n", m, k, n,
+           flops / t_naive * 1e-9, flops / t_blocked * 1e-9, t_naive / t_blocked, max_diff);
+
+    free_matrix(A);
+    free_matrix(B);
+    free_matrix(C_naive);
+    free_matrix(C_blocked);
+}
+
+/* Helper function to compare the update engines on one clustered data set
+ * Every engine starts from the same H; each run reports its iterations,
+ * whether it met the tolerance, the final objective ||W - H H^T||_F and its time.
+ */
+static void bench_solvers(int n, int d, int k, double epsilon, int max_iter)
+{
+    matrix_t *data, *H, *final_H;
+    packed_matrix_t *W;
+    double *degrees;
+    solver_options_t options;
+    symnmf_stats_t stats;
+    rng_t rng;
+    int i, method; /* Declare loop variables at the beginning of the block */
+
+    /* k well separated groups of points */
+    data = allocate_matrix(n, d);
+    fill_matrix(data, 3UL);
+    for (i = 0; i < n; i++)
+    {
+        MATRIX_AT(data, i, (i % k) % d) += 3.0 * (i % k);
+    }
+    W = calculate_packed_similarity_matrix(data);
+    degrees = calculate_packed_degree_vector(W);
+    normalize_packed_similarity_matrix(W, degrees);
+    free(degrees);
+    rng_seed(&rng, 1234UL);
+    H = initialize_h(n, k, packed_matrix_mean(W), &rng);
+
+    for (method = 0; method < SOLVER_COUNT; method++)
+    {
+        default_solver_options(&options);
+        options.epsilon = epsilon;
+        options.max_iter = max_iter;
+        options.method = method;
+        clear_stats(&stats);
+        final_H = optimize_h_packed_options(H, W, &options, &stats);
+        printf("%6d %4d %8.0e %-15s %6d %9d %12.6f %9.3f\n", n, k, epsilon, solver_method_name(method),
+               stats.iterations, stats.converged, stats.objectives[stats.iterations - 1], stats.optimize_seconds);
+        free_stats(&stats);
+        free_matrix(final_H);
+    }
+
+    free_matrix(H);
+    free_packed_matrix(W);
+    free_matrix(data);
+}
+
+/* Helper function to generate k Gaussian blobs of n points in d dimensions
+ * The centers are uniform in [-10, 10)^d, point i belongs to blob i % k and
+ * has unit variance around its center; the same seed gives the same points.
+ */
+static matrix_t *generate_blobs(int n, int d, int k, unsigned long seed)
+{
+    matrix_t *data, *centers;
+    double radius, angle;
+    rng_t rng;
+    int i, j; /* Declare loop variables at the beginning of the block */
+
+    rng_seed(&rng, seed);
+    centers = allocate_matrix(k, d);
+    for (i = 0; i < k; i++)
+    {
+        for (j = 0; j < d; j++)
+        {
+            MATRIX_AT(centers, i, j) = 20.0 * rng_uniform(&rng) - 10.0;
+        }
+    }
+
+    /* Normal deviates by the Box-Muller transform */
+    data = allocate_matrix(n, d);
+    for (i = 0; i < n; i++)
+    {
+        for (j = 0; j < d; j++)
+        {
+            radius = sqrt(-2.0 * log(1.0 - rng_uniform(&rng)));
+            angle = 2.0 * 3.14159265358979323846 * rng_uniform(&rng);
+            MATRIX_AT(data, i, j) = MATRIX_AT(centers, i % k, j) + radius * cos(angle);
+        }
+    }
+    free_matrix(centers);
+    return data;
+}
+
+/* Helper function to calculate the mean of the elements of a matrix */
+static double matrix_mean(const matrix_t *matrix)
+{
+    double sum = 0.0;
+    int i, j; /* Declare loop variables at the beginning of the block */
+    for (i = 0; i < matrix->rows; i++)
+    {
+        for (j = 0; j < matrix->cols; j++)
+        {
+            sum += MATRIX_AT(matrix, i, j);
+        }
+    }
+    return sum / ((double)matrix->rows * (double)matrix->cols);
+}
+
+/* Inputs and results shared by the stages of bench_stages */
+typedef struct
+{
+    matrix_t *data;       /* Data points (n x d) */
+    matrix_t *A;          /* Similarity matrix */
+    double *degrees;      /* Degree vector */
+    matrix_t *W;          /* Normalized similarity matrix */
+    matrix_t *H;          /* Initial H (n x k) */
+    int iterations;       /* Iterations of the last optimize_h run */
+} stage_context_t;
+
+/* Stage functions: each runs one stage and frees its result */
+static void stage_similarity(stage_context_t *context)
+{
+    free_matrix(calculate_similarity_matrix(context->data));
+}
+
+static void stage_ddg(stage_context_t *context)
+{
+    free_matrix(calculate_ddg_matrix(context->A));
+}
+
+static void stage_norm(stage_context_t *context)
+{
+    free_matrix(calculate_normalized_similarity_matrix(context->A, context->degrees));
+}
+
+static void stage_update_h(stage_context_t *context)
+{
+    free_matrix(update_h_iteration(context->H, context->W));
+}
+
+static void stage_optimize_h(stage_context_t *context)
+{
+    symnmf_stats_t stats;
+
+    clear_stats(&stats);
+    free_matrix(optimize_h_options(context->H, context->W, NULL, &stats));
+    context->iterations = stats.iterations;
+    free_stats(&stats);
+}
+
+/* Helper function to read a memory field of /proc/self/status (Linux)
+ * field: The field name with its colon, e.g. "VmRSS:"
+ * Returns: Kilobytes, or -1 if the field cannot be read
+ */
+static long read_status_kb(const char *field)
+{
+    char line[256];
+    FILE *status;
+    long kb = -1;
+    size_t length = strlen(field);
+
+    status = fopen("/proc/self/status", "r");
+    if (status == NULL)
+        return -1;
+    while (fgets(line, sizeof(line), status) != NULL)
+    {
+        if (strncmp(line, field, length) == 0)
+        {
+            kb = strtol(line + length, NULL, 10);
+            break;
+        }
+    }
+    fclose(status);
+    return kb;
+}
+
+/* Helper function to read the peak resident set size of the process
+ * Returns: Kilobytes (bytes on macOS, where getrusage reports those)
+ */
+static long peak_rss(void)
+{
+    struct rusage usage;
+    long kb;
+
+    kb = read_status_kb("VmHWM:");
+    if (kb >= 0)
+        return kb;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+    return (long)usage.ru_maxrss;
+}
+
+/* Helper function to start measuring the memory a stage adds
+ * On Linux the peak resident set size is reset to the current one (clear_refs),
+ * so the peak read after the stage is the stage's own. Elsewhere the baseline is
+ * the peak so far, and a stage that stays below it reports 0.
+ * Returns: The baseline to pass to stage_rss, in the units of peak_rss
+ */
+static long start_stage_rss(void)
+{
+    FILE *clear_refs;
+    int reset;
+
+    clear_refs = fopen("/proc/self/clear_refs", "w");
+    if (clear_refs != NULL)
+    {
+        reset = fputs("5", clear_refs) >= 0;
+        if (fclose(clear_refs) == 0 && reset)
+            return read_status_kb("VmRSS:");
+    }
+    return peak_rss();
+}
+
+/* Helper function to get the peak resident set size a stage added above its baseline
+ * Returns: The difference, or -1 if either could not be read
+ */
+static long stage_rss(long baseline)
+{
+    long peak = peak_rss();
+
+    if (baseline < 0 || peak < 0)
+        return -1;
+    return peak > baseline ? peak - baseline : 0;
+}
+
+/* Helper function to time a stage, repeating it until BENCH_MIN_SECONDS have passed, and print its CSV line
+ * flops: Floating-point operations of one run, for GFLOP/s
+ * iterations: Value of the iterations column, or -1 to leave it empty
+ */
+static void time_stage(const char *name, void (*stage)(stage_context_t *), stage_context_t *context,
+                       int k, double flops, int *iterations)
+{
+    double start, elapsed;
+    long baseline;
+    int reps = 0;
+
+    baseline = start_stage_rss();
+    start = wall_time();
+    do
+    {
+        stage(context);
+        reps++;
+        elapsed = wall_time() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+    elapsed /= reps;
+
+    printf("%s,%d,%d,%d,%s,%d,%.6f,%.3f,%ld,", name, context->data->rows, context->data->cols, k,
+           matrix_backend_name(), get_thread_count(), elapsed, flops / elapsed * 1e-9, stage_rss(baseline));
+    if (iterations != NULL)
+        printf("%d", *iterations);
+    printf("\n");
+}
+
+/* Helper function to time every stage of the dense pipeline on n points of k blobs in d dimensions
+ * Prints one CSV line per stage: stage,n,d,k,backend,threads,seconds,gflops,stage_peak_rss_kb,iterations
+ * (seconds per run; GFLOP/s from the operation counts of the kernels;
+ * the peak RSS during the stage above the RSS before it; iterations for the H stages only).
+ */
+static void bench_stages(int n, int d, int k)
+{
+    stage_context_t context;
+    rng_t rng;
+    double update_flops;
+    int one = 1;
+
+    context.data = generate_blobs(n, d, k, 1234UL);
+    context.A = calculate_similarity_matrix(context.data);
+    context.degrees = calculate_degree_vector(context.A);
+    context.W = calculate_normalized_similarity_matrix(context.A, context.degrees);
+    rng_seed(&rng, 1234UL);
+    context.H = initialize_h(n, k, matrix_mean(context.W), &rng);
+    context.iterations = 0;
+
+    /* Operation counts: the upper triangle of the distance products, one add
+     * per element for the degrees, two multiplies per element to normalize,
+     * and W * H plus the k x k Gram products per update
+     */
+    update_flops = 2.0 * n * n * k + 4.0 * n * k * k;
+    time_stage("similarity", stage_similarity, &context, k, (double)n * n * d, NULL);
+    time_stage("ddg", stage_ddg, &context, k, (double)n * n, NULL);
+    time_stage("norm", stage_norm, &context, k, 2.0 * n * n, NULL);
+    time_stage("update_h", stage_update_h, &context, k, update_flops, &one);
+    stage_optimize_h(&context); /* Once for the iteration count of the operation count */
+    time_stage("optimize_h", stage_optimize_h, &context, k, update_flops * context.iterations, &context.iterations);
+
+    free_matrix(context.data);
+    free_matrix(context.A);
+    free(context.degrees);
+    free_matrix(context.W);
+    free_matrix(context.H);
+}
+
+/* Helper function to run the GEMM suite */
+static void bench_gemm_suite(void)
+{
+    printf("%6s %6s %6s %12s %12s %9s %10s\n", "m", "k", "n", "naive GF/s", "gemm GF/s", "speedup", "max diff");
+
+    /* Square products */
+    bench_gemm(256, 256, 256);
+    bench_gemm(512, 512, 512);
+    bench_gemm(1024, 1024, 1024);
+
+    /* W * H as computed by optimize_h */
+    bench_gemm(2000, 2000, 3);
+    bench_gemm(2000, 2000, 10);
+    bench_gemm(4000, 4000, 20);
+}
+
+/* Helper function to run the update engine suite */
+static void bench_solvers_suite(void)
+{
+    /* Update engines, at the default and at a tight tolerance */
+    printf("\n%6s %4s %8s %-15s %6s %9s %12s %9s\n", "n", "k", "epsilon", "engine", "iters", "converged",
+           "objective", "seconds");
+    bench_solvers(1000, 4, 5, EPSILON, MAX_ITER);
+    bench_solvers(1000, 4, 5, 1e-9, 1000);
+    bench_solvers(2000, 8, 10, EPSILON, MAX_ITER);
+    bench_solvers(2000, 8, 10, 1e-9, 1000);
+}
+
+/* Helper function to run the stage suite, at the given size or over the default sizes */
+static void bench_stages_suite(int argc, char *argv[])
+{
+    int n, d, k;
+
+    printf("stage,n,d,k,backend,threads,seconds,gflops,stage_peak_rss_kb,iterations\n");
+    if (argc == 5)
+    {
+        n = atoi(argv[2]);
+        d = atoi(argv[3]);
+        k = atoi(argv[4]);
+        if (n < 2 || d < 1 || k < 1 || k >= n)
+        {
+            printf("An Error Has Occurred\n");
+            exit(1);
+        }
+        bench_stages(n, d, k);
+        return;
+    }
+    bench_stages(500, 10, 5);
+    bench_stages(1000, 10, 5);
+    bench_stages(2000, 10, 5);
+    bench_stages(2000, 10, 20);
+}
+
+/* Main function for the benchmark executable */
+int main(int argc, char *argv[])
+{
+    const char *suite = argc > 1 ? argv[1] : "all";
+    int all = strcmp(suite, "all") == 0;
+
+    if (!all && strcmp(suite, "gemm") != 0 && strcmp(suite, "solvers") != 0 && strcmp(suite, "stages") != 0)
+    {
+        printf("An Error Has Occurred\n");
+        return 1;
+    }
+    if (strcmp(suite, "stages") != 0 && argc > 2)
+    {
+        printf("An Error Has Occurred\n");
+        return 1;
+    }
+    if (strcmp(suite, "stages") == 0 && argc != 2 && argc != 5)
+    {
+        printf("An Error Has Occurred\n");
+        return 1;
+    }
+
+    /* The stage suite alone prints nothing but CSV */
+    if (strcmp(suite, "stages") != 0)
+        printf("backend: %s\n", matrix_backend_name());
+    if (all || strcmp(suite, "gemm") == 0)
+        bench_gemm_suite();
+    if (all)
+        printf("\n");
+    if (all || strcmp(suite, "solvers") == 0)
+        bench_solvers_suite();
+    if (all)
+        printf("\n");
+    if (all || strcmp(suite, "stages") == 0)
+        bench_stages_suite(argc, argv);
+
+    return 0;
+}
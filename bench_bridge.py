@@ -0,0 +1,175 @@
+"""
+Benchmark of the Python bridge of the C extension.
+
+Times the same calls with list of lists input (copied into C and back)
+and with NumPy input (used in place, results returned as Matrix buffers),
+and reports the difference as the cost of the conversion. Prints the CSV
+columns of the stage suite of bench.c (symnmf_bench stages).
+
+Usage: python3 bench_bridge.py [n d k]
+"""
+
+import sys
+import time
+import resource
+import numpy as np
+import symnmfmodule  # Import the C extension module
+
+# Minimum wall time in seconds spent timing each call (as in bench.c)
+BENCH_MIN_SECONDS = 0.2
+
+# Default sizes: (n, d, k)
+DEFAULT_SIZES = [(500, 10, 5), (1000, 10, 5), (2000, 10, 5)]
+
+
+def generate_blobs(n, d, k, seed=1234):
+    """
+    Generates k Gaussian blobs of n points in d dimensions.
+
+    The centers are uniform in [-10, 10)^d and point i belongs to blob i % k,
+    with unit variance around its center.
+
+    Returns:
+        np.ndarray: The data points (n x d).
+    """
+    rng = np.random.default_rng(seed)
+    centers = rng.uniform(-10.0, 10.0, size=(k, d))
+    return centers[np.arange(n) % k] + rng.standard_normal((n, d))
+
+
+def read_status_kb(field):
+    """
+    Reads a memory field of /proc/self/status (Linux), e.g. "VmRSS:".
+
+    Returns:
+        int: Kilobytes, or None if the field cannot be read.
+    """
+    try:
+        with open("/proc/self/status") as status:
+            for line in status:
+                if line.startswith(field):
+                    return int(line[len(field):].split()[0])
+    except (OSError, ValueError, IndexError):
+        pass
+    return None
+
+
+def peak_rss():
+    """
+    Reads the peak resident set size of the process.
+
+    Returns:
+        int: Kilobytes (bytes on macOS, where getrusage reports those).
+    """
+    kb = read_status_kb("VmHWM:")
+    if kb is not None:
+        return kb
+    return resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+
+
+def start_stage_rss():
+    """
+    Starts measuring the memory a call adds (as start_stage_rss in bench.c).
+
+    On Linux the peak resident set size is reset to the current one, so the
+    peak read after the call is the call's own. Elsewhere the baseline is the
+    peak so far, and a call that stays below it reports 0.
+
+    Returns:
+        int: The baseline to pass to stage_rss.
+    """
+    try:
+        with open("/proc/self/clear_refs", "w") as clear_refs:
+            clear_refs.write("5")
+        return read_status_kb("VmRSS:")
+    except OSError:
+        return peak_rss()
+
+
+def stage_rss(baseline):
+    """
+    Gets the peak resident set size added above a baseline from start_stage_rss.
+
+    Returns:
+        int: The peak resident set size added above baseline, or None if unknown.
+    """
+    peak = peak_rss()
+    if baseline is None or peak is None:
+        return None
+    return max(peak - baseline, 0)
+
+
+def time_call(call):
+    """
+    Times a call, repeating it until BENCH_MIN_SECONDS have passed.
+
+    Returns:
+        tuple: Seconds per call and the peak RSS the calls added (see stage_rss).
+    """
+    reps = 0
+    baseline = start_stage_rss()
+    start = time.perf_counter()
+    while True:
+        call()
+        reps += 1
+        elapsed = time.perf_counter() - start
+        if elapsed >= BENCH_MIN_SECONDS:
+            return elapsed / reps, stage_rss(baseline)
+
+
+def print_row(stage, n, d, k, seconds, rss_kb):
+    """
+    Prints one CSV line (no GFLOP/s or iterations for the bridge; rss_kb None leaves it empty).
+    """
+    rss = "" if rss_kb is None else rss_kb
+    print(f"{stage},{n},{d},{k},python,{symnmfmodule.get_threads()},{seconds:.6f},,{rss},")
+
+
+def bench_bridge(n, d, k):
+    """
+    Times sym (n x d in, n x n out) and fit (n x d in, n x k out) with both
+    kinds of input, and the conversion of an n x n Matrix to lists.
+    """
+    data = generate_blobs(n, d, k)
+    data_list = data.tolist()
+
+    for name, call_list, call_buffer in [
+        ("sym", lambda: symnmfmodule.sym(data_list), lambda: symnmfmodule.sym(data)),
+        ("fit", lambda: symnmfmodule.fit(data_list, k, max_iter=1), lambda: symnmfmodule.fit(data, k, max_iter=1)),
+    ]:
+        seconds_list, rss_list = time_call(call_list)
+        seconds_buffer, rss_buffer = time_call(call_buffer)
+        print_row(f"bridge_{name}_list", n, d, k, seconds_list, rss_list)
+        print_row(f"bridge_{name}_buffer", n, d, k, seconds_buffer, rss_buffer)
+        print_row(f"bridge_{name}_conversion", n, d, k, max(seconds_list - seconds_buffer, 0.0), None)
+
+    matrix = symnmfmodule.sym(data)
+    print_row("bridge_tolist", n, d, k, *time_call(matrix.tolist))
+
+
+def main():
+    """
+    Runs the benchmark at the given size or over the default sizes.
+    """
+    if len(sys.argv) == 4:
+        try:
+            sizes = [tuple(int(arg) for arg in sys.argv[1:])]
+        except ValueError:
+            print("An Error Has Occurred")
+            sys.exit(1)
+    elif len(sys.argv) == 1:
+        sizes = DEFAULT_SIZES
+    else:
+        print("An Error Has Occurred")
+        sys.exit(1)
+
+    print("stage,n,d,k,backend,threads,seconds,gflops,stage_peak_rss_kb,iterations")
+    for n, d, k in sizes:
+        if not (1 <= k < n and d >= 1):
+            print("An Error Has Occurred")
+            sys.exit(1)
+        bench_bridge(n, d, k)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,671 @@
+#define _POSIX_C_SOURCE 200112L /* Required for the pthread keys */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> /* Required for memset */
+#include <math.h>   /* Required for exp */
+#include "symnmf.h" /* Include the header file */
+
+#ifdef SYMNMF_USE_CBLAS
+#include <cblas.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+ * Matrix product backends behind multiply_matrices, the Gram matrix and W * H.
+ * When built with SYMNMF_USE_CBLAS the products go to an external CBLAS
+ * (dgemm, dsyrk, dsymm); otherwise the built-in kernels below are used.
+ *
+ * Built-in GEMM:
+ * B is packed into zero-padded GEMM_NR-wide column panels of GEMM_KC rows,
+ * and a GEMM_MR x GEMM_NR micro-kernel accumulates one tile of C while
+ * streaming GEMM_MR rows of A directly from their (contiguous) storage.
+ * The packing buffer is allocated once per thread, reused by every product
+ * and freed when the thread exits.
+ * A is deliberately not packed: in W * H the product is bound by reading W,
+ * and copying it every iteration would double that traffic.
+ * The micro-kernel is chosen once at runtime (AVX-512, AVX2/FMA or scalar).
+ * In the OpenMP build the GEMM_MR row slivers of A are shared out between
+ * threads, so every element of C is still summed in the same order.
+ *
+ * Also holds the vectorized exponential used to build the similarity matrix.
+ */
+
+/* Micro-kernel tile: rows of A and columns of B handled per call */
+#define GEMM_MR 6
+#define GEMM_NR 8
+
+/* Depth of a packed B panel (rows of B per pass) */
+#define GEMM_KC 256
+
+/* Width of the packed B block (columns of B per pass), a multiple of GEMM_NR */
+#define GEMM_NC 256
+
+/* Fewest multiply-adds (m * k * n) for which a product is split across threads */
+#define GEMM_PARALLEL_MIN_WORK 262144.0
+
+/* Per-thread storage for the packed B block kept between products (POSIX threads) */
+#if defined(__unix__) || defined(__APPLE__)
+#define GEMM_THREAD_KEY 1
+#include <pthread.h>
+#endif
+
+/* Intrinsic kernels need GCC-style target attributes on x86 */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define GEMM_HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+/* Micro-kernel contract: c[GEMM_MR x GEMM_NR] += a[GEMM_MR x kc] * b[kc x GEMM_NR]
+ * a: First row of the A sliver, rows lda elements apart
+ * b: Packed B panel, GEMM_NR consecutive elements per step of the depth
+ * c: C tile, rows ldc elements apart
+ */
+typedef void (*gemm_kernel_fn)(int kc, const double *a, size_t lda, const double *b, double *c, size_t ldc);
+
+/* Portable micro-kernel */
+static void gemm_kernel_scalar(int kc, const double *a, size_t lda, const double *b, double *c, size_t ldc)
+{
+    double acc[GEMM_MR * GEMM_NR], a_val;
+    const double *b_row;
+    int p, r, j; /* Declare loop variables at the beginning of the block */
+
+    memset(acc, 0, sizeof(acc));
+    for (p = 0; p < kc; p++)
+    {
+        b_row = b + (size_t)p * GEMM_NR;
+        for (r = 0; r < GEMM_MR; r++)
+        {
+            a_val = a[r * lda + p];
+            for (j = 0; j < GEMM_NR; j++)
+            {
+                acc[r * GEMM_NR + j] += a_val * b_row[j];
+            }
+        }
+    }
+    for (r = 0; r < GEMM_MR; r++)
+    {
+        for (j = 0; j < GEMM_NR; j++)
+        {
+            c[r * ldc + j] += acc[r * GEMM_NR + j];
+        }
+    }
+}
+
+#ifdef GEMM_HAVE_X86_KERNELS
+
+/* AVX2/FMA micro-kernel: each row of the tile lives in two ymm registers */
+__attribute__((target("avx2,fma")))
+static void gemm_kernel_avx2(int kc, const double *a, size_t lda, const double *b, double *c, size_t ldc)
+{
+    __m256d c00, c01, c10, c11, c20, c21, c30, c31, c40, c41, c50, c51;
+    __m256d b0, b1, a_val;
+    const double *a0 = a, *a1 = a + lda, *a2 = a + 2 * lda;
+    const double *a3 = a + 3 * lda, *a4 = a + 4 * lda, *a5 = a + 5 * lda;
+    int p; /* Declare loop variable at the beginning of the block */
+
+    c00 = c01 = c10 = c11 = c20 = c21 = _mm256_setzero_pd();
+    c30 = c31 = c40 = c41 = c50 = c51 = _mm256_setzero_pd();
+    for (p = 0; p < kc; p++)
+    {
+        b0 = _mm256_load_pd(b);
+        b1 = _mm256_load_pd(b + 4);
+        b += GEMM_NR;
+        a_val = _mm256_broadcast_sd(a0 + p);
+        c00 = _mm256_fmadd_pd(a_val, b0, c00);
+        c01 = _mm256_fmadd_pd(a_val, b1, c01);
+        a_val = _mm256_broadcast_sd(a1 + p);
+        c10 = _mm256_fmadd_pd(a_val, b0, c10);
+        c11 = _mm256_fmadd_pd(a_val, b1, c11);
+        a_val = _mm256_broadcast_sd(a2 + p);
+        c20 = _mm256_fmadd_pd(a_val, b0, c20);
+        c21 = _mm256_fmadd_pd(a_val, b1, c21);
+        a_val = _mm256_broadcast_sd(a3 + p);
+        c30 = _mm256_fmadd_pd(a_val, b0, c30);
+        c31 = _mm256_fmadd_pd(a_val, b1, c31);
+        a_val = _mm256_broadcast_sd(a4 + p);
+        c40 = _mm256_fmadd_pd(a_val, b0, c40);
+        c41 = _mm256_fmadd_pd(a_val, b1, c41);
+        a_val = _mm256_broadcast_sd(a5 + p);
+        c50 = _mm256_fmadd_pd(a_val, b0, c50);
+        c51 = _mm256_fmadd_pd(a_val, b1, c51);
+    }
+
+#define GEMM_AVX2_STORE(row, lo, hi)                                                         \
+    _mm256_storeu_pd(c + (row) * ldc, _mm256_add_pd(_mm256_loadu_pd(c + (row) * ldc), lo)); \
+    _mm256_storeu_pd(c + (row) * ldc + 4, _mm256_add_pd(_mm256_loadu_pd(c + (row) * ldc + 4), hi))
+
+    GEMM_AVX2_STORE(0, c00, c01);
+    GEMM_AVX2_STORE(1, c10, c11);
+    GEMM_AVX2_STORE(2, c20, c21);
+    GEMM_AVX2_STORE(3, c30, c31);
+    GEMM_AVX2_STORE(4, c40, c41);
+    GEMM_AVX2_STORE(5, c50, c51);
+
+#undef GEMM_AVX2_STORE
+}
+
+/* AVX-512 micro-kernel: each row of the tile lives in one zmm register */
+__attribute__((target("avx512f")))
+static void gemm_kernel_avx512(int kc, const double *a, size_t lda, const double *b, double *c, size_t ldc)
+{
+    __m512d c0, c1, c2, c3, c4, c5, b0;
+    const double *a0 = a, *a1 = a + lda, *a2 = a + 2 * lda;
+    const double *a3 = a + 3 * lda, *a4 = a + 4 * lda, *a5 = a + 5 * lda;
+    int p; /* Declare loop variable at the beginning of the block */
+
+    c0 = c1 = c2 = c3 = c4 = c5 = _mm512_setzero_pd();
+    for (p = 0; p < kc; p++)
+    {
+        b0 = _mm512_load_pd(b);
+        b += GEMM_NR;
+        c0 = _mm512_fmadd_pd(_mm512_set1_pd(a0[p]), b0, c0);
+        c1 = _mm512_fmadd_pd(_mm512_set1_pd(a1[p]), b0, c1);
+        c2 = _mm512_fmadd_pd(_mm512_set1_pd(a2[p]), b0, c2);
+        c3 = _mm512_fmadd_pd(_mm512_set1_pd(a3[p]), b0, c3);
+        c4 = _mm512_fmadd_pd(_mm512_set1_pd(a4[p]), b0, c4);
+        c5 = _mm512_fmadd_pd(_mm512_set1_pd(a5[p]), b0, c5);
+    }
+    _mm512_storeu_pd(c, _mm512_add_pd(_mm512_loadu_pd(c), c0));
+    _mm512_storeu_pd(c + ldc, _mm512_add_pd(_mm512_loadu_pd(c + ldc), c1));
+    _mm512_storeu_pd(c + 2 * ldc, _mm512_add_pd(_mm512_loadu_pd(c + 2 * ldc), c2));
+    _mm512_storeu_pd(c + 3 * ldc, _mm512_add_pd(_mm512_loadu_pd(c + 3 * ldc), c3));
+    _mm512_storeu_pd(c + 4 * ldc, _mm512_add_pd(_mm512_loadu_pd(c + 4 * ldc), c4));
+    _mm512_storeu_pd(c + 5 * ldc, _mm512_add_pd(_mm512_loadu_pd(c + 5 * ldc), c5));
+}
+
+#endif /* GEMM_HAVE_X86_KERNELS */
+
+/* Selected micro-kernel and its name (chosen on first use) */
+static gemm_kernel_fn selected_kernel = NULL;
+static const char *selected_kernel_name = "scalar";
+
+/* Helper function to pick the widest micro-kernel the CPU supports */
+static gemm_kernel_fn select_gemm_kernel(void)
+{
+    gemm_kernel_fn kernel = gemm_kernel_scalar;
+    const char *name = "scalar";
+
+    if (selected_kernel != NULL)
+        return selected_kernel;
+#ifdef GEMM_HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        kernel = gemm_kernel_avx512;
+        name = "avx512";
+    }
+    else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        kernel = gemm_kernel_avx2;
+        name = "avx2";
+    }
+#endif
+    selected_kernel_name = name;
+    selected_kernel = kernel;
+    return kernel;
+}
+
+/* Helper function to report which micro-kernel multiply_matrices uses */
+const char *gemm_kernel_name(void)
+{
+    select_gemm_kernel();
+    return selected_kernel_name;
+}
+
+#ifndef SYMNMF_USE_CBLAS
+/* Helper function to pack B[pc:pc+kc, jc:jc+nc] into GEMM_NR-wide panels
+ * The panel for columns jc+q .. jc+q+GEMM_NR-1 is stored as kc rows of GEMM_NR values,
+ * with the columns past the edge of B filled with zeros.
+ */
+static void pack_b_block(const matrix_t *B, int pc, int kc, int jc, int nc, double *packed)
+{
+    const double *b_row;
+    double *dst;
+    int q, p, j, width; /* Declare loop variables at the beginning of the block */
+
+    for (q = 0; q < nc; q += GEMM_NR)
+    {
+        width = nc - q < GEMM_NR ? nc - q : GEMM_NR;
+        dst = packed + (size_t)q * kc;
+        for (p = 0; p < kc; p++)
+        {
+            b_row = MATRIX_ROW(B, pc + p) + jc + q;
+            for (j = 0; j < width; j++)
+            {
+                dst[j] = b_row[j];
+            }
+            for (; j < GEMM_NR; j++)
+            {
+                dst[j] = 0.0;
+            }
+            dst += GEMM_NR;
+        }
+    }
+}
+
+#ifdef GEMM_THREAD_KEY
+/* Key of the packed B block of each thread; the block is freed when its thread exits */
+static pthread_key_t packed_block_key;
+static pthread_once_t packed_block_once = PTHREAD_ONCE_INIT;
+static int packed_block_key_ready = 0;
+
+/* Helper function to create the key of the per-thread packed B blocks */
+static void create_packed_block_key(void)
+{
+    packed_block_key_ready = pthread_key_create(&packed_block_key, free) == 0;
+}
+#endif
+
+/* Helper function to get an aligned buffer for a GEMM_KC x GEMM_NC packed B block
+ * The block is allocated on the first product of a thread and reused by the next ones.
+ * block: Set to the allocation to free, or NULL when the buffer is kept by the thread
+ */
+static double *packed_b_buffer(double **block)
+{
+    double *buffer = NULL;
+
+    *block = NULL;
+#ifdef GEMM_THREAD_KEY
+    pthread_once(&packed_block_once, create_packed_block_key);
+    if (packed_block_key_ready)
+        buffer = (double *)pthread_getspecific(packed_block_key);
+#endif
+    if (buffer == NULL)
+    {
+        /* Every element is written by pack_b_block before it is read, so no zeroing */
+        buffer = (double *)malloc((size_t)GEMM_KC * GEMM_NC * sizeof(double) + MATRIX_ALIGNMENT);
+        if (buffer == NULL)
+        {
+            printf("An Error Has Occurred\n");
+            exit(1);
+        }
+        *block = buffer;
+#ifdef GEMM_THREAD_KEY
+        /* Handed over to the thread, which frees it on exit */
+        if (packed_block_key_ready && pthread_setspecific(packed_block_key, buffer) == 0)
+            *block = NULL;
+#endif
+    }
+    /* Align the packed panels so the kernels can use aligned loads */
+    return (double *)((char *)buffer + (MATRIX_ALIGNMENT - (size_t)buffer % MATRIX_ALIGNMENT) % MATRIX_ALIGNMENT);
+}
+
+/* Helper function to calculate C += A * B with the built-in blocked kernel */
+static void gemm_builtin(const matrix_t *A, const matrix_t *B, matrix_t *C)
+{
+    gemm_kernel_fn kernel;
+    double *packed_block, *packed, a_edge[GEMM_MR * GEMM_KC], c_edge[GEMM_MR * GEMM_NR];
+    const double *a_tile;
+    double *c_tile;
+    size_t lda, ldc;
+    int m = A->rows, k = A->cols, n = B->cols;
+    int jc, pc, ic, jr, nc, kc, mr, nr, r, j; /* Declare loop variables at the beginning of the block */
+
+    kernel = select_gemm_kernel();
+    packed = packed_b_buffer(&packed_block);
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(get_thread_count()) if (m >= PARALLEL_MIN_ROWS && (double)m * k * n >= GEMM_PARALLEL_MIN_WORK) \
+    private(a_edge, c_edge, a_tile, c_tile, lda, ldc, jc, pc, ic, jr, nc, kc, mr, nr, r, j)
+#endif
+    {
+        for (jc = 0; jc < n; jc += GEMM_NC)
+        {
+            nc = n - jc < GEMM_NC ? n - jc : GEMM_NC;
+            for (pc = 0; pc < k; pc += GEMM_KC)
+            {
+                kc = k - pc < GEMM_KC ? k - pc : GEMM_KC;
+                /* One thread packs B; the others wait for it at the end of the single */
+#ifdef _OPENMP
+#pragma omp single
+#endif
+                pack_b_block(B, pc, kc, jc, nc, packed);
+
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+                for (ic = 0; ic < m; ic += GEMM_MR)
+                {
+                    mr = m - ic < GEMM_MR ? m - ic : GEMM_MR;
+                    a_tile = MATRIX_ROW(A, ic) + pc;
+                    lda = (size_t)A->stride;
+                    if (mr < GEMM_MR)
+                    {
+                        /* Copy the last rows of A into a zero-padded sliver */
+                        memset(a_edge, 0, GEMM_MR * GEMM_KC * sizeof(double));
+                        for (r = 0; r < mr; r++)
+                        {
+                            memcpy(a_edge + r * GEMM_KC, MATRIX_ROW(A, ic + r) + pc, (size_t)kc * sizeof(double));
+                        }
+                        a_tile = a_edge;
+                        lda = GEMM_KC;
+                    }
+
+                    for (jr = 0; jr < nc; jr += GEMM_NR)
+                    {
+                        nr = nc - jr < GEMM_NR ? nc - jr : GEMM_NR;
+                        c_tile = MATRIX_ROW(C, ic) + jc + jr;
+                        ldc = (size_t)C->stride;
+                        if (mr == GEMM_MR && nr == GEMM_NR)
+                        {
+                            kernel(kc, a_tile, lda, packed + (size_t)jr * kc, c_tile, ldc);
+                            continue;
+                        }
+
+                        /* Edge tile: run the kernel on a scratch tile, keep the valid part */
+                        memset(c_edge, 0, sizeof(c_edge));
+                        kernel(kc, a_tile, lda, packed + (size_t)jr * kc, c_edge, GEMM_NR);
+                        for (r = 0; r < mr; r++)
+                        {
+                            for (j = 0; j < nr; j++)
+                            {
+                                c_tile[r * ldc + j] += c_edge[r * GEMM_NR + j];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    free(packed_block);
+}
+#endif /* SYMNMF_USE_CBLAS */
+
+/* Helper function to zero every element of a matrix */
+static void zero_matrix(matrix_t *matrix)
+{
+    int i; /* Declare loop variable at the beginning of the block */
+    for (i = 0; i < matrix->rows; i++)
+    {
+        memset(MATRIX_ROW(matrix, i), 0, (size_t)matrix->cols * sizeof(double));
+    }
+}
+
+/* Helper function to name the backend used for matrix products */
+const char *matrix_backend_name(void)
+{
+#ifdef SYMNMF_USE_CBLAS
+    return "cblas";
+#else
+    return gemm_kernel_name();
+#endif
+}
+
+/* Helper function to calculate C += A * B into an existing matrix */
+void multiply_matrices_accumulate(const matrix_t *A, const matrix_t *B, matrix_t *C)
+{
+    /* Check if multiplication is possible */
+    if (A->cols != B->rows || C->rows != A->rows || C->cols != B->cols)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+
+    if (A->rows == 0 || A->cols == 0 || B->cols == 0)
+        return;
+
+#ifdef SYMNMF_USE_CBLAS
+    cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, A->rows, B->cols, A->cols,
+                1.0, A->data, A->stride, B->data, B->stride, 1.0, C->data, C->stride);
+#else
+    gemm_builtin(A, B, C);
+#endif
+}
+
+/* Helper function to calculate C = A * B into an existing matrix */
+void multiply_matrices_into(const matrix_t *A, const matrix_t *B, matrix_t *C)
+{
+    zero_matrix(C);
+    multiply_matrices_accumulate(A, B, C);
+}
+
+/* Helper function to calculate C = W * H for a symmetric W into an existing matrix */
+void multiply_symmetric_into(const matrix_t *W, const matrix_t *H, matrix_t *C)
+{
+#ifdef SYMNMF_USE_CBLAS
+    /* Check if multiplication is possible */
+    if (W->rows != W->cols || W->cols != H->rows || C->rows != W->rows || C->cols != H->cols)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+
+    zero_matrix(C);
+    if (W->rows == 0 || H->cols == 0)
+        return;
+
+    cblas_dsymm(CblasRowMajor, CblasLeft, CblasUpper, W->rows, H->cols,
+                1.0, W->data, W->stride, H->data, H->stride, 0.0, C->data, C->stride);
+#else
+    /* The built-in kernel streams all of W either way */
+    multiply_matrices_into(W, H, C);
+#endif
+}
+
+/* Helper function to calculate the Gram matrix G = H^T * H into an existing matrix
+ * The built-in path streams over the rows of H accumulating outer products
+ * into the upper triangle, so H is read once in storage order. With OpenMP
+ * each thread accumulates a fixed range of rows into its own k x k partial,
+ * and the partials are added in thread order.
+ */
+void calculate_gram_matrix_into(const matrix_t *H, matrix_t *G)
+{
+    int a, b, k = H->cols; /* Declare loop variables at the beginning of the block */
+#ifndef SYMNMF_USE_CBLAS
+    const double *h_row;
+    double *partials, *partial, *g_row;
+    int i, t, threads; /* Declare loop variables at the beginning of the block */
+#endif
+
+    if (G->rows != k || G->cols != k)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+
+    zero_matrix(G);
+    if (H->rows == 0 || k == 0)
+        return;
+
+#ifdef SYMNMF_USE_CBLAS
+    cblas_dsyrk(CblasRowMajor, CblasUpper, CblasTrans, k, H->rows,
+                1.0, H->data, H->stride, 0.0, G->data, G->stride);
+#else
+    threads = get_thread_count();
+    partials = allocate_vector(threads * k * k);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads) if (H->rows >= PARALLEL_MIN_ROWS) private(h_row, partial, i, a, b)
+#endif
+    {
+        partial = partials + (size_t)get_thread_index() * k * k;
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (i = 0; i < H->rows; i++)
+        {
+            h_row = MATRIX_ROW(H, i);
+            for (a = 0; a < k; a++)
+            {
+                for (b = a; b < k; b++)
+                {
+                    partial[a * k + b] += h_row[a] * h_row[b];
+                }
+            }
+        }
+    }
+    for (t = 0; t < threads; t++)
+    {
+        for (a = 0; a < k; a++)
+        {
+            g_row = MATRIX_ROW(G, a);
+            for (b = a; b < k; b++)
+            {
+                g_row[b] += partials[((size_t)t * k + a) * k + b];
+            }
+        }
+    }
+    free(partials);
+#endif
+
+    /* Mirror the upper triangle into the lower one */
+    for (a = 0; a < k; a++)
+    {
+        for (b = 0; b < a; b++)
+        {
+            MATRIX_AT(G, a, b) = MATRIX_AT(G, b, a);
+        }
+    }
+}
+
+/* Vectorized exponential: exp(x) = 2^m * exp(r) with m = round(x / ln 2) and
+ * |r| <= ln(2) / 2, where exp(r) is a degree-13 Taylor polynomial (relative
+ * error below 1e-16 on that interval) and ln 2 is split in two parts so that
+ * r is computed without cancellation error.
+ * Every kernel runs the same sequence of rounded operations (no fused
+ * multiply-adds) and scales by 2^m with a single rounding, so the scalar,
+ * AVX2 and AVX-512 kernels give the same bits, denormal results included.
+ */
+#define EXP_LOG2E 1.4426950408889634
+#define EXP_LN2_HI 6.93147180369123816490e-01
+#define EXP_LN2_LO 1.90821492927058770002e-10
+
+/* Arguments are raised to this; exp of it is below half the smallest denormal, so it gives 0 */
+#define EXP_MIN_ARG -746.0
+
+/* Adding and subtracting 1.5 * 2^52 rounds a double to the nearest integer (ties to even) */
+#define EXP_ROUND_SHIFT 6755399441055744.0
+
+/* Smallest power of two applied in one step, keeping the first scaling exact */
+#define EXP_MIN_SCALE -1000
+
+/* Taylor coefficients 1/j! of exp(r), highest degree first, used by Horner's rule */
+static const double exp_coefficients[14] = {
+    1.0 / 6227020800.0, 1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0,
+    1.0 / 362880.0, 1.0 / 40320.0, 1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0,
+    1.0 / 24.0, 1.0 / 6.0, 1.0 / 2.0, 1.0, 1.0};
+
+/* Helper type for the vectorized exponential kernels */
+typedef void (*exp_kernel_fn)(double *values, int length);
+
+/* Portable exponential kernel (also finishes the tails of the vector kernels) */
+static void exp_kernel_scalar(double *values, int length)
+{
+    double x, m, r, p;
+    int i, j; /* Declare loop variables at the beginning of the block */
+
+    for (i = 0; i < length; i++)
+    {
+        x = values[i] > EXP_MIN_ARG ? values[i] : EXP_MIN_ARG;
+        m = (x * EXP_LOG2E + EXP_ROUND_SHIFT) - EXP_ROUND_SHIFT;
+        r = x - m * EXP_LN2_HI;
+        r = r - m * EXP_LN2_LO;
+        p = exp_coefficients[0];
+        for (j = 1; j < 14; j++)
+        {
+            p = p * r + exp_coefficients[j];
+        }
+        /* ldexp rounds once, also into the denormal range */
+        values[i] = ldexp(p, (int)m);
+    }
+}
+
+#ifdef GEMM_HAVE_X86_KERNELS
+
+/* AVX2 exponential kernel, four values per step */
+__attribute__((target("avx2")))
+static void exp_kernel_avx2(double *values, int length)
+{
+    __m256d x, m, m_low, r, p;
+    __m256i bits;
+    int i, j; /* Declare loop variables at the beginning of the block */
+
+    for (i = 0; i + 4 <= length; i += 4)
+    {
+        x = _mm256_max_pd(_mm256_loadu_pd(values + i), _mm256_set1_pd(EXP_MIN_ARG));
+        m = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(EXP_LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        r = _mm256_sub_pd(x, _mm256_mul_pd(m, _mm256_set1_pd(EXP_LN2_HI)));
+        r = _mm256_sub_pd(r, _mm256_mul_pd(m, _mm256_set1_pd(EXP_LN2_LO)));
+        p = _mm256_set1_pd(exp_coefficients[0]);
+        for (j = 1; j < 14; j++)
+        {
+            p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(exp_coefficients[j]));
+        }
+        /* Scale by 2^m in two steps, building the exponent bits directly: the first
+         * (to at least 2^EXP_MIN_SCALE) is exact, the second rounds into the denormals
+         */
+        m_low = _mm256_max_pd(m, _mm256_set1_pd(EXP_MIN_SCALE));
+        bits = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(m_low));
+        bits = _mm256_slli_epi64(_mm256_add_epi64(bits, _mm256_set1_epi64x(1023)), 52);
+        p = _mm256_mul_pd(p, _mm256_castsi256_pd(bits));
+        bits = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(_mm256_sub_pd(m, m_low)));
+        bits = _mm256_slli_epi64(_mm256_add_epi64(bits, _mm256_set1_epi64x(1023)), 52);
+        _mm256_storeu_pd(values + i, _mm256_mul_pd(p, _mm256_castsi256_pd(bits)));
+    }
+    exp_kernel_scalar(values + i, length - i);
+}
+
+/* AVX-512 exponential kernel, eight values per step */
+__attribute__((target("avx512f")))
+static void exp_kernel_avx512(double *values, int length)
+{
+    __m512d x, m, r, p;
+    int i, j; /* Declare loop variables at the beginning of the block */
+
+    for (i = 0; i + 8 <= length; i += 8)
+    {
+        x = _mm512_max_pd(_mm512_loadu_pd(values + i), _mm512_set1_pd(EXP_MIN_ARG));
+        m = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(EXP_LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        r = _mm512_sub_pd(x, _mm512_mul_pd(m, _mm512_set1_pd(EXP_LN2_HI)));
+        r = _mm512_sub_pd(r, _mm512_mul_pd(m, _mm512_set1_pd(EXP_LN2_LO)));
+        p = _mm512_set1_pd(exp_coefficients[0]);
+        for (j = 1; j < 14; j++)
+        {
+            p = _mm512_add_pd(_mm512_mul_pd(p, r), _mm512_set1_pd(exp_coefficients[j]));
+        }
+        /* scalef scales by 2^m with one rounding, as ldexp does */
+        _mm512_storeu_pd(values + i, _mm512_scalef_pd(p, m));
+    }
+    exp_kernel_scalar(values + i, length - i);
+}
+
+#endif /* GEMM_HAVE_X86_KERNELS */
+
+/* Selected exponential kernel (chosen on first use) */
+static exp_kernel_fn selected_exp_kernel = NULL;
+
+/* Helper function to pick the widest exponential kernel the CPU supports */
+static exp_kernel_fn select_exp_kernel(void)
+{
+    exp_kernel_fn kernel = exp_kernel_scalar;
+
+    if (selected_exp_kernel != NULL)
+        return selected_exp_kernel;
+#ifdef GEMM_HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        kernel = exp_kernel_avx512;
+    else if (__builtin_cpu_supports("avx2"))
+        kernel = exp_kernel_avx2;
+#endif
+    selected_exp_kernel = kernel;
+    return kernel;
+}
+
+/* Helper function to replace every value of a vector by its exponential */
+void vector_exp(double *values, int length)
+{
+    select_exp_kernel()(values, length);
+}
+
+/* Helper function to choose all SIMD kernels up front */
+void select_kernels(void)
+{
+    select_gemm_kernel();
+    select_exp_kernel();
+}
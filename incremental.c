@@ -0,0 +1,500 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h> /* Required for INT_MAX */
+#include <string.h> /* Required for memcpy, memset */
+#include "symnmf.h" /* Include the header file */
+
+/*
+ * Incremental mode for data sets that grow by appended points.
+ * The state kept between runs is the similarity matrix A with its degree
+ * vector (affinity_matrix_t), not W: every appended point changes the
+ * degrees of all the points, which would change every element of W, but
+ * leaves the previous elements of A as they are. A is stored as its lower
+ * triangle by rows, so the rows of new points go after the previous ones:
+ * appending m points computes their m x n affinities with the tile kernel of
+ * the similarity matrix and adds them to the degrees, in O(n * m).
+ * D^(-1/2) is applied when W is used, as W * H = D^(-1/2) (A (D^(-1/2) H)):
+ * two O(n * k) scalings of H around a blocked symmetric product with A,
+ * which reads the stored triangle like the packed kernel does.
+ * H is extended to the new points as a warm start for optimize_h: each new
+ * point starts as the weighted average of the rows of its old neighbours.
+ */
+
+/* Side of the square blocks of A processed together by multiply_normalized_affinity_into */
+#define AFFINITY_BLOCK 256
+
+/* Fraction of the grown triangle allocated in advance for later appends (1 / AFFINITY_HEADROOM) */
+#define AFFINITY_HEADROOM 8
+
+/* Function to calculate the similarity matrix of data points in incremental storage */
+affinity_matrix_t *calculate_affinity_matrix(const matrix_t *data)
+{
+    affinity_matrix_t *A;
+
+    A = (affinity_matrix_t *)malloc(sizeof(affinity_matrix_t));
+    if (A == NULL)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    A->data = NULL;
+    A->capacity = 0;
+    A->degrees = NULL;
+    A->points = allocate_matrix(0, data->cols);
+    A->n = 0;
+
+    /* Built as one append to an empty matrix */
+    extend_affinity_matrix(A, data);
+    return A;
+}
+
+/* Helper function to free a similarity matrix in incremental storage */
+void free_affinity_matrix(affinity_matrix_t *A)
+{
+    if (A == NULL)
+        return;
+    free(A->data);
+    free(A->degrees);
+    free_matrix(A->points);
+    free(A);
+}
+
+/* Helper function to make room for the rows of n points, keeping the stored ones */
+static void grow_affinity_matrix(affinity_matrix_t *A, int n)
+{
+    double *grown;
+    size_t length, capacity;
+
+    /* n (n + 1) / 2 elements, guarding against size overflow */
+    if ((double)n * ((double)n + 1) / 2 * sizeof(double) >= (double)(size_t)-1)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    length = (size_t)n * ((size_t)n + 1) / 2;
+    if (length > A->capacity)
+    {
+        capacity = length + length / AFFINITY_HEADROOM;
+        if (capacity > (size_t)-1 / sizeof(double))
+            capacity = length;
+        grown = (double *)realloc(A->data, (capacity > 0 ? capacity : 1) * sizeof(double));
+        if (grown == NULL)
+        {
+            printf("An Error Has Occurred\n");
+            exit(1);
+        }
+        A->data = grown;
+        A->capacity = capacity;
+    }
+
+    grown = (double *)realloc(A->degrees, (size_t)(n > 0 ? n : 1) * sizeof(double));
+    if (grown == NULL)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    A->degrees = grown;
+}
+
+/* Function to append data points to a similarity matrix in incremental storage */
+void extend_affinity_matrix(affinity_matrix_t *A, const matrix_t *points)
+{
+    matrix_t *all, *data_T, *tile, tile_view;
+    double *sq_norms, *row;
+    const double *tile_row;
+    int i, j, r, ib, jb, tile_rows, tile_cols, old_n = A->n, n, d = A->points->cols; /* Declare loop variables at the beginning of the block */
+
+    if (points->cols != d || points->rows > INT_MAX - old_n)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    n = old_n + points->rows;
+    if (n == old_n)
+        return;
+
+    /* The points, previous ones first (O(n * d), like the squared norms below) */
+    all = allocate_matrix(n, d);
+    for (i = 0; i < n; i++)
+    {
+        memcpy(MATRIX_ROW(all, i), i < old_n ? MATRIX_ROW(A->points, i) : MATRIX_ROW(points, i - old_n),
+               (size_t)d * sizeof(double));
+    }
+    free_matrix(A->points);
+    A->points = all;
+    grow_affinity_matrix(A, n);
+
+    /* Affinities of the new points to every point up to themselves, one row block per thread */
+    data_T = calculate_Ht_matrix(all);
+    sq_norms = calculate_squared_norms(all);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(get_thread_count()) schedule(dynamic, 1) private(i, j, r, jb, tile_rows, tile_cols, tile, tile_view, tile_row, row)
+#endif
+    for (ib = old_n; ib < n; ib += SIMILARITY_TILE)
+    {
+        tile_rows = n - ib < SIMILARITY_TILE ? n - ib : SIMILARITY_TILE;
+        tile = allocate_matrix(tile_rows, SIMILARITY_TILE);
+        for (jb = 0; jb < ib + tile_rows; jb += SIMILARITY_TILE)
+        {
+            tile_cols = ib + tile_rows - jb < SIMILARITY_TILE ? ib + tile_rows - jb : SIMILARITY_TILE;
+            tile_view = matrix_view(tile, 0, 0, tile_rows, tile_cols);
+            calculate_similarity_tile(all, data_T, sq_norms, ib, jb, &tile_view);
+            for (i = 0; i < tile_rows; i++)
+            {
+                r = ib + i;
+                row = AFFINITY_ROW(A, r) + jb;
+                tile_row = MATRIX_ROW(&tile_view, i);
+                for (j = 0; j < tile_cols && jb + j <= r; j++)
+                {
+                    row[j] = tile_row[j];
+                }
+            }
+        }
+        free_matrix(tile);
+    }
+
+    /* Degrees: each new row adds to its own point and to every earlier one */
+    for (r = old_n; r < n; r++)
+    {
+        A->degrees[r] = 0.0;
+    }
+    for (r = old_n; r < n; r++)
+    {
+        row = AFFINITY_ROW(A, r);
+        for (j = 0; j < r; j++)
+        {
+            A->degrees[r] += row[j];
+            A->degrees[j] += row[j];
+        }
+    }
+    A->n = n;
+
+    free(sq_norms);
+    free_matrix(data_T);
+}
+
+/* Helper function to copy block (row, col) of A into a dense tile, from the triangle that stores it
+ * Blocks are aligned on the same grid in both directions, so a block lies below the
+ * diagonal (col < row), above it (col > row) or on it.
+ */
+static void copy_affinity_block(const affinity_matrix_t *A, int row, int col, int rows, int cols, matrix_t *tile)
+{
+    const double *a_row;
+    double *t_row;
+    int i, j; /* Declare loop variables at the beginning of the block */
+
+    if (col < row)
+    {
+        /* Below the diagonal: the rows are stored contiguously */
+        for (i = 0; i < rows; i++)
+        {
+            memcpy(MATRIX_ROW(tile, i), AFFINITY_ROW(A, row + i) + col, (size_t)cols * sizeof(double));
+        }
+    }
+    else if (col > row)
+    {
+        /* Above the diagonal: transpose the mirrored block below it */
+        for (j = 0; j < cols; j++)
+        {
+            a_row = AFFINITY_ROW(A, col + j) + row;
+            for (i = 0; i < rows; i++)
+            {
+                MATRIX_AT(tile, i, j) = a_row[i];
+            }
+        }
+    }
+    else
+    {
+        /* Diagonal block: mirror its lower triangle */
+        for (i = 0; i < rows; i++)
+        {
+            a_row = AFFINITY_ROW(A, row + i) + col;
+            t_row = MATRIX_ROW(tile, i);
+            for (j = 0; j <= i; j++)
+            {
+                t_row[j] = a_row[j];
+                MATRIX_AT(tile, j, i) = a_row[j];
+            }
+        }
+    }
+}
+
+/* Helper function to calculate C = A * X with one thread per block row
+ * As multiply_packed_by_block_rows: every block row of C is summed by one
+ * thread, in the same order whatever the thread count.
+ */
+static void multiply_affinity_by_block_rows(const affinity_matrix_t *A, const matrix_t *X, matrix_t *C)
+{
+    matrix_t *tile, tile_view, x_j, c_i;
+    int ib, jb, rows, cols, n = A->n, k = X->cols; /* Declare loop variables at the beginning of the block */
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(get_thread_count()) private(tile, tile_view, x_j, c_i, ib, jb, rows, cols)
+#endif
+    {
+        tile = allocate_matrix(AFFINITY_BLOCK, AFFINITY_BLOCK);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+        for (ib = 0; ib < n; ib += AFFINITY_BLOCK)
+        {
+            rows = n - ib < AFFINITY_BLOCK ? n - ib : AFFINITY_BLOCK;
+            c_i = matrix_view(C, ib, 0, rows, k);
+            for (jb = 0; jb < n; jb += AFFINITY_BLOCK)
+            {
+                /* C_I += A_IJ * X_J */
+                cols = n - jb < AFFINITY_BLOCK ? n - jb : AFFINITY_BLOCK;
+                tile_view = matrix_view(tile, 0, 0, rows, cols);
+                copy_affinity_block(A, ib, jb, rows, cols, &tile_view);
+                x_j = matrix_view(X, jb, 0, cols, k);
+                multiply_matrices_accumulate(&tile_view, &x_j, &c_i);
+            }
+        }
+        free_matrix(tile);
+    }
+}
+
+/* Helper function to calculate C = A * X reading every stored element of A once
+ * Each block below the diagonal is applied twice: C_I += A_IJ * X_J, and
+ * C_J += (X_I^T * A_IJ)^T for the mirrored block above it.
+ */
+static void multiply_affinity_symmetric(const affinity_matrix_t *A, const matrix_t *X, matrix_t *C)
+{
+    matrix_t *tile, *x_T, *y_T, tile_view, x_i, x_j, c_i, x_T_view, y_T_view;
+    double *c_row;
+    int ib, jb, i, j, l, rows, cols, n = A->n, k = X->cols; /* Declare loop variables at the beginning of the block */
+
+    tile = allocate_matrix(AFFINITY_BLOCK, AFFINITY_BLOCK);
+    x_T = allocate_matrix(k, AFFINITY_BLOCK);
+    y_T = allocate_matrix(k, AFFINITY_BLOCK);
+
+    for (ib = 0; ib < n; ib += AFFINITY_BLOCK)
+    {
+        rows = n - ib < AFFINITY_BLOCK ? n - ib : AFFINITY_BLOCK;
+        x_i = matrix_view(X, ib, 0, rows, k);
+        c_i = matrix_view(C, ib, 0, rows, k);
+
+        /* X_I^T for the contributions above the diagonal */
+        x_T_view = matrix_view(x_T, 0, 0, k, rows);
+        for (i = 0; i < rows; i++)
+        {
+            for (l = 0; l < k; l++)
+            {
+                MATRIX_AT(&x_T_view, l, i) = MATRIX_AT(&x_i, i, l);
+            }
+        }
+
+        /* Blocks left of the diagonal contribute to both block rows */
+        for (jb = 0; jb < ib; jb += AFFINITY_BLOCK)
+        {
+            cols = AFFINITY_BLOCK; /* Only the last block row or column can be narrower */
+            tile_view = matrix_view(tile, 0, 0, rows, cols);
+            copy_affinity_block(A, ib, jb, rows, cols, &tile_view);
+
+            /* C_I += A_IJ * X_J */
+            x_j = matrix_view(X, jb, 0, cols, k);
+            multiply_matrices_accumulate(&tile_view, &x_j, &c_i);
+
+            /* C_J += (X_I^T * A_IJ)^T */
+            y_T_view = matrix_view(y_T, 0, 0, k, cols);
+            multiply_matrices_into(&x_T_view, &tile_view, &y_T_view);
+            for (j = 0; j < cols; j++)
+            {
+                c_row = MATRIX_ROW(C, jb + j);
+                for (l = 0; l < k; l++)
+                {
+                    c_row[l] += MATRIX_AT(&y_T_view, l, j);
+                }
+            }
+        }
+
+        /* Diagonal block: mirror its lower triangle into a full symmetric tile */
+        tile_view = matrix_view(tile, 0, 0, rows, rows);
+        copy_affinity_block(A, ib, ib, rows, rows, &tile_view);
+        multiply_matrices_accumulate(&tile_view, &x_i, &c_i);
+    }
+
+    free_matrix(tile);
+    free_matrix(x_T);
+    free_matrix(y_T);
+}
+
+/* Helper function to calculate C = W * H with W = D^(-1/2) A D^(-1/2) into an existing matrix
+ * D^(-1/2) scales the rows of H before the product with A and the rows of the
+ * result after it, so the stored affinities are never rewritten.
+ */
+void multiply_normalized_affinity_into(const affinity_matrix_t *A, const matrix_t *H, matrix_t *C)
+{
+    matrix_t *X;
+    double *inv_sqrt_degrees, *x_row, *c_row, scale;
+    const double *h_row;
+    int i, l, n = A->n, k = H->cols; /* Declare loop variables at the beginning of the block */
+
+    /* Check if multiplication is possible */
+    if (H->rows != n || C->rows != n || C->cols != k)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+
+    /* X = D^(-1/2) H, and C starts at zero */
+    inv_sqrt_degrees = calculate_inv_sqrt_degrees(A->degrees, n);
+    X = allocate_matrix(n, k);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(get_thread_count()) schedule(static) private(h_row, x_row, scale, l) if (n >= PARALLEL_MIN_ROWS)
+#endif
+    for (i = 0; i < n; i++)
+    {
+        h_row = MATRIX_ROW(H, i);
+        x_row = MATRIX_ROW(X, i);
+        scale = inv_sqrt_degrees[i];
+        for (l = 0; l < k; l++)
+        {
+            x_row[l] = scale * h_row[l];
+        }
+        memset(MATRIX_ROW(C, i), 0, (size_t)k * sizeof(double));
+    }
+
+    /* With several threads, trade a second read of A for independent block rows */
+    if (get_thread_count() > 1 && n > AFFINITY_BLOCK)
+        multiply_affinity_by_block_rows(A, X, C);
+    else
+        multiply_affinity_symmetric(A, X, C);
+
+    /* C = D^(-1/2) (A X) */
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(get_thread_count()) schedule(static) private(c_row, scale, l) if (n >= PARALLEL_MIN_ROWS)
+#endif
+    for (i = 0; i < n; i++)
+    {
+        c_row = MATRIX_ROW(C, i);
+        scale = inv_sqrt_degrees[i];
+        for (l = 0; l < k; l++)
+        {
+            c_row[l] *= scale;
+        }
+    }
+
+    free_matrix(X);
+    free(inv_sqrt_degrees);
+}
+
+/* Helper function to calculate W * H for a W kept as A and its degrees (a w_product_fn) */
+static void affinity_w_product(const void *A, const matrix_t *H, matrix_t *WH)
+{
+    multiply_normalized_affinity_into((const affinity_matrix_t *)A, H, WH);
+}
+
+/* Helper function to calculate ||W||_F^2 for W = D^(-1/2) A D^(-1/2) */
+double normalized_affinity_squared_norm(const affinity_matrix_t *A)
+{
+    double *inv_sqrt_degrees, sum = 0.0, value;
+    const double *row;
+    int i, j; /* Declare loop variables at the beginning of the block */
+
+    inv_sqrt_degrees = calculate_inv_sqrt_degrees(A->degrees, A->n);
+    for (i = 0; i < A->n; i++)
+    {
+        row = AFFINITY_ROW(A, i);
+        for (j = 0; j < i; j++)
+        {
+            value = inv_sqrt_degrees[i] * row[j] * inv_sqrt_degrees[j];
+            sum += 2.0 * value * value; /* (i, j) and (j, i) */
+        }
+        value = inv_sqrt_degrees[i] * row[i] * inv_sqrt_degrees[i];
+        sum += value * value;
+    }
+    free(inv_sqrt_degrees);
+    return sum;
+}
+
+/* Function to expand the normalized similarity matrix W = D^(-1/2) A D^(-1/2) into a dense matrix */
+matrix_t *unpack_normalized_affinity(const affinity_matrix_t *A)
+{
+    matrix_t *W;
+    double *inv_sqrt_degrees;
+    const double *row;
+    int i, j; /* Declare loop variables at the beginning of the block */
+
+    W = allocate_matrix(A->n, A->n);
+    inv_sqrt_degrees = calculate_inv_sqrt_degrees(A->degrees, A->n);
+    for (i = 0; i < A->n; i++)
+    {
+        row = AFFINITY_ROW(A, i);
+        for (j = 0; j <= i; j++)
+        {
+            /* Normalized as normalize_similarity_matrix does */
+            MATRIX_AT(W, i, j) = inv_sqrt_degrees[i] * row[j] * inv_sqrt_degrees[j];
+            MATRIX_AT(W, j, i) = inv_sqrt_degrees[j] * row[j] * inv_sqrt_degrees[i];
+        }
+    }
+    free(inv_sqrt_degrees);
+    return W;
+}
+
+/* Function to optimize H against W = D^(-1/2) A D^(-1/2) with the given options */
+matrix_t *optimize_h_affinity_options(const matrix_t *H, const affinity_matrix_t *A, const solver_options_t *options,
+                                      symnmf_stats_t *stats)
+{
+    if (stats != NULL)
+        stats->w_squared_norm = normalized_affinity_squared_norm(A);
+    return optimize_h_with_options(H, A, affinity_w_product, options, stats);
+}
+
+/* Function to extend H to the rows of new points, as a warm start for optimize_h
+ * A new point weighs old point j by W_rj = d_r^(-1/2) A_rj d_j^(-1/2); d_r^(-1/2)
+ * cancels out of the average, leaving A_rj d_j^(-1/2) from row r of A alone.
+ */
+matrix_t *extend_h(const matrix_t *H, const affinity_matrix_t *A)
+{
+    matrix_t *extended;
+    double *inv_sqrt_degrees, *mean_row, *row, weight, total;
+    const double *a_row, *h_row;
+    int i, j, l, old_n = H->rows, n = A->n, k = H->cols; /* Declare loop variables at the beginning of the block */
+
+    extended = allocate_matrix(n, k);
+    mean_row = allocate_vector(k);
+    for (i = 0; i < old_n; i++)
+    {
+        memcpy(MATRIX_ROW(extended, i), MATRIX_ROW(H, i), (size_t)k * sizeof(double));
+        for (j = 0; j < k; j++)
+        {
+            mean_row[j] += MATRIX_AT(H, i, j) / old_n;
+        }
+    }
+    if (old_n == n)
+    {
+        free(mean_row);
+        return extended;
+    }
+
+    inv_sqrt_degrees = calculate_inv_sqrt_degrees(A->degrees, old_n);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(get_thread_count()) schedule(static) private(j, l, row, a_row, h_row, weight, total) if (n - old_n >= PARALLEL_MIN_ROWS)
+#endif
+    for (i = old_n; i < n; i++)
+    {
+        row = MATRIX_ROW(extended, i);
+        a_row = AFFINITY_ROW(A, i);
+        total = 0.0;
+        for (j = 0; j < old_n; j++)
+        {
+            weight = a_row[j] * inv_sqrt_degrees[j];
+            total += weight;
+            h_row = MATRIX_ROW(H, j);
+            for (l = 0; l < k; l++)
+            {
+                row[l] += weight * h_row[l];
+            }
+        }
+        for (l = 0; l < k; l++)
+        {
+            /* A point without old neighbours starts at the average row */
+            row[l] = total > 0.0 ? row[l] / total : mean_row[l];
+        }
+    }
+
+    free(inv_sqrt_degrees);
+    free(mean_row);
+    return extended;
+}
@@ -0,0 +1,792 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> /* Required for memcpy, memcmp, memmove, memset */
+#include <limits.h> /* Required for INT_MAX */
+#include <math.h>   /* Required for floor */
+#include "symnmf.h" /* Include the header file */
+
+/*
+ * Reading and writing matrices.
+ * Data files are comma-separated text or the binary matrix format: a
+ * BINARY_HEADER_SIZE-byte header (BINARY_MAGIC, the number of rows and of
+ * columns as little-endian 64-bit integers, the element type as a
+ * little-endian 32-bit integer and 4 reserved zero bytes) followed by the
+ * rows as little-endian IEEE doubles. The data starts 8-byte aligned, so a
+ * file can be memory-mapped as is (e.g. numpy.memmap with offset=32).
+ * Text output goes through a buffered formatter instead of one printf per value.
+ */
+
+/* Size of the chunks the data file is read in */
+#define READ_BUFFER_SIZE (1 << 20)
+
+/* Longest number accepted in a data file, in characters */
+#define MAX_NUMBER_LENGTH 512
+
+/* Number of rows the data matrix starts with before it grows */
+#define INITIAL_DATA_ROWS 1024
+
+/* Buffered single-pass reader over a data file */
+typedef struct
+{
+    FILE *file;
+    const char *file_name;
+    char *buffer;
+    size_t pos;
+    size_t len;
+    long line;   /* Line of the next character, from 1 */
+    long column; /* Value within the current line, from 1 */
+} data_reader_t;
+
+/* Powers of ten that are exact as doubles */
+static const double exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/* Helper function to report a malformed data file and exit
+ * The position goes to stderr; stdout gets the usual error line.
+ */
+static void data_file_error(const data_reader_t *reader, const char *message, const char *token)
+{
+    fprintf(stderr, "%s:%ld: value %ld: %s", reader->file_name, reader->line, reader->column, message);
+    if (token != NULL)
+        fprintf(stderr, " '%s'", token);
+    fprintf(stderr, "\n");
+    printf("An Error Has Occurred\n");
+    exit(1);
+}
+
+/* Helper function to look at the next character of a data file without consuming it
+ * Returns: The character, or EOF at the end of the file
+ */
+static int reader_peek(data_reader_t *reader)
+{
+    if (reader->pos == reader->len)
+    {
+        reader->len = fread(reader->buffer, 1, READ_BUFFER_SIZE, reader->file);
+        reader->pos = 0;
+        if (reader->len == 0)
+        {
+            if (ferror(reader->file))
+                data_file_error(reader, "read error", NULL);
+            return EOF;
+        }
+    }
+    return (unsigned char)reader->buffer[reader->pos];
+}
+
+/* Helper function to convert a number token to a double
+ * Tokens with at most 15 significant digits and a decimal exponent of at
+ * most 22 are converted exactly with one multiplication or division by a
+ * power of ten, which rounds the same way as strtod; any other token
+ * (long mantissas, large exponents, inf, nan, hex) goes through strtod.
+ * Returns: 1 on success, 0 if the token is not a number
+ */
+static int parse_number(const char *token, size_t length, double *value)
+{
+    const char *p = token, *end = token + length;
+    char *strtod_end;
+    double mantissa = 0.0;
+    int negative = 0, digits = 0, any_digit = 0, exponent = 0, exp_value = 0, exp_negative = 0;
+
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = (*p++ == '-');
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+    {
+        any_digit = 1;
+        if (mantissa != 0.0 || *p != '0')
+            digits++;
+        mantissa = mantissa * 10.0 + (*p - '0');
+    }
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+        {
+            any_digit = 1;
+            if (mantissa != 0.0 || *p != '0')
+                digits++;
+            mantissa = mantissa * 10.0 + (*p - '0');
+            exponent--;
+        }
+    }
+    if (any_digit && p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        if (p < end && (*p == '-' || *p == '+'))
+            exp_negative = (*p++ == '-');
+        if (p == end)
+            any_digit = 0;
+        for (; p < end && *p >= '0' && *p <= '9' && exp_value < 10000; p++)
+            exp_value = exp_value * 10 + (*p - '0');
+        exponent += exp_negative ? -exp_value : exp_value;
+    }
+
+    if (any_digit && p == end && digits <= 15 && exponent >= -22 && exponent <= 22)
+    {
+        *value = exponent < 0 ? mantissa / exact_powers_of_ten[-exponent] : mantissa * exact_powers_of_ten[exponent];
+        if (negative)
+            *value = -*value;
+        return 1;
+    }
+
+    /* Slow path for everything else */
+    *value = strtod(token, &strtod_end);
+    return length > 0 && strtod_end == end;
+}
+
+/* Helper function to read one number from a data file
+ * Leading spaces and tabs are skipped; the number ends at a comma, a line
+ * break, a space or tab, or the end of the file.
+ * Returns: 1 if a number was read, 0 if there was no number before the separator
+ */
+static int read_number(data_reader_t *reader, char *token, double *value)
+{
+    size_t length = 0;
+    int c;
+
+    while ((c = reader_peek(reader)) == ' ' || c == '\t')
+        reader->pos++;
+    while (c != EOF && c != ',' && c != '\n' && c != '\r' && c != ' ' && c != '\t')
+    {
+        if (length == MAX_NUMBER_LENGTH)
+        {
+            token[length] = '\0';
+            data_file_error(reader, "number too long", NULL);
+        }
+        token[length++] = (char)c;
+        reader->pos++;
+        c = reader_peek(reader);
+    }
+    token[length] = '\0';
+    if (length == 0)
+        return 0;
+    if (!parse_number(token, length, value))
+        data_file_error(reader, "invalid number", token);
+    while ((c = reader_peek(reader)) == ' ' || c == '\t')
+        reader->pos++;
+    return 1;
+}
+
+/* Helper function to change the number of rows of a matrix, keeping its contents
+ * The block is resized in place where the allocator allows it; rows added are zeroed.
+ */
+static void resize_matrix_rows(matrix_t *matrix, int rows)
+{
+    size_t old_offset, offset;
+    void *block;
+
+    if ((size_t)rows > ((size_t)-1 - MATRIX_ALIGNMENT) / sizeof(double) / (size_t)matrix->stride)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    old_offset = (size_t)((char *)matrix->data - (char *)matrix->block);
+    block = realloc(matrix->block, (size_t)rows * (size_t)matrix->stride * sizeof(double) + MATRIX_ALIGNMENT);
+    if (block == NULL)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+
+    /* Re-align the data if the block moved to a differently aligned address */
+    offset = (MATRIX_ALIGNMENT - (size_t)block % MATRIX_ALIGNMENT) % MATRIX_ALIGNMENT;
+    if (offset != old_offset)
+    {
+        memmove((char *)block + offset, (char *)block + old_offset,
+                (size_t)(rows < matrix->rows ? rows : matrix->rows) * (size_t)matrix->stride * sizeof(double));
+    }
+    matrix->block = block;
+    matrix->data = (double *)((char *)block + offset);
+    if (rows > matrix->rows)
+    {
+        memset(MATRIX_ROW(matrix, matrix->rows), 0,
+               (size_t)(rows - matrix->rows) * (size_t)matrix->stride * sizeof(double));
+    }
+    matrix->rows = rows;
+}
+
+/* Helper function to read data from a file
+ * Reads comma-separated float values into a matrix in a single buffered pass,
+ * or a binary matrix file (see write_matrix) when the file starts with BINARY_MAGIC.
+ * The number of columns is taken from the first line and every other line
+ * must match it; lines may be arbitrarily wide and blank lines are skipped.
+ * Malformed files are reported on stderr with their line and value, and exit.
+ * Returns the matrix (NULL for an empty file) and updates n (rows) and d (cols) by reference.
+ */
+matrix_t *read_data_from_file(const char *file_name, int *n, int *d)
+{
+    data_reader_t reader;
+    char token[MAX_NUMBER_LENGTH + 1];
+    double value, *first_row = NULL, *grown;
+    size_t first_count = 0, first_capacity = 0;
+    matrix_t *data = NULL;
+    int c, rows = 0, cols = 0; /* Declare loop variables at the beginning of the block */
+
+    reader.file = fopen(file_name, "rb");
+    reader.buffer = (char *)malloc(READ_BUFFER_SIZE);
+    if (reader.file == NULL || reader.buffer == NULL)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    reader.file_name = file_name;
+    reader.pos = 0;
+    reader.len = 0;
+    reader.line = 1;
+    reader.column = 1;
+
+    /* Binary matrix files are recognized by their leading bytes */
+    if (reader_peek(&reader) != EOF && reader.len >= BINARY_MAGIC_LENGTH &&
+        memcmp(reader.buffer, BINARY_MAGIC, BINARY_MAGIC_LENGTH) == 0)
+    {
+        fclose(reader.file);
+        free(reader.buffer);
+        data = load_binary_matrix(file_name);
+        if (data == NULL)
+        {
+            fprintf(stderr, "%s: invalid binary matrix file\n", file_name);
+            printf("An Error Has Occurred\n");
+            exit(1);
+        }
+        *n = data->rows;
+        *d = data->cols;
+        return data;
+    }
+
+    while (reader_peek(&reader) != EOF)
+    {
+        /* Skip blank lines */
+        reader.column = 1;
+        while ((c = reader_peek(&reader)) == ' ' || c == '\t')
+            reader.pos++;
+        if (c == '\r' || c == '\n')
+        {
+            reader.pos++;
+            if (c == '\r' && reader_peek(&reader) == '\n')
+                reader.pos++;
+            reader.line++;
+            continue;
+        }
+
+        /* Read the values of one line */
+        for (;;)
+        {
+            if (!read_number(&reader, token, &value))
+                data_file_error(&reader, "missing value", NULL);
+            if (data == NULL)
+            {
+                /* First line: the width is not known yet */
+                if (first_count == first_capacity)
+                {
+                    first_capacity = first_capacity == 0 ? 64 : first_capacity * 2;
+                    grown = (double *)realloc(first_row, first_capacity * sizeof(double));
+                    if (grown == NULL || first_capacity > (size_t)INT_MAX)
+                        data_file_error(&reader, "line too wide", NULL);
+                    first_row = grown;
+                }
+                first_row[first_count] = value;
+                first_count++;
+            }
+            else
+            {
+                if (reader.column > cols)
+                    data_file_error(&reader, "more values than on the first line", NULL);
+                MATRIX_AT(data, rows, reader.column - 1) = value;
+            }
+
+            c = reader_peek(&reader);
+            if (c != ',')
+                break;
+            reader.pos++;
+            reader.column++;
+        }
+        if (c != '\n' && c != '\r' && c != EOF)
+            data_file_error(&reader, "expected ',' or end of line", NULL);
+
+        /* Finish the line */
+        if (data == NULL)
+        {
+            cols = (int)first_count;
+            data = allocate_matrix(INITIAL_DATA_ROWS, cols);
+            memcpy(MATRIX_ROW(data, 0), first_row, first_count * sizeof(double));
+            free(first_row);
+            first_row = NULL;
+        }
+        else if (reader.column < cols)
+        {
+            data_file_error(&reader, "fewer values than on the first line", NULL);
+        }
+        rows++;
+        if (rows == data->rows)
+        {
+            if (rows > INT_MAX / 2)
+                data_file_error(&reader, "too many lines", NULL);
+            resize_matrix_rows(data, rows * 2);
+        }
+        if (c != EOF)
+        {
+            reader.pos++;
+            if (c == '\r' && reader_peek(&reader) == '\n')
+                reader.pos++;
+            reader.line++;
+        }
+    }
+
+    fclose(reader.file);
+    free(reader.buffer);
+
+    if (data == NULL)
+    {
+        *n = 0;
+        *d = 0;
+        return NULL; /* Empty file */
+    }
+
+    /* Give back the rows reserved for growth */
+    resize_matrix_rows(data, rows);
+    *n = rows;
+    *d = cols;
+    return data;
+}
+
+
+/* Size of the text and binary output buffers */
+#define WRITE_BUFFER_SIZE (1 << 16)
+
+/* Longest formatted value: sprintf("%.4f") of the largest double */
+#define MAX_FORMATTED_LENGTH 320
+
+/* Magnitudes below this are formatted without sprintf (value * 10^4 stays below 2^52) */
+#define FAST_FORMAT_LIMIT 4.5e11
+
+/* Destination of formatted text: a file, or a growing block of memory */
+typedef struct
+{
+    FILE *file; /* Flushed to when full, or NULL to grow in memory */
+    char *data;
+    size_t len;
+    size_t capacity;
+    int failed; /* Set once a write to the file fails */
+} text_output_t;
+
+/* Source of the rows of a matrix being written, whatever its storage */
+typedef void (*row_source_fn)(const void *matrix, int row, int cols, double *values);
+
+/* Helper function to check whether doubles are stored little-endian on this machine */
+static int host_is_little_endian(void)
+{
+    const double one = 1.0; /* 0x3FF0000000000000 */
+    return ((const unsigned char *)&one)[sizeof(double) - 1] == 0x3F;
+}
+
+/* Helper function to reverse the bytes of every double of an array */
+static void swap_double_bytes(double *values, int count)
+{
+    unsigned char *bytes, tmp;
+    int i, b; /* Declare loop variables at the beginning of the block */
+
+    for (i = 0; i < count; i++)
+    {
+        bytes = (unsigned char *)(values + i);
+        for (b = 0; b < (int)sizeof(double) / 2; b++)
+        {
+            tmp = bytes[b];
+            bytes[b] = bytes[sizeof(double) - 1 - b];
+            bytes[sizeof(double) - 1 - b] = tmp;
+        }
+    }
+}
+
+/* Helper function to store an unsigned integer in little-endian order */
+static void store_little_endian(unsigned char *out, unsigned long value, int bytes)
+{
+    int i; /* Declare loop variable at the beginning of the block */
+    for (i = 0; i < bytes; i++)
+    {
+        out[i] = (unsigned char)(value & 0xFF);
+        value >>= 8;
+    }
+}
+
+/* Helper function to load a little-endian unsigned integer of at most INT_MAX
+ * Returns: The value, or -1 if it is larger than INT_MAX
+ */
+static long load_little_endian(const unsigned char *in, int bytes)
+{
+    long value = 0;
+    int i; /* Declare loop variable at the beginning of the block */
+    for (i = bytes - 1; i >= 0; i--)
+    {
+        if (value > (INT_MAX >> 8))
+            return -1;
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+/* Helper function to check that a binary matrix file holds exactly rows x cols doubles after the header
+ * Compares by division, as rows * cols * 8 can overflow for a corrupt header.
+ */
+static int binary_size_matches(FILE *file, long rows, long cols)
+{
+    long length, elements;
+
+    if (fseek(file, 0, SEEK_END) != 0 || (length = ftell(file)) < BINARY_HEADER_SIZE ||
+        fseek(file, BINARY_HEADER_SIZE, SEEK_SET) != 0)
+        return 0;
+    length -= BINARY_HEADER_SIZE;
+    if (length % (long)sizeof(double) != 0)
+        return 0;
+    elements = length / (long)sizeof(double);
+    if (cols == 0)
+        return elements == 0;
+    return elements % cols == 0 && elements / cols == rows;
+}
+
+/* Helper function to read a binary matrix file */
+matrix_t *load_binary_matrix(const char *file_name)
+{
+    unsigned char header[BINARY_HEADER_SIZE];
+    matrix_t *matrix;
+    FILE *file;
+    long rows, cols;
+    int i; /* Declare loop variable at the beginning of the block */
+
+    file = fopen(file_name, "rb");
+    if (file == NULL)
+        return NULL;
+    if (fread(header, 1, BINARY_HEADER_SIZE, file) != BINARY_HEADER_SIZE ||
+        memcmp(header, BINARY_MAGIC, BINARY_MAGIC_LENGTH) != 0 ||
+        load_little_endian(header + 24, 4) != BINARY_DTYPE_FLOAT64)
+    {
+        fclose(file);
+        return NULL;
+    }
+    rows = load_little_endian(header + 8, 8);
+    cols = load_little_endian(header + 16, 8);
+    /* The header must describe the file, so a corrupt one is not allocated */
+    if (rows < 0 || cols < 0 || !binary_size_matches(file, rows, cols))
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    /* Rows are read straight into the (padded) matrix */
+    matrix = allocate_matrix((int)rows, (int)cols);
+    for (i = 0; i < matrix->rows; i++)
+    {
+        if (fread(MATRIX_ROW(matrix, i), sizeof(double), (size_t)cols, file) != (size_t)cols)
+        {
+            free_matrix(matrix);
+            fclose(file);
+            return NULL;
+        }
+        if (!host_is_little_endian())
+            swap_double_bytes(MATRIX_ROW(matrix, i), (int)cols);
+    }
+    fclose(file);
+    return matrix;
+}
+
+/* Helper function to hand formatted text over to the file */
+static void text_output_flush(text_output_t *output)
+{
+    if (output->len > 0 && fwrite(output->data, 1, output->len, output->file) != output->len)
+        output->failed = 1;
+    output->len = 0;
+}
+
+/* Helper function to make room for formatted text, flushing it to the file or growing the block */
+static void text_output_reserve(text_output_t *output, size_t length)
+{
+    char *grown;
+
+    if (output->len + length <= output->capacity)
+        return;
+    if (output->file != NULL)
+    {
+        text_output_flush(output);
+        return;
+    }
+    while (output->len + length > output->capacity)
+        output->capacity *= 2;
+    grown = (char *)realloc(output->data, output->capacity);
+    if (grown == NULL)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    output->data = grown;
+}
+
+/* Helper function to format a value like printf("%.4f")
+ * The value is scaled by 10^4 exactly, as the sum of two doubles: its high
+ * and low 26-bit halves each multiply by 10^4 without rounding. That sum
+ * is rounded to an integer half-to-even, exactly like printf does with the
+ * decimal expansion. Large magnitudes, infinities and NaN use sprintf.
+ * out: At least MAX_FORMATTED_LENGTH characters
+ * Returns: The number of characters written (no terminator)
+ */
+static int format_fixed4(double value, char *out)
+{
+    double magnitude, hi, lo, a, b, sum, error, virtual_b, scaled, tail, integer_part, fraction;
+    unsigned long high, low, frac;
+    char digits[32];
+    int length = 0, count, i; /* Declare loop variables at the beginning of the block */
+
+    if (!(value > -FAST_FORMAT_LIMIT && value < FAST_FORMAT_LIMIT))
+        return sprintf(out, "%.4f", value);
+
+    /* printf keeps the sign of negative values that round to zero, and of -0 */
+    magnitude = value;
+    if (value < 0 || (value == 0 && 1.0 / value < 0))
+    {
+        out[length++] = '-';
+        magnitude = -value;
+    }
+
+    /* magnitude * 10^4 = a + b exactly (Veltkamp split) */
+    hi = magnitude * 134217729.0; /* 2^27 + 1 */
+    hi = hi - (hi - magnitude);
+    lo = magnitude - hi;
+    a = hi * 10000.0;
+    b = lo * 10000.0;
+
+    /* a + b = sum + error exactly (two-sum) */
+    sum = a + b;
+    virtual_b = sum - a;
+    error = (a - (sum - virtual_b)) + (b - virtual_b);
+
+    /* Round sum + error to an integer, ties to even */
+    scaled = floor(sum);
+    tail = (sum - scaled - 0.5) + error;
+    if (tail > 0 || (tail == 0 && fmod(scaled, 2.0) != 0))
+        scaled += 1.0;
+
+    /* Split into the integer part and the four decimals */
+    integer_part = floor(scaled / 10000.0);
+    fraction = scaled - integer_part * 10000.0;
+    if (fraction < 0)
+    {
+        integer_part -= 1.0;
+        fraction += 10000.0;
+    }
+    else if (fraction >= 10000.0)
+    {
+        integer_part += 1.0;
+        fraction -= 10000.0;
+    }
+
+    /* The integer part is below 4.5e11: collect it as two groups of at most six digits, backwards */
+    high = (unsigned long)floor(integer_part / 1000000.0);
+    low = (unsigned long)(integer_part - (double)high * 1000000.0);
+    count = 0;
+    do
+    {
+        digits[count++] = (char)('0' + low % 10);
+        low /= 10;
+    } while (low > 0 || (high > 0 && count < 6));
+    while (high > 0)
+    {
+        digits[count++] = (char)('0' + high % 10);
+        high /= 10;
+    }
+    while (count > 0)
+    {
+        out[length++] = digits[--count];
+    }
+
+    out[length++] = '.';
+    frac = (unsigned long)fraction;
+    for (i = 3; i >= 0; i--)
+    {
+        out[length + i] = (char)('0' + frac % 10);
+        frac /= 10;
+    }
+    return length + 4;
+}
+
+/* Helper function to append a matrix element and its separator to formatted text */
+static void text_output_value(text_output_t *output, double value, int last)
+{
+    text_output_reserve(output, MAX_FORMATTED_LENGTH + 1);
+    output->len += (size_t)format_fixed4(value, output->data + output->len);
+    output->data[output->len++] = last ? '\n' : ',';
+}
+
+/* Helper function to get a row of a dense matrix */
+static void dense_row(const void *matrix, int row, int cols, double *values)
+{
+    memcpy(values, MATRIX_ROW((const matrix_t *)matrix, row), (size_t)cols * sizeof(double));
+}
+
+/* Helper function to get a row of a packed symmetric matrix */
+static void packed_row(const void *matrix, int row, int cols, double *values)
+{
+    const packed_matrix_t *packed = (const packed_matrix_t *)matrix;
+    int j; /* Declare loop variable at the beginning of the block */
+
+    for (j = 0; j < cols; j++)
+    {
+        values[j] = j >= row ? PACKED_AT(packed, row, j) : PACKED_AT(packed, j, row);
+    }
+}
+
+/* Helper function to get a row of a float32 packed symmetric matrix */
+static void packed_row_f32(const void *matrix, int row, int cols, double *values)
+{
+    const packed_matrix_f32_t *packed = (const packed_matrix_f32_t *)matrix;
+    int j; /* Declare loop variable at the beginning of the block */
+
+    for (j = 0; j < cols; j++)
+    {
+        values[j] = j >= row ? PACKED_AT(packed, row, j) : PACKED_AT(packed, j, row);
+    }
+}
+
+/* Helper function to get a row of a diagonal matrix given by its diagonal */
+static void diagonal_row(const void *matrix, int row, int cols, double *values)
+{
+    memset(values, 0, (size_t)cols * sizeof(double));
+    values[row] = ((const double *)matrix)[row];
+}
+
+/* Helper function to write a matrix as text (4 decimal places) or in the binary format
+ * Returns: 0 on success, 1 if writing to the file failed
+ */
+static int write_rows(FILE *file, const void *matrix, row_source_fn row_source, int rows, int cols, int binary)
+{
+    unsigned char header[BINARY_HEADER_SIZE];
+    text_output_t output;
+    double *values;
+    int i, j, failed = 0; /* Declare loop variables at the beginning of the block */
+
+    values = allocate_vector(cols > 0 ? cols : 1);
+    if (binary)
+    {
+        memset(header, 0, sizeof(header));
+        memcpy(header, BINARY_MAGIC, BINARY_MAGIC_LENGTH);
+        store_little_endian(header + 8, (unsigned long)rows, 8);
+        store_little_endian(header + 16, (unsigned long)cols, 8);
+        store_little_endian(header + 24, BINARY_DTYPE_FLOAT64, 4);
+        failed = fwrite(header, 1, BINARY_HEADER_SIZE, file) != BINARY_HEADER_SIZE;
+        for (i = 0; i < rows && !failed; i++)
+        {
+            row_source(matrix, i, cols, values);
+            if (!host_is_little_endian())
+                swap_double_bytes(values, cols);
+            failed = fwrite(values, sizeof(double), (size_t)cols, file) != (size_t)cols;
+        }
+    }
+    else
+    {
+        output.file = file;
+        output.capacity = WRITE_BUFFER_SIZE;
+        output.data = (char *)malloc(output.capacity);
+        output.len = 0;
+        output.failed = 0;
+        if (output.data == NULL)
+        {
+            printf("An Error Has Occurred\n");
+            exit(1);
+        }
+        for (i = 0; i < rows; i++)
+        {
+            row_source(matrix, i, cols, values);
+            for (j = 0; j < cols; j++)
+            {
+                text_output_value(&output, values[j], j == cols - 1);
+            }
+        }
+        text_output_flush(&output);
+        failed = output.failed;
+        free(output.data);
+    }
+    free(values);
+    return failed || fflush(file) != 0;
+}
+
+/* Function to write a matrix as text or in the binary format */
+int write_matrix(FILE *file, const matrix_t *matrix, int binary)
+{
+    return write_rows(file, matrix, dense_row, matrix->rows, matrix->cols, binary);
+}
+
+/* Function to write a packed symmetric matrix as text or in the binary format */
+int write_packed_matrix(FILE *file, const packed_matrix_t *matrix, int binary)
+{
+    return write_rows(file, matrix, packed_row, matrix->n, matrix->n, binary);
+}
+
+/* Function to write a float32 packed symmetric matrix as text or in the binary format */
+int write_packed_matrix_f32(FILE *file, const packed_matrix_f32_t *matrix, int binary)
+{
+    return write_rows(file, matrix, packed_row_f32, matrix->n, matrix->n, binary);
+}
+
+/* Function to write a diagonal matrix given by its diagonal as text or in the binary format */
+int write_diagonal_matrix(FILE *file, const double *diagonal, int n, int binary)
+{
+    return write_rows(file, diagonal, diagonal_row, n, n, binary);
+}
+
+/* Helper function to write a binary matrix file */
+int save_binary_matrix(const char *file_name, const matrix_t *matrix)
+{
+    FILE *file;
+    int failed;
+
+    file = fopen(file_name, "wb");
+    if (file == NULL)
+        return 1;
+    failed = write_matrix(file, matrix, 1);
+    return fclose(file) != 0 || failed;
+}
+
+/* Function to write run statistics as text, one value per line */
+int write_stats(FILE *file, const symnmf_stats_t *stats)
+{
+    int i; /* Declare loop variable at the beginning of the block */
+
+    fprintf(file, "similarity_seconds %.6f\n", stats->similarity_seconds);
+    fprintf(file, "degree_seconds %.6f\n", stats->degree_seconds);
+    fprintf(file, "normalize_seconds %.6f\n", stats->normalize_seconds);
+    fprintf(file, "optimize_seconds %.6f\n", stats->optimize_seconds);
+    if (stats->deltas != NULL)
+    {
+        fprintf(file, "iterations %d\n", stats->iterations);
+        fprintf(file, "converged %d\n", stats->converged);
+        for (i = 0; i < stats->iterations; i++)
+        {
+            fprintf(file, "%d %.10g %.10g\n", i + 1, stats->deltas[i], stats->objectives[i]);
+        }
+    }
+    fflush(file);
+    return ferror(file) != 0;
+}
+
+/* Function to format a matrix as text, 4 decimal places per value */
+char *format_matrix(const matrix_t *matrix, size_t *length)
+{
+    text_output_t output;
+    int i, j; /* Declare loop variables at the beginning of the block */
+
+    output.file = NULL;
+    output.capacity = WRITE_BUFFER_SIZE;
+    output.data = (char *)malloc(output.capacity);
+    output.len = 0;
+    output.failed = 0;
+    if (output.data == NULL)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    for (i = 0; i < matrix->rows; i++)
+    {
+        for (j = 0; j < matrix->cols; j++)
+        {
+            text_output_value(&output, MATRIX_AT(matrix, i, j), j == matrix->cols - 1);
+        }
+    }
+    *length = output.len;
+    return output.data;
+}
@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h> /* Required for memcpy, memset */
+#include "symnmf.h" /* Include the header file */
+
+/*
+ * k-means with the semantics of kmeans.py.
+ * The first k points are the initial centroids. Each iteration assigns
+ * every point to its nearest centroid (the first one on ties) and moves
+ * each centroid to the mean of its points; a centroid without points stays
+ * put. The run stops once the centroids moved less than epsilon in total,
+ * and the labels are those of the final centroids. Distances are summed
+ * coordinate by coordinate in the order kmeans.py uses, so both give the
+ * same labels.
+ * Most distances are never computed (Hamerly's algorithm): every point keeps
+ * an upper bound on the distance to its centroid and a lower bound on the
+ * distance to any other, both shifted by how far the centroids moved, and
+ * it is only compared with every centroid once the bounds no longer prove
+ * its assignment.
+ */
+
+/* Helper function to calculate the Euclidean distance between two points of dimension d */
+static double point_distance(const double *a, const double *b, int d)
+{
+    double sum = 0.0, diff;
+    int t; /* Declare loop variable at the beginning of the block */
+
+    for (t = 0; t < d; t++)
+    {
+        diff = a[t] - b[t];
+        sum += diff * diff;
+    }
+    return sqrt(sum);
+}
+
+/* Helper function to find the nearest centroid of a point by comparing it with every centroid
+ * Sets the label, the distance to that centroid (upper) and to the second nearest (lower).
+ */
+static void assign_point(const double *point, const matrix_t *centroids, int *label, double *upper, double *lower)
+{
+    double distance, nearest_distance, second_distance = HUGE_VAL;
+    int j, nearest = 0; /* Declare loop variables at the beginning of the block */
+
+    nearest_distance = point_distance(point, MATRIX_ROW(centroids, 0), centroids->cols);
+    for (j = 1; j < centroids->rows; j++)
+    {
+        distance = point_distance(point, MATRIX_ROW(centroids, j), centroids->cols);
+        if (distance < nearest_distance)
+        {
+            second_distance = nearest_distance;
+            nearest_distance = distance;
+            nearest = j;
+        }
+        else if (distance < second_distance)
+        {
+            second_distance = distance;
+        }
+    }
+    *label = nearest;
+    *upper = nearest_distance;
+    *lower = second_distance;
+}
+
+/* Helper function to calculate half the distance from every centroid to the nearest other one
+ * A point closer than that to its centroid cannot be closer to any other.
+ */
+static void calculate_half_gaps(const matrix_t *centroids, double *half_gaps)
+{
+    double distance;
+    int j, l, k = centroids->rows; /* Declare loop variables at the beginning of the block */
+
+    for (j = 0; j < k; j++)
+    {
+        half_gaps[j] = HUGE_VAL;
+    }
+    for (j = 0; j < k; j++)
+    {
+        for (l = j + 1; l < k; l++)
+        {
+            distance = 0.5 * point_distance(MATRIX_ROW(centroids, j), MATRIX_ROW(centroids, l), centroids->cols);
+            if (distance < half_gaps[j])
+                half_gaps[j] = distance;
+            if (distance < half_gaps[l])
+                half_gaps[l] = distance;
+        }
+    }
+}
+
+/* Helper function to assign every point to its nearest centroid, skipping those the bounds settle
+ * half_gaps: Room for k values, set by calculate_half_gaps
+ */
+static void assign_points(const matrix_t *data, const matrix_t *centroids, double *half_gaps,
+                          int *labels, double *upper, double *lower)
+{
+    const double *point;
+    double bound;
+    int i, n = data->rows; /* Declare loop variables at the beginning of the block */
+
+    calculate_half_gaps(centroids, half_gaps);
+
+    /* Most points stop at the bounds, so the work is uneven */
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(get_thread_count()) schedule(dynamic, PARALLEL_MIN_ROWS) private(point, bound) if (n >= PARALLEL_MIN_ROWS)
+#endif
+    for (i = 0; i < n; i++)
+    {
+        bound = half_gaps[labels[i]] > lower[i] ? half_gaps[labels[i]] : lower[i];
+        if (upper[i] < bound)
+            continue;
+        /* Tighten the upper bound before comparing with every centroid */
+        point = MATRIX_ROW(data, i);
+        upper[i] = point_distance(point, MATRIX_ROW(centroids, labels[i]), data->cols);
+        if (upper[i] < bound)
+            continue;
+        assign_point(point, centroids, &labels[i], &upper[i], &lower[i]);
+    }
+}
+
+/* Helper function to move every centroid to the mean of its points
+ * The sums run over the points in order, as in kmeans.py.
+ * moves: Set to the distance each centroid moved
+ * Returns: The total distance the centroids moved
+ */
+static double update_centroids(const matrix_t *data, const int *labels, matrix_t *centroids, matrix_t *sums,
+                               int *counts, double *moves)
+{
+    const double *point;
+    double *sum, delta = 0.0;
+    int i, j, t, d = data->cols; /* Declare loop variables at the beginning of the block */
+
+    for (j = 0; j < centroids->rows; j++)
+    {
+        memset(MATRIX_ROW(sums, j), 0, (size_t)d * sizeof(double));
+        counts[j] = 0;
+    }
+    for (i = 0; i < data->rows; i++)
+    {
+        point = MATRIX_ROW(data, i);
+        sum = MATRIX_ROW(sums, labels[i]);
+        counts[labels[i]]++;
+        for (t = 0; t < d; t++)
+        {
+            sum[t] += point[t];
+        }
+    }
+
+    for (j = 0; j < centroids->rows; j++)
+    {
+        moves[j] = 0.0;
+        if (counts[j] == 0)
+            continue; /* No points: the centroid stays put */
+        sum = MATRIX_ROW(sums, j);
+        for (t = 0; t < d; t++)
+        {
+            sum[t] /= counts[j];
+        }
+        moves[j] = point_distance(MATRIX_ROW(centroids, j), sum, d);
+        memcpy(MATRIX_ROW(centroids, j), sum, (size_t)d * sizeof(double));
+        delta += moves[j];
+    }
+    return delta;
+}
+
+/* Helper function to shift the bounds of every point by how far the centroids moved */
+static void shift_bounds(const int *labels, const double *moves, int n, int k, double *upper, double *lower)
+{
+    double largest = 0.0, second_largest = 0.0;
+    int i, j, farthest = 0; /* Declare loop variables at the beginning of the block */
+
+    for (j = 0; j < k; j++)
+    {
+        if (moves[j] > largest)
+        {
+            second_largest = largest;
+            largest = moves[j];
+            farthest = j;
+        }
+        else if (moves[j] > second_largest)
+        {
+            second_largest = moves[j];
+        }
+    }
+
+    /* The other centroids came at most as close as the farthest of them moved */
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(get_thread_count()) schedule(static) if (n >= PARALLEL_MIN_ROWS)
+#endif
+    for (i = 0; i < n; i++)
+    {
+        upper[i] += moves[labels[i]];
+        lower[i] -= labels[i] == farthest ? second_largest : largest;
+    }
+}
+
+/* Function to cluster data points with k-means */
+matrix_t *kmeans(const matrix_t *data, int k, int max_iter, double epsilon, int *labels, int *iterations)
+{
+    matrix_t *centroids, *sums;
+    double *half_gaps, *moves, *upper, *lower, delta;
+    int *counts;
+    int i, iter, n = data->rows; /* Declare loop variables at the beginning of the block */
+
+    centroids = allocate_matrix(k, data->cols);
+    sums = allocate_matrix(k, data->cols);
+    half_gaps = allocate_vector(k);
+    moves = allocate_vector(k);
+    upper = allocate_vector(n);
+    lower = allocate_vector(n);
+    counts = (int *)malloc((size_t)k * sizeof(int));
+    if (counts == NULL)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+
+    /* The first k points are the initial centroids */
+    for (i = 0; i < k; i++)
+    {
+        memcpy(MATRIX_ROW(centroids, i), MATRIX_ROW(data, i), (size_t)data->cols * sizeof(double));
+    }
+
+    /* The first assignment compares every point with every centroid */
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(get_thread_count()) schedule(static) if (n >= PARALLEL_MIN_ROWS)
+#endif
+    for (i = 0; i < n; i++)
+    {
+        assign_point(MATRIX_ROW(data, i), centroids, &labels[i], &upper[i], &lower[i]);
+    }
+
+    for (iter = 0; iter < max_iter; iter++)
+    {
+        if (iter > 0)
+            assign_points(data, centroids, half_gaps, labels, upper, lower);
+        delta = update_centroids(data, labels, centroids, sums, counts, moves);
+        shift_bounds(labels, moves, n, k, upper, lower);
+        if (delta < epsilon)
+        {
+            iter++;
+            break;
+        }
+    }
+
+    /* The labels are those of the final centroids */
+    assign_points(data, centroids, half_gaps, labels, upper, lower);
+    if (iterations != NULL)
+        *iterations = iter;
+
+    free_matrix(sums);
+    free(half_gaps);
+    free(moves);
+    free(upper);
+    free(lower);
+    free(counts);
+    return centroids;
+}
@@ -0,0 +1,341 @@
+/* Memory mapping is POSIX, outside of ANSI C */
+#define _POSIX_C_SOURCE 200112L
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "symnmf.h" /* Include the header file */
+
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#define SYMNMF_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+#else
+#define POSIX_MADV_SEQUENTIAL 0
+#define POSIX_MADV_WILLNEED 0
+#endif
+
+/*
+ * Out-of-core mode for W larger than RAM.
+ * The similarity and normalized matrices live in a memory-mapped file as a
+ * dense row-major n x n matrix and are only ever touched one panel of
+ * panel_rows full rows at a time: panels are written in similarity tiles,
+ * normalized in place, and W * H is computed panel by panel with the usual
+ * matrix product, asking the system to read the next panel ahead. Only the
+ * data, H and a few n-vectors stay in memory, and the operating system
+ * keeps as much of the file cached as RAM allows.
+ * Each panel computes its rows in full (both triangles), so every panel is
+ * written once, sequentially, instead of mirroring tiles across the file.
+ * Without mmap (non-POSIX systems) the files cannot be created and the
+ * functions report failure.
+ */
+
+/* Helper function to pass advice about a range of rows of a mapped matrix to the system */
+static void advise_rows(const mapped_matrix_t *W, int row, int rows, int advice)
+{
+#ifdef SYMNMF_HAVE_MMAP
+    size_t page, start, end;
+
+    if (row + rows > W->n)
+        rows = W->n - row;
+    if (rows <= 0)
+        return;
+    page = (size_t)sysconf(_SC_PAGESIZE);
+    start = (size_t)row * (size_t)W->n * sizeof(double);
+    end = start + (size_t)rows * (size_t)W->n * sizeof(double);
+    start -= start % page; /* The range has to start on a page */
+    posix_madvise((char *)W->data + start, end - start, advice);
+#else
+    (void)W;
+    (void)row;
+    (void)rows;
+    (void)advice;
+#endif
+}
+
+/* Helper function to create a file-backed matrix and map it into memory */
+mapped_matrix_t *allocate_mapped_matrix(const char *file_name, int n, int panel_rows)
+{
+#ifdef SYMNMF_HAVE_MMAP
+    mapped_matrix_t *W;
+    void *data;
+
+    if (n < 0 || (size_t)n > (size_t)-1 / sizeof(double) / ((size_t)n > 0 ? (size_t)n : 1))
+        return NULL;
+    W = (mapped_matrix_t *)malloc(sizeof(mapped_matrix_t));
+    if (W == NULL)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    W->n = n;
+    W->bytes = (size_t)n * (size_t)n * sizeof(double);
+    W->data = NULL;
+
+    /* Default panels of about MAPPED_PANEL_BYTES */
+    if (panel_rows <= 0)
+        panel_rows = n > 0 ? (int)(MAPPED_PANEL_BYTES / ((size_t)n * sizeof(double))) : 1;
+    if (panel_rows > n)
+        panel_rows = n;
+    W->panel_rows = panel_rows < 1 ? 1 : panel_rows;
+
+    W->fd = open(file_name, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (W->fd < 0)
+    {
+        free(W);
+        return NULL;
+    }
+    if (W->bytes > 0)
+    {
+        if (ftruncate(W->fd, (off_t)W->bytes) != 0 ||
+            (data = mmap(NULL, W->bytes, PROT_READ | PROT_WRITE, MAP_SHARED, W->fd, 0)) == MAP_FAILED)
+        {
+            close(W->fd);
+            free(W);
+            return NULL;
+        }
+        W->data = (double *)data;
+        advise_rows(W, 0, n, POSIX_MADV_SEQUENTIAL);
+    }
+    return W;
+#else
+    (void)file_name;
+    (void)n;
+    (void)panel_rows;
+    return NULL;
+#endif
+}
+
+/* Helper function to unmap a file-backed matrix (the file itself is kept) */
+void free_mapped_matrix(mapped_matrix_t *W)
+{
+    if (W == NULL)
+        return;
+#ifdef SYMNMF_HAVE_MMAP
+    if (W->data != NULL)
+        munmap(W->data, W->bytes);
+    close(W->fd);
+#endif
+    free(W);
+}
+
+/* Helper function to describe rows of a mapped matrix as a dense matrix, without copying */
+matrix_t mapped_rows_view(const mapped_matrix_t *W, int row, int rows)
+{
+    matrix_t view;
+
+    view.data = W->data + (size_t)row * (size_t)W->n;
+    view.block = NULL;
+    view.rows = rows;
+    view.cols = W->n;
+    view.stride = W->n;
+    return view;
+}
+
+/* Function to calculate the similarity matrix into a memory-mapped file */
+mapped_matrix_t *calculate_mapped_similarity_matrix(const matrix_t *data, const char *file_name,
+                                                    int panel_rows, double *degrees)
+{
+    mapped_matrix_t *A;
+    matrix_t *data_T, panel, tile_view;
+    double *sq_norms, degree;
+    const double *row;
+    int i, j, p, ib, jb, rows, tile_rows, tile_cols, n = data->rows; /* Declare loop variables at the beginning of the block */
+
+    A = allocate_mapped_matrix(file_name, n, panel_rows);
+    if (A == NULL)
+        return NULL;
+    data_T = calculate_Ht_matrix(data);
+    sq_norms = calculate_squared_norms(data);
+
+    for (p = 0; p < n; p += A->panel_rows)
+    {
+        rows = n - p < A->panel_rows ? n - p : A->panel_rows;
+        panel = mapped_rows_view(A, p, rows);
+
+        /* Full rows of the panel, tile by tile */
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(get_thread_count()) schedule(dynamic, 1) private(jb, tile_rows, tile_cols, tile_view)
+#endif
+        for (ib = 0; ib < rows; ib += SIMILARITY_TILE)
+        {
+            tile_rows = rows - ib < SIMILARITY_TILE ? rows - ib : SIMILARITY_TILE;
+            for (jb = 0; jb < n; jb += SIMILARITY_TILE)
+            {
+                tile_cols = n - jb < SIMILARITY_TILE ? n - jb : SIMILARITY_TILE;
+                tile_view = matrix_view(&panel, ib, jb, tile_rows, tile_cols);
+                calculate_similarity_tile(data, data_T, sq_norms, p + ib, jb, &tile_view);
+            }
+        }
+
+        /* Degrees while the panel is still in memory */
+        if (degrees != NULL)
+        {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(get_thread_count()) schedule(static) private(row, degree, j) if (rows >= PARALLEL_MIN_ROWS)
+#endif
+            for (i = 0; i < rows; i++)
+            {
+                row = MATRIX_ROW(&panel, i);
+                degree = 0.0;
+                for (j = 0; j < n; j++)
+                {
+                    degree += row[j];
+                }
+                degrees[p + i] = degree;
+            }
+        }
+    }
+
+    free(sq_norms);
+    free_matrix(data_T);
+    return A;
+}
+
+/* Function to normalize a mapped similarity matrix in place, W_ij = A_ij / sqrt(d_i * d_j)
+ * The mean is summed in the order packed_matrix_mean uses, so that both give the same value.
+ */
+double normalize_mapped_similarity_matrix(mapped_matrix_t *W, const double *degrees)
+{
+    matrix_t panel;
+    double *inv_sqrt_degrees, *row, scale, diagonal = 0.0, off_diagonal = 0.0;
+    int i, j, p, rows, n = W->n; /* Declare loop variables at the beginning of the block */
+
+    if (n == 0)
+        return 0.0;
+    inv_sqrt_degrees = calculate_inv_sqrt_degrees(degrees, n);
+
+    for (p = 0; p < n; p += W->panel_rows)
+    {
+        rows = n - p < W->panel_rows ? n - p : W->panel_rows;
+        panel = mapped_rows_view(W, p, rows);
+        advise_rows(W, p + rows, W->panel_rows, POSIX_MADV_WILLNEED);
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(get_thread_count()) schedule(static) private(row, scale, j) if (rows >= PARALLEL_MIN_ROWS)
+#endif
+        for (i = 0; i < rows; i++)
+        {
+            row = MATRIX_ROW(&panel, i);
+            scale = inv_sqrt_degrees[p + i];
+            for (j = 0; j < n; j++)
+            {
+                row[j] = scale * row[j] * inv_sqrt_degrees[j];
+            }
+        }
+
+        /* Upper triangle of the panel, row by row */
+        for (i = 0; i < rows; i++)
+        {
+            row = MATRIX_ROW(&panel, i);
+            diagonal += row[p + i];
+            for (j = p + i + 1; j < n; j++)
+            {
+                off_diagonal += row[j];
+            }
+        }
+    }
+
+    free(inv_sqrt_degrees);
+    return (diagonal + 2.0 * off_diagonal) / ((double)n * (double)n);
+}
+
+/* Helper function to calculate C = W * H for a mapped W into an existing matrix
+ * One panel of W is multiplied at a time while the next one is read ahead.
+ */
+void multiply_mapped_into(const mapped_matrix_t *W, const matrix_t *H, matrix_t *C)
+{
+    matrix_t panel, c_rows;
+    int p, rows, n = W->n; /* Declare loop variables at the beginning of the block */
+
+    for (p = 0; p < n; p += W->panel_rows)
+    {
+        rows = n - p < W->panel_rows ? n - p : W->panel_rows;
+        advise_rows(W, p + rows, W->panel_rows, POSIX_MADV_WILLNEED);
+        panel = mapped_rows_view(W, p, rows);
+        c_rows = matrix_view(C, p, 0, rows, C->cols);
+        multiply_matrices_into(&panel, H, &c_rows);
+    }
+}
+
+/* Helper function to adapt multiply_mapped_into to the w_product_fn signature */
+static void mapped_w_product(const void *W, const matrix_t *H, matrix_t *WH)
+{
+    multiply_mapped_into((const mapped_matrix_t *)W, H, WH);
+}
+
+/* Function to optimize H using the iterative update rule with a mapped W */
+matrix_t *optimize_h_mapped(const matrix_t *H, const mapped_matrix_t *W)
+{
+    return optimize_h_with(H, W, mapped_w_product);
+}
+
+/* Function to calculate the squared Frobenius norm of a mapped matrix, panel by panel */
+double mapped_matrix_squared_norm(const mapped_matrix_t *W)
+{
+    matrix_t panel;
+    int p, rows; /* Declare loop variables at the beginning of the block */
+    double sum = 0.0;
+
+    for (p = 0; p < W->n; p += W->panel_rows)
+    {
+        rows = W->n - p < W->panel_rows ? W->n - p : W->panel_rows;
+        advise_rows(W, p + rows, W->panel_rows, POSIX_MADV_WILLNEED);
+        panel = mapped_rows_view(W, p, rows);
+        sum += matrix_squared_norm(&panel);
+    }
+    return sum;
+}
+
+/* Function to run the whole symNMF pipeline on the data points with W in a memory-mapped file
+ * With stats, recording the objective costs one more pass over the file for ||W||^2.
+ */
+matrix_t *symnmf_from_data_mapped(const matrix_t *data, int k, unsigned long seed, const matrix_t *initial_H,
+                                  const char *file_name, int panel_rows, const solver_options_t *options,
+                                  symnmf_stats_t *stats)
+{
+    mapped_matrix_t *W;
+    matrix_t *H, *final_H;
+    double *degrees, mean, time = 0.0;
+    rng_t rng;
+
+    /* W = D^(-1/2) A D^(-1/2), normalized in place in the file */
+    if (stats != NULL)
+        time = wall_seconds();
+    degrees = allocate_vector(data->rows);
+    W = calculate_mapped_similarity_matrix(data, file_name, panel_rows, degrees);
+    if (W == NULL)
+    {
+        free(degrees);
+        return NULL;
+    }
+    if (stats != NULL)
+    {
+        stats->similarity_seconds = wall_seconds() - time;
+        time = wall_seconds();
+    }
+    mean = normalize_mapped_similarity_matrix(W, degrees);
+    free(degrees);
+    if (stats != NULL)
+    {
+        stats->normalize_seconds = wall_seconds() - time;
+        stats->w_squared_norm = mapped_matrix_squared_norm(W);
+    }
+
+    if (initial_H != NULL)
+    {
+        final_H = optimize_h_with_options(initial_H, W, mapped_w_product, options, stats);
+    }
+    else
+    {
+        rng_seed(&rng, seed);
+        H = initialize_h(data->rows, k, mean, &rng);
+        final_H = optimize_h_with_options(H, W, mapped_w_product, options, stats);
+        free_matrix(H);
+    }
+
+    free_mapped_matrix(W);
+    return final_H;
+}
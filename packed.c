@@ -0,0 +1,35 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> /* Required for memset */
+#include "symnmf.h" /* Include the header file */
+
+/*
+ * Packed upper-triangular storage for the symmetric similarity matrix A and
+ * the normalized matrix W, which halves their memory footprint.
+ * Includes the builders for A, D and W in that format and a blocked
+ * SYMM-style kernel computing W * H from the upper triangle alone.
+ * The kernels are generated from packed_template.h twice: for double
+ * elements (packed_matrix_t) and for float elements (packed_matrix_f32_t,
+ * the float32 mode, with the same names suffixed _f32).
+ */
+
+/* Side of the square blocks of W processed together by multiply_packed_into */
+#define PACKED_BLOCK 256
+
+/* Double precision kernels */
+#define PACKED_REAL double
+#define PACKED_TYPE packed_matrix_t
+#define PACKED_NAME(name) name
+#include "packed_template.h"
+#undef PACKED_REAL
+#undef PACKED_TYPE
+#undef PACKED_NAME
+
+/* Single precision kernels (float32 mode) */
+#define PACKED_REAL float
+#define PACKED_TYPE packed_matrix_f32_t
+#define PACKED_NAME(name) name##_f32
+#include "packed_template.h"
+#undef PACKED_REAL
+#undef PACKED_TYPE
+#undef PACKED_NAME
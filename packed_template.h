@@ -0,0 +1,532 @@
+/*
+ * Packed symmetric storage kernels for one element type.
+ * Included by packed.c once per precision, with
+ *   PACKED_REAL        the element type (double or float),
+ *   PACKED_TYPE        the matrix type holding PACKED_REAL elements,
+ *   PACKED_NAME(name)  the name of a function for this type.
+ * Only the storage of A and W uses PACKED_REAL: values are computed,
+ * summed (degrees, mean) and multiplied in double, each block of W being
+ * widened into a double tile before the matrix product.
+ */
+
+/* Helper function to allocate a zero-initialized packed symmetric matrix */
+PACKED_TYPE *PACKED_NAME(allocate_packed_matrix)(int n)
+{
+    PACKED_TYPE *matrix;
+    size_t length;
+
+    matrix = (PACKED_TYPE *)malloc(sizeof(PACKED_TYPE));
+    if (matrix == NULL || n < 0)
+    {
+        free(matrix);
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+
+    /* n (n + 1) / 2 elements, guarding against size overflow */
+    if ((double)n * ((double)n + 1) / 2 * sizeof(PACKED_REAL) >= (double)(size_t)-1)
+    {
+        free(matrix);
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+
+    length = (size_t)n * ((size_t)n + 1) / 2;
+    matrix->data = (PACKED_REAL *)calloc(length > 0 ? length : 1, sizeof(PACKED_REAL));
+    if (matrix->data == NULL)
+    {
+        free(matrix);
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    matrix->n = n;
+    return matrix;
+}
+
+/* Helper function to free a packed symmetric matrix */
+void PACKED_NAME(free_packed_matrix)(PACKED_TYPE *matrix)
+{
+    if (matrix == NULL)
+        return;
+    free(matrix->data);
+    free(matrix);
+}
+
+/* Helper function to expand a packed symmetric matrix into a dense one */
+matrix_t *PACKED_NAME(unpack_matrix)(const PACKED_TYPE *matrix)
+{
+    matrix_t *dense;
+    const PACKED_REAL *row;
+    int i, j, n = matrix->n; /* Declare loop variables at the beginning of the block */
+
+    dense = allocate_matrix(n, n);
+    for (i = 0; i < n; i++)
+    {
+        row = PACKED_ROW(matrix, i);
+        for (j = i; j < n; j++)
+        {
+            MATRIX_AT(dense, i, j) = row[j - i];
+            MATRIX_AT(dense, j, i) = row[j - i];
+        }
+    }
+    return dense;
+}
+
+/* Function to calculate the similarity matrix in packed storage
+ * Tiles of the upper triangle are computed into a scratch tile with
+ * calculate_similarity_tile and their upper part copied into the packed rows.
+ * Row blocks of tiles are shared out between threads, each with its own scratch tile.
+ */
+PACKED_TYPE *PACKED_NAME(calculate_packed_similarity_matrix)(const matrix_t *data)
+{
+    PACKED_TYPE *affinity_matrix;
+    matrix_t *data_T, *scratch, tile_view;
+    double *sq_norms;
+    const double *tile_row;
+    PACKED_REAL *packed_row;
+    int i, j, ib, jb, first, tile_rows, tile_cols, n = data->rows; /* Declare loop variables at the beginning of the block */
+
+    affinity_matrix = PACKED_NAME(allocate_packed_matrix)(n);
+    data_T = calculate_Ht_matrix(data);
+    sq_norms = calculate_squared_norms(data);
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(get_thread_count()) private(scratch, tile_view, tile_row, packed_row, i, j, ib, jb, first, tile_rows, tile_cols)
+#endif
+    {
+        scratch = allocate_matrix(SIMILARITY_TILE, SIMILARITY_TILE);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+        for (ib = 0; ib < n; ib += SIMILARITY_TILE)
+        {
+            tile_rows = n - ib < SIMILARITY_TILE ? n - ib : SIMILARITY_TILE;
+            for (jb = ib; jb < n; jb += SIMILARITY_TILE)
+            {
+                tile_cols = n - jb < SIMILARITY_TILE ? n - jb : SIMILARITY_TILE;
+                tile_view = matrix_view(scratch, 0, 0, tile_rows, tile_cols);
+                calculate_similarity_tile(data, data_T, sq_norms, ib, jb, &tile_view);
+
+                /* Keep the part of each tile row on or above the diagonal */
+                for (i = 0; i < tile_rows; i++)
+                {
+                    first = ib + i > jb ? ib + i : jb;
+                    tile_row = MATRIX_ROW(&tile_view, i) + (first - jb);
+                    packed_row = &PACKED_AT(affinity_matrix, ib + i, first);
+                    for (j = 0; j < jb + tile_cols - first; j++)
+                    {
+                        packed_row[j] = (PACKED_REAL)tile_row[j];
+                    }
+                }
+            }
+        }
+        free_matrix(scratch);
+    }
+
+    free(sq_norms);
+    free_matrix(data_T);
+    return affinity_matrix;
+}
+
+/* Function to calculate the degree vector of a packed similarity matrix
+ * Each stored element (i, j) with j > i contributes to both d_i and d_j.
+ * With OpenMP every thread sums its rows into its own vector of degrees, and
+ * those are added in thread order.
+ */
+double *PACKED_NAME(calculate_packed_degree_vector)(const PACKED_TYPE *similarity_matrix)
+{
+    double *degrees, *partials, *partial, degree;
+    const PACKED_REAL *row;
+    int i, j, t, threads, n = similarity_matrix->n; /* Declare loop variables at the beginning of the block */
+
+    threads = get_thread_count();
+    partials = allocate_vector(threads * n);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads) if (n >= PARALLEL_MIN_ROWS) private(partial, row, degree, i, j)
+#endif
+    {
+        partial = partials + (size_t)get_thread_index() * n;
+#ifdef _OPENMP
+#pragma omp for schedule(static, PARALLEL_MIN_ROWS)
+#endif
+        for (i = 0; i < n; i++)
+        {
+            row = PACKED_ROW(similarity_matrix, i) - i; /* row[j] is element (i, j) */
+            degree = partial[i] + row[i];
+            for (j = i + 1; j < n; j++)
+            {
+                degree += row[j];
+                partial[j] += row[j];
+            }
+            partial[i] = degree;
+        }
+    }
+
+    degrees = allocate_vector(n);
+    for (t = 0; t < threads; t++)
+    {
+        partial = partials + (size_t)t * n;
+        for (i = 0; i < n; i++)
+        {
+            degrees[i] += partial[i];
+        }
+    }
+    free(partials);
+    return degrees;
+}
+
+/* Function to normalize a packed similarity matrix in place */
+void PACKED_NAME(normalize_packed_similarity_matrix)(PACKED_TYPE *similarity_matrix, const double *degrees)
+{
+    double *inv_sqrt_degrees, scale;
+    PACKED_REAL *row;
+    int i, j, n = similarity_matrix->n; /* Declare loop variables at the beginning of the block */
+
+    inv_sqrt_degrees = calculate_inv_sqrt_degrees(degrees, n);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(get_thread_count()) schedule(static, PARALLEL_MIN_ROWS) private(row, scale, j) if (n >= PARALLEL_MIN_ROWS)
+#endif
+    for (i = 0; i < n; i++)
+    {
+        row = PACKED_ROW(similarity_matrix, i) - i; /* row[j] is element (i, j) */
+        scale = inv_sqrt_degrees[i];
+        for (j = i; j < n; j++)
+        {
+            row[j] = (PACKED_REAL)(scale * row[j] * inv_sqrt_degrees[j]);
+        }
+    }
+    free(inv_sqrt_degrees);
+}
+
+/* Helper function to calculate the mean of all n x n elements of a packed symmetric matrix
+ * Elements off the diagonal are stored once and count twice.
+ */
+double PACKED_NAME(packed_matrix_mean)(const PACKED_TYPE *matrix)
+{
+    double diagonal = 0.0, off_diagonal = 0.0;
+    const PACKED_REAL *row;
+    int i, j, n = matrix->n; /* Declare loop variables at the beginning of the block */
+
+    if (n == 0)
+        return 0.0;
+    for (i = 0; i < n; i++)
+    {
+        row = PACKED_ROW(matrix, i);
+        diagonal += row[0];
+        for (j = 1; j < n - i; j++)
+        {
+            off_diagonal += row[j];
+        }
+    }
+    return (diagonal + 2.0 * off_diagonal) / ((double)n * (double)n);
+}
+
+/* Helper function to calculate the squared Frobenius norm of a packed symmetric matrix */
+double PACKED_NAME(packed_matrix_squared_norm)(const PACKED_TYPE *matrix)
+{
+    double diagonal = 0.0, off_diagonal = 0.0, value;
+    const PACKED_REAL *row;
+    int i, j, n = matrix->n; /* Declare loop variables at the beginning of the block */
+
+    for (i = 0; i < n; i++)
+    {
+        row = PACKED_ROW(matrix, i);
+        diagonal += (double)row[0] * row[0];
+        for (j = 1; j < n - i; j++)
+        {
+            value = row[j];
+            off_diagonal += value * value;
+        }
+    }
+    return diagonal + 2.0 * off_diagonal;
+}
+
+/* Helper function to copy the block W[row:row+rows, col:col+cols] of a packed
+ * symmetric matrix into a dense tile; the block must not straddle the diagonal
+ * unless it is a diagonal block (row == col)
+ */
+static void PACKED_NAME(copy_packed_block)(const PACKED_TYPE *W, int row, int col, int rows, int cols, matrix_t *tile)
+{
+    const PACKED_REAL *w_row;
+    double *t_row;
+    int i, j; /* Declare loop variables at the beginning of the block */
+
+    if (row == col)
+    {
+        /* Diagonal block: mirror its upper triangle */
+        for (i = 0; i < rows; i++)
+        {
+            w_row = PACKED_ROW(W, row + i);
+            t_row = MATRIX_ROW(tile, i);
+            for (j = i; j < cols; j++)
+            {
+                t_row[j] = w_row[j - i];
+                MATRIX_AT(tile, j, i) = w_row[j - i];
+            }
+        }
+    }
+    else if (col > row)
+    {
+        /* Above the diagonal: the rows are stored contiguously */
+        for (i = 0; i < rows; i++)
+        {
+            w_row = &PACKED_AT(W, row + i, col);
+            t_row = MATRIX_ROW(tile, i);
+            for (j = 0; j < cols; j++)
+            {
+                t_row[j] = w_row[j];
+            }
+        }
+    }
+    else
+    {
+        /* Below the diagonal: transpose the mirrored block above it */
+        for (j = 0; j < cols; j++)
+        {
+            w_row = &PACKED_AT(W, col + j, row);
+            for (i = 0; i < rows; i++)
+            {
+                MATRIX_AT(tile, i, j) = w_row[i];
+            }
+        }
+    }
+}
+
+/* Helper function to calculate C = W * H for a packed W with one thread per block row
+ * Each thread computes whole PACKED_BLOCK-row blocks of C from full block rows
+ * of W, so no two threads write the same rows and every row of C is summed
+ * in the same order whatever the thread count. Elements off the diagonal
+ * blocks are read twice, which only pays off with several threads.
+ */
+static void PACKED_NAME(multiply_packed_by_block_rows)(const PACKED_TYPE *W, const matrix_t *H, matrix_t *C)
+{
+    matrix_t *tile, tile_view, h_j, c_i;
+    int ib, jb, rows, cols, n = W->n, k = H->cols; /* Declare loop variables at the beginning of the block */
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(get_thread_count()) private(tile, tile_view, h_j, c_i, ib, jb, rows, cols)
+#endif
+    {
+        tile = allocate_matrix(PACKED_BLOCK, PACKED_BLOCK);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+        for (ib = 0; ib < n; ib += PACKED_BLOCK)
+        {
+            rows = n - ib < PACKED_BLOCK ? n - ib : PACKED_BLOCK;
+            c_i = matrix_view(C, ib, 0, rows, k);
+            for (jb = 0; jb < n; jb += PACKED_BLOCK)
+            {
+                /* C_I += W_IJ * H_J */
+                cols = n - jb < PACKED_BLOCK ? n - jb : PACKED_BLOCK;
+                tile_view = matrix_view(tile, 0, 0, rows, cols);
+                PACKED_NAME(copy_packed_block)(W, ib, jb, rows, cols, &tile_view);
+                h_j = matrix_view(H, jb, 0, cols, k);
+                multiply_matrices_accumulate(&tile_view, &h_j, &c_i);
+            }
+        }
+        free_matrix(tile);
+    }
+}
+
+/* Helper function to calculate C = W * H for a packed symmetric W into an existing matrix
+ * W is walked in PACKED_BLOCK x PACKED_BLOCK blocks of its upper triangle,
+ * each copied into a dense scratch tile that the matrix product kernel then
+ * applies twice: C_I += W_IJ * H_J, and C_J += (H_I^T * W_IJ)^T for the
+ * mirrored block below the diagonal, so every stored element is read once.
+ */
+void PACKED_NAME(multiply_packed_into)(const PACKED_TYPE *W, const matrix_t *H, matrix_t *C)
+{
+    matrix_t *tile, *h_T, *x_T, tile_view, h_i, h_j, c_i, h_T_view, x_T_view;
+    double *c_row;
+    int ib, jb, i, j, l, rows, cols, n = W->n, k = H->cols; /* Declare loop variables at the beginning of the block */
+
+    /* Check if multiplication is possible */
+    if (H->rows != n || C->rows != n || C->cols != k)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        memset(MATRIX_ROW(C, i), 0, (size_t)k * sizeof(double));
+    }
+
+    /* With several threads, trade a second read of W for independent block rows */
+    if (get_thread_count() > 1 && n > PACKED_BLOCK)
+    {
+        PACKED_NAME(multiply_packed_by_block_rows)(W, H, C);
+        return;
+    }
+
+    tile = allocate_matrix(PACKED_BLOCK, PACKED_BLOCK);
+    h_T = allocate_matrix(k, PACKED_BLOCK);
+    x_T = allocate_matrix(k, PACKED_BLOCK);
+
+    for (ib = 0; ib < n; ib += PACKED_BLOCK)
+    {
+        rows = n - ib < PACKED_BLOCK ? n - ib : PACKED_BLOCK;
+        h_i = matrix_view(H, ib, 0, rows, k);
+        c_i = matrix_view(C, ib, 0, rows, k);
+
+        /* H_I^T for the contributions below the diagonal */
+        h_T_view = matrix_view(h_T, 0, 0, k, rows);
+        for (i = 0; i < rows; i++)
+        {
+            for (l = 0; l < k; l++)
+            {
+                MATRIX_AT(&h_T_view, l, i) = MATRIX_AT(&h_i, i, l);
+            }
+        }
+
+        /* Diagonal block: mirror its upper triangle into a full symmetric tile */
+        tile_view = matrix_view(tile, 0, 0, rows, rows);
+        PACKED_NAME(copy_packed_block)(W, ib, ib, rows, rows, &tile_view);
+        multiply_matrices_accumulate(&tile_view, &h_i, &c_i);
+
+        /* Blocks right of the diagonal contribute to both block rows */
+        for (jb = ib + rows; jb < n; jb += PACKED_BLOCK)
+        {
+            cols = n - jb < PACKED_BLOCK ? n - jb : PACKED_BLOCK;
+            tile_view = matrix_view(tile, 0, 0, rows, cols);
+            PACKED_NAME(copy_packed_block)(W, ib, jb, rows, cols, &tile_view);
+
+            /* C_I += W_IJ * H_J */
+            h_j = matrix_view(H, jb, 0, cols, k);
+            multiply_matrices_accumulate(&tile_view, &h_j, &c_i);
+
+            /* C_J += (H_I^T * W_IJ)^T */
+            x_T_view = matrix_view(x_T, 0, 0, k, cols);
+            multiply_matrices_into(&h_T_view, &tile_view, &x_T_view);
+            for (j = 0; j < cols; j++)
+            {
+                c_row = MATRIX_ROW(C, jb + j);
+                for (l = 0; l < k; l++)
+                {
+                    c_row[l] += MATRIX_AT(&x_T_view, l, j);
+                }
+            }
+        }
+    }
+
+    free_matrix(tile);
+    free_matrix(h_T);
+    free_matrix(x_T);
+}
+
+/* Helper function to calculate W * H for a packed W (a w_product_fn) */
+static void PACKED_NAME(packed_w_product)(const void *W, const matrix_t *H, matrix_t *WH)
+{
+    PACKED_NAME(multiply_packed_into)((const PACKED_TYPE *)W, H, WH);
+}
+
+/* Function to optimize H using the iterative update rule with a packed W */
+matrix_t *PACKED_NAME(optimize_h_packed)(const matrix_t *H, const PACKED_TYPE *W)
+{
+    return optimize_h_with(H, W, PACKED_NAME(packed_w_product));
+}
+
+/* Function to optimize H with a packed W with the given options */
+matrix_t *PACKED_NAME(optimize_h_packed_options)(const matrix_t *H, const PACKED_TYPE *W,
+                                                 const solver_options_t *options, symnmf_stats_t *stats)
+{
+    if (stats != NULL)
+        stats->w_squared_norm = PACKED_NAME(packed_matrix_squared_norm)(W);
+    return optimize_h_with_options(H, W, PACKED_NAME(packed_w_product), options, stats);
+}
+
+/* Function to optimize a batch of H matrices against a packed W */
+void PACKED_NAME(optimize_h_packed_batch)(const matrix_t *const *initial_H, int count, const PACKED_TYPE *W,
+                                          const solver_options_t *options, matrix_t **final_H, double *objectives,
+                                          int *iterations)
+{
+    optimize_h_batch(initial_H, count, W, PACKED_NAME(packed_w_product), PACKED_NAME(packed_matrix_squared_norm)(W),
+                     options, final_H, objectives, iterations);
+}
+
+/* Function to run the whole symNMF pipeline on the data points */
+matrix_t *PACKED_NAME(symnmf_from_data)(const matrix_t *data, int k, unsigned long seed, const matrix_t *initial_H,
+                                        const solver_options_t *options, symnmf_stats_t *stats)
+{
+    PACKED_TYPE *W;
+    matrix_t *H, *final_H;
+    double *degrees, time = 0.0;
+    rng_t rng;
+
+    /* W = D^(-1/2) A D^(-1/2), normalized in place in packed storage; each stage timed with stats */
+    if (stats != NULL)
+        time = wall_seconds();
+    W = PACKED_NAME(calculate_packed_similarity_matrix)(data);
+    if (stats != NULL)
+    {
+        stats->similarity_seconds = wall_seconds() - time;
+        time = wall_seconds();
+    }
+    degrees = PACKED_NAME(calculate_packed_degree_vector)(W);
+    if (stats != NULL)
+    {
+        stats->degree_seconds = wall_seconds() - time;
+        time = wall_seconds();
+    }
+    PACKED_NAME(normalize_packed_similarity_matrix)(W, degrees);
+    free(degrees);
+    if (stats != NULL)
+        stats->normalize_seconds = wall_seconds() - time;
+
+    if (initial_H != NULL)
+    {
+        final_H = PACKED_NAME(optimize_h_packed_options)(initial_H, W, options, stats);
+    }
+    else
+    {
+        rng_seed(&rng, seed);
+        H = initialize_h(data->rows, k, PACKED_NAME(packed_matrix_mean)(W), &rng);
+        final_H = PACKED_NAME(optimize_h_packed_options)(H, W, options, stats);
+        free_matrix(H);
+    }
+
+    PACKED_NAME(free_packed_matrix)(W);
+    return final_H;
+}
+
+/* Function to run the symNMF pipeline for a batch of (k, seed) pairs, building W once */
+void PACKED_NAME(symnmf_batch_from_data)(const matrix_t *data, int count, const int *ks, const unsigned long *seeds,
+                                         const solver_options_t *options, matrix_t **final_H, double *objectives,
+                                         int *iterations)
+{
+    PACKED_TYPE *W;
+    matrix_t **initial_H;
+    double *degrees, mean;
+    rng_t rng;
+    int m; /* Declare loop variable at the beginning of the block */
+
+    W = PACKED_NAME(calculate_packed_similarity_matrix)(data);
+    degrees = PACKED_NAME(calculate_packed_degree_vector)(W);
+    PACKED_NAME(normalize_packed_similarity_matrix)(W, degrees);
+    free(degrees);
+    mean = PACKED_NAME(packed_matrix_mean)(W);
+
+    /* Each member starts where a single run with its k and seed would */
+    initial_H = (matrix_t **)malloc((size_t)(count > 0 ? count : 1) * sizeof(matrix_t *));
+    if (initial_H == NULL)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    for (m = 0; m < count; m++)
+    {
+        rng_seed(&rng, seeds[m]);
+        initial_H[m] = initialize_h(data->rows, ks[m], mean, &rng);
+    }
+
+    PACKED_NAME(optimize_h_packed_batch)((const matrix_t *const *)initial_H, count, W, options, final_H, objectives,
+                                         iterations);
+
+    for (m = 0; m < count; m++)
+    {
+        free_matrix(initial_H[m]);
+    }
+    free(initial_H);
+    PACKED_NAME(free_packed_matrix)(W);
+}
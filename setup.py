@@ -1,14 +1,41 @@
-from setuptools import setup, Extension
-
-# Define the C extension module
-symnmf_module = Extension(
-    'symnmfmodule',  # The name of the extension module
-    sources=['symnmfmodule.c', 'symnmf.c'],  # Source files for the extension
-)
-
-setup(
-    name='symnmfmodule',  # The name of your package
-    version='0.1.0', # The version of your package
-    description='Symmetric Non-negative Matrix Factorization clustering', # A short description
-    ext_modules=[symnmf_module], # List of extension modules to build
-)
+import os
+from setuptools import setup, Extension
+
+# Optional external CBLAS backend: SYMNMF_BLAS names the library to link
+# (e.g. SYMNMF_BLAS=openblas), SYMNMF_BLAS_INCLUDE the directory holding cblas.h
+define_macros = []
+libraries = []
+include_dirs = []
+if os.environ.get('SYMNMF_BLAS'):
+    define_macros.append(('SYMNMF_USE_CBLAS', None))
+    libraries.append(os.environ['SYMNMF_BLAS'])
+    if os.environ.get('SYMNMF_BLAS_INCLUDE'):
+        include_dirs.append(os.environ['SYMNMF_BLAS_INCLUDE'])
+
+# No fused multiply-adds beyond the explicit ones: the exponential kernels rely on it
+# to give the same bits on every CPU (the Makefile's -ansi already implies it)
+extra_compile_args = ['-ffp-contract=off']
+
+# Optional OpenMP build: set SYMNMF_OPENMP=1 (threads set with symnmfmodule.set_threads)
+extra_link_args = []
+if os.environ.get('SYMNMF_OPENMP'):
+    extra_compile_args.append('-fopenmp')
+    extra_link_args.append('-fopenmp')
+
+# Define the C extension module
+symnmf_module = Extension(
+    'symnmfmodule',  # The name of the extension module
+    sources=['symnmfmodule.c', 'symnmf.c', 'gemm.c', 'packed.c', 'sparse.c', 'io.c', 'mapped.c', 'solvers.c', 'kmeans.c', 'silhouette.c', 'incremental.c'],  # Source files for the extension
+    define_macros=define_macros,
+    libraries=libraries,
+    include_dirs=include_dirs,
+    extra_compile_args=extra_compile_args,
+    extra_link_args=extra_link_args,
+)
+
+setup(
+    name='symnmfmodule',  # The name of your package
+    version='0.1.0', # The version of your package
+    description='Symmetric Non-negative Matrix Factorization clustering', # A short description
+    ext_modules=[symnmf_module], # List of extension modules to build
+)
@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "symnmf.h" /* Include the header file */
+
+/*
+ * Silhouette scores without the n x n distance matrix.
+ * The distances come in SIMILARITY_TILE tiles from the kernel of the
+ * similarity matrix (calculate_squared_distance_tile), and every tile is
+ * folded straight into per-point, per-cluster sums of distances, so memory
+ * stays O(n * clusters). Several labelings of the same points share each
+ * tile: the square root is taken once and added to the sums of every
+ * labeling. Each row block of tiles computes its rows in full (both
+ * triangles), so that the row blocks can be shared out between threads
+ * without two threads ever updating the same sums.
+ * The score is the one of sklearn.metrics.silhouette_score: the mean over
+ * the points of (b - a) / max(a, b), with a the mean distance to the other
+ * points of the cluster, b the smallest mean distance to another cluster,
+ * and 0 for the points of a cluster of one.
+ */
+
+/* Function to check that a labeling can be scored */
+int valid_labeling(const int *labels, int n, int clusters)
+{
+    int *sizes;
+    int i, used = 0; /* Declare loop variables at the beginning of the block */
+
+    if (clusters < 1)
+        return 0;
+    sizes = (int *)calloc((size_t)clusters, sizeof(int));
+    if (sizes == NULL)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    for (i = 0; i < n; i++)
+    {
+        if (labels[i] < 0 || labels[i] >= clusters)
+        {
+            free(sizes);
+            return 0;
+        }
+        if (sizes[labels[i]]++ == 0)
+            used++;
+    }
+    free(sizes);
+    return used >= 2 && used <= n - 1; /* As sklearn requires */
+}
+
+/* Helper function to calculate the silhouette score of one labeling from its sums of distances */
+static double labeling_score(const int *labels, int n, int clusters, const double *sums)
+{
+    const double *point_sums;
+    double a, b, mean, total = 0.0;
+    int *sizes;
+    int i, c; /* Declare loop variables at the beginning of the block */
+
+    sizes = (int *)calloc((size_t)clusters, sizeof(int));
+    if (sizes == NULL)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    for (i = 0; i < n; i++)
+    {
+        sizes[labels[i]]++;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        if (sizes[labels[i]] == 1)
+            continue; /* A cluster of one scores 0 */
+        point_sums = sums + (size_t)i * (size_t)clusters;
+        a = point_sums[labels[i]] / (sizes[labels[i]] - 1);
+        b = HUGE_VAL;
+        for (c = 0; c < clusters; c++)
+        {
+            if (c == labels[i] || sizes[c] == 0)
+                continue;
+            mean = point_sums[c] / sizes[c];
+            if (mean < b)
+                b = mean;
+        }
+        if (a > 0.0 || b > 0.0)
+            total += (b - a) / (a > b ? a : b);
+    }
+
+    free(sizes);
+    return total / n;
+}
+
+/* Function to calculate the silhouette scores of several labelings of the same data points */
+void silhouette_scores(const matrix_t *data, const int *const *labelings, const int *clusters, int count,
+                       double *scores)
+{
+    matrix_t *data_T, *tile, tile_view;
+    double **sums, *tile_row, *point_sums, distance;
+    double *sq_norms;
+    const int *labels;
+    int i, j, m, ib, jb, tile_rows, tile_cols, n = data->rows; /* Declare loop variables at the beginning of the block */
+
+    data_T = calculate_Ht_matrix(data);
+    sq_norms = calculate_squared_norms(data);
+    sums = (double **)malloc((size_t)(count > 0 ? count : 1) * sizeof(double *));
+    if (sums == NULL)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    for (m = 0; m < count; m++)
+    {
+        sums[m] = (double *)calloc((size_t)n * (size_t)clusters[m], sizeof(double));
+        if (sums[m] == NULL)
+        {
+            printf("An Error Has Occurred\n");
+            exit(1);
+        }
+    }
+
+    /* Per point and cluster, the sum of the distances to the cluster's points */
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(get_thread_count()) schedule(dynamic, 1) private(i, j, m, jb, tile_rows, tile_cols, tile, tile_view, tile_row, point_sums, distance, labels)
+#endif
+    for (ib = 0; ib < n; ib += SIMILARITY_TILE)
+    {
+        tile_rows = n - ib < SIMILARITY_TILE ? n - ib : SIMILARITY_TILE;
+        tile = allocate_matrix(tile_rows, SIMILARITY_TILE);
+        for (jb = 0; jb < n; jb += SIMILARITY_TILE)
+        {
+            tile_cols = n - jb < SIMILARITY_TILE ? n - jb : SIMILARITY_TILE;
+            tile_view = matrix_view(tile, 0, 0, tile_rows, tile_cols);
+            calculate_squared_distance_tile(data, data_T, sq_norms, ib, jb, &tile_view);
+            for (i = 0; i < tile_rows; i++)
+            {
+                tile_row = MATRIX_ROW(&tile_view, i);
+                for (j = 0; j < tile_cols; j++)
+                {
+                    distance = sqrt(tile_row[j]);
+                    for (m = 0; m < count; m++)
+                    {
+                        labels = labelings[m];
+                        point_sums = sums[m] + (size_t)(ib + i) * (size_t)clusters[m];
+                        point_sums[labels[jb + j]] += distance;
+                    }
+                }
+            }
+        }
+        free_matrix(tile);
+    }
+
+    for (m = 0; m < count; m++)
+    {
+        scores[m] = labeling_score(labelings[m], n, clusters[m], sums[m]);
+        free(sums[m]);
+    }
+    free(sums);
+    free(sq_norms);
+    free_matrix(data_T);
+}
@@ -0,0 +1,457 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h> /* Required for strcmp, memcpy */
+#include "symnmf.h" /* Include the header file */
+
+/*
+ * Alternative H update engines, selected by solver_options_t.method.
+ * Each performs one iteration from H into H_new like update_h_iteration_into,
+ * computing W * H with the same product kernel, so every storage format of
+ * W works with every engine.
+ *  - nesterov: the damped multiplicative update applied at an extrapolated
+ *    point, with the momentum restarted whenever the objective at the
+ *    extrapolated point goes up. The extrapolation is taken in log space,
+ *    H (H / H_previous)^c, which suits multiplicative steps: it keeps every
+ *    element positive, so none can get stuck at zero.
+ *  - bcd: a proximal alternating nonnegative least squares step. Each row
+ *    of H_new minimizes ||W_i - h H^T||^2 + alpha ||h - H_i||^2 over h >= 0,
+ *    a k-variable problem on the k x k Gram matrix solved by a few sweeps of
+ *    coordinate descent.
+ * Batched solving runs several H (different seeds and/or k) against one W:
+ * the points the members evaluate are placed side by side, so that every
+ * iteration computes a single wide W * [H_1 H_2 ...] product, and each
+ * member then takes its step from its own columns of the result. Members
+ * that converge drop out of the product.
+ */
+
+/* Largest factor by which the nesterov extrapolation may scale an element (or its inverse) */
+#define NESTEROV_MAX_RATIO 2.0
+
+/* Proximal weight of the bcd engine, relative to the mean diagonal of H^T * H */
+#define BCD_PROXIMAL_SCALE 0.3
+
+/* Coordinate descent sweeps per row and iteration in the bcd engine */
+#define BCD_SWEEPS 2
+
+/* Names of the engines, indexed by SOLVER_* */
+static const char *const solver_names[SOLVER_COUNT] = {"multiplicative", "nesterov", "bcd"};
+
+/* Helper function to look up an update engine by name */
+int solver_method_from_name(const char *name)
+{
+    int method; /* Declare loop variable at the beginning of the block */
+
+    for (method = 0; method < SOLVER_COUNT; method++)
+    {
+        if (strcmp(name, solver_names[method]) == 0)
+            return method;
+    }
+    return -1;
+}
+
+/* Helper function to get the name of an update engine */
+const char *solver_method_name(int method)
+{
+    return method >= 0 && method < SOLVER_COUNT ? solver_names[method] : "unknown";
+}
+
+/* Helper function to sum per-thread partial sums in thread order */
+static double sum_partials(const double *partials, int threads)
+{
+    double sum = 0.0;
+    int t; /* Declare loop variable at the beginning of the block */
+
+    for (t = 0; t < threads; t++)
+    {
+        sum += partials[t];
+    }
+    return sum;
+}
+
+/* Helper function to advance the Nesterov sequence, t_(k+1) = (1 + sqrt(1 + 4 t_k^2)) / 2 */
+static double next_nesterov_momentum(double momentum)
+{
+    return (1.0 + sqrt(1.0 + 4.0 * momentum * momentum)) / 2.0;
+}
+
+/* Helper function to copy the elements of a matrix into another of the same shape */
+static void copy_matrix_into(const matrix_t *source, matrix_t *target)
+{
+    int i; /* Declare loop variable at the beginning of the block */
+
+    for (i = 0; i < source->rows; i++)
+    {
+        memcpy(MATRIX_ROW(target, i), MATRIX_ROW(source, i), (size_t)source->cols * sizeof(double));
+    }
+}
+
+/* Helper function to calculate the extrapolated point of the nesterov engine
+ * The momentum buffers are allocated in the workspace on first use.
+ */
+matrix_t *nesterov_extrapolate(const matrix_t *H, h_workspace_t *workspace)
+{
+    const double *h_row, *p_row;
+    double *y_row, coefficient, value;
+    int i, j, n = H->rows, k = H->cols; /* Declare loop variables at the beginning of the block */
+
+    if (workspace->previous == NULL)
+    {
+        workspace->previous = copy_matrix(H);
+        workspace->extrapolated = allocate_matrix(n, k);
+        workspace->momentum = 1.0;
+        workspace->last_value = HUGE_VAL;
+    }
+
+    /* Y = H (H / H_previous)^c, with c from the usual t_k sequence */
+    coefficient = (workspace->momentum - 1.0) / next_nesterov_momentum(workspace->momentum);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(get_thread_count()) schedule(static) private(h_row, p_row, y_row, value, j) if (n >= PARALLEL_MIN_ROWS)
+#endif
+    for (i = 0; i < n; i++)
+    {
+        h_row = MATRIX_ROW(H, i);
+        p_row = MATRIX_ROW(workspace->previous, i);
+        y_row = MATRIX_ROW(workspace->extrapolated, i);
+        for (j = 0; j < k; j++)
+        {
+            if (h_row[j] <= 0.0 || p_row[j] <= 0.0 || coefficient == 0.0)
+            {
+                y_row[j] = h_row[j];
+                continue;
+            }
+            value = pow(h_row[j] / p_row[j], coefficient);
+            if (value > NESTEROV_MAX_RATIO)
+                value = NESTEROV_MAX_RATIO;
+            else if (value < 1.0 / NESTEROV_MAX_RATIO)
+                value = 1.0 / NESTEROV_MAX_RATIO;
+            y_row[j] = h_row[j] * value;
+        }
+    }
+    return workspace->extrapolated;
+}
+
+/* Function to perform the step of the nesterov engine from the point nesterov_extrapolate calculated */
+double nesterov_step_into(const matrix_t *H, const void *W, w_product_fn product,
+                          h_workspace_t *workspace, matrix_t *H_new, double beta)
+{
+    const double *h_row, *wh_row;
+    double *y_row, *new_row, *partials, partial, value, diff;
+    int i, j, threads, n = H->rows, k = H->cols; /* Declare loop variables at the beginning of the block */
+
+    /* Multiplicative step from Y; its W * Y and Y^T * Y are left in the workspace */
+    update_h_iteration_into(workspace->extrapolated, W, product, workspace, H_new, beta);
+
+    /* ||W - Y Y^T||^2 up to the constant ||W||^2; restart the momentum if it went up */
+    value = matrix_squared_norm(workspace->gram);
+    for (i = 0; i < n; i++)
+    {
+        y_row = MATRIX_ROW(workspace->extrapolated, i);
+        wh_row = MATRIX_ROW(workspace->WH, i);
+        for (j = 0; j < k; j++)
+        {
+            value -= 2.0 * y_row[j] * wh_row[j];
+        }
+    }
+    workspace->momentum = value > workspace->last_value ? 1.0 : next_nesterov_momentum(workspace->momentum);
+    workspace->last_value = value;
+
+    /* Remember H and measure the step from it (not from Y) */
+    copy_matrix_into(H, workspace->previous);
+    threads = get_thread_count();
+    partials = allocate_vector(threads);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads) if (n >= PARALLEL_MIN_ROWS) private(h_row, new_row, partial, diff, i, j)
+#endif
+    {
+        partial = 0.0;
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (i = 0; i < n; i++)
+        {
+            h_row = MATRIX_ROW(H, i);
+            new_row = MATRIX_ROW(H_new, i);
+            for (j = 0; j < k; j++)
+            {
+                diff = new_row[j] - h_row[j];
+                partial += diff * diff;
+            }
+        }
+        partials[get_thread_index()] = partial;
+    }
+    value = sum_partials(partials, threads);
+    free(partials);
+    return value;
+}
+
+/* Function to perform one iteration of the extrapolated (Nesterov-style) multiplicative update */
+double nesterov_iteration_into(const matrix_t *H, const void *W, w_product_fn product,
+                               h_workspace_t *workspace, matrix_t *H_new, double beta)
+{
+    nesterov_extrapolate(H, workspace);
+    return nesterov_step_into(H, W, product, workspace, H_new, beta);
+}
+
+/* Function to perform one iteration of the proximal block coordinate descent (ANLS) update
+ * Row i solves (H^T H + alpha I) h = (W H)_i + alpha H_i over h >= 0, starting from H_i.
+ */
+double bcd_iteration_into(const matrix_t *H, const void *W, w_product_fn product,
+                          h_workspace_t *workspace, matrix_t *H_new)
+{
+    const double *h_row, *wh_row, *g_row;
+    double *new_row, *partials, partial, alpha, residual, value, diff;
+    int i, j, l, sweep, threads, n = H->rows, k = H->cols; /* Declare loop variables at the beginning of the block */
+
+    /* Calculate H^T * H and W * H */
+    calculate_gram_matrix_into(H, workspace->gram);
+    product(W, H, workspace->WH);
+    workspace->evaluated = H;
+
+    /* Proximal weight from the scale of the Gram matrix */
+    alpha = 0.0;
+    for (j = 0; j < k; j++)
+    {
+        alpha += MATRIX_AT(workspace->gram, j, j);
+    }
+    alpha = BCD_PROXIMAL_SCALE * alpha / k + EPSILON_DIV;
+
+    threads = get_thread_count();
+    partials = allocate_vector(threads);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads) if (n >= PARALLEL_MIN_ROWS) private(h_row, wh_row, g_row, new_row, partial, residual, value, diff, i, j, l, sweep)
+#endif
+    {
+        partial = 0.0;
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (i = 0; i < n; i++)
+        {
+            h_row = MATRIX_ROW(H, i);
+            wh_row = MATRIX_ROW(workspace->WH, i);
+            new_row = MATRIX_ROW(H_new, i);
+            memcpy(new_row, h_row, (size_t)k * sizeof(double));
+            for (sweep = 0; sweep < BCD_SWEEPS; sweep++)
+            {
+                for (j = 0; j < k; j++)
+                {
+                    /* residual = b_j - (A x)_j with A = H^T H + alpha I and b = (W H)_i + alpha H_i */
+                    g_row = MATRIX_ROW(workspace->gram, j);
+                    residual = wh_row[j] + alpha * (h_row[j] - new_row[j]);
+                    for (l = 0; l < k; l++)
+                    {
+                        residual -= g_row[l] * new_row[l];
+                    }
+                    value = new_row[j] + residual / (g_row[j] + alpha);
+                    new_row[j] = value > 0.0 ? value : 0.0;
+                }
+            }
+            for (j = 0; j < k; j++)
+            {
+                diff = new_row[j] - h_row[j];
+                partial += diff * diff;
+            }
+        }
+        partials[get_thread_index()] = partial;
+    }
+    value = sum_partials(partials, threads);
+    free(partials);
+    return value;
+}
+
+/* Source of the W * H columns of one member of a batch */
+typedef struct
+{
+    const matrix_t *WH; /* The wide product for the active members */
+    int col;            /* First column of the member */
+} batch_slice_t;
+
+/* Helper function to hand a member its columns of the wide product (a w_product_fn; W is a batch_slice_t) */
+static void batch_slice_product(const void *W, const matrix_t *H, matrix_t *WH)
+{
+    const batch_slice_t *slice = (const batch_slice_t *)W;
+    int i; /* Declare loop variable at the beginning of the block */
+
+    for (i = 0; i < H->rows; i++)
+    {
+        memcpy(MATRIX_ROW(WH, i), MATRIX_ROW(slice->WH, i) + slice->col, (size_t)H->cols * sizeof(double));
+    }
+}
+
+/* Helper function to copy a matrix into the columns col .. col + cols - 1 of a wider one */
+static void copy_into_columns(const matrix_t *source, matrix_t *target, int col)
+{
+    int i; /* Declare loop variable at the beginning of the block */
+
+    for (i = 0; i < source->rows; i++)
+    {
+        memcpy(MATRIX_ROW(target, i) + col, MATRIX_ROW(source, i), (size_t)source->cols * sizeof(double));
+    }
+}
+
+/* Helper function to calculate ||W - H H^T||_F from W * H */
+static double batch_objective(const matrix_t *H, const matrix_t *WH, int col, double w_squared_norm)
+{
+    matrix_t *gram;
+    double trace = 0.0, value;
+    int i, j; /* Declare loop variables at the beginning of the block */
+
+    gram = calculate_gram_matrix(H);
+    for (i = 0; i < H->rows; i++)
+    {
+        for (j = 0; j < H->cols; j++)
+        {
+            trace += MATRIX_AT(H, i, j) * MATRIX_AT(WH, i, col + j);
+        }
+    }
+    value = w_squared_norm - 2.0 * trace + matrix_squared_norm(gram);
+    free_matrix(gram);
+    return value > 0.0 ? sqrt(value) : 0.0;
+}
+
+/* Function to optimize a batch of H matrices against the same W
+ * Every member runs the chosen engine with the shared options and stops on
+ * its own; the time budget covers the whole batch.
+ */
+void optimize_h_batch(const matrix_t *const *initial_H, int count, const void *W, w_product_fn product,
+                      double w_squared_norm, const solver_options_t *options,
+                      matrix_t **final_H, double *objectives, int *iterations)
+{
+    solver_options_t defaults;
+    h_workspace_t **workspaces;
+    const matrix_t **points;
+    matrix_t *wide = NULL, *wide_WH = NULL, *H, *H_new;
+    batch_slice_t slice;
+    double frobenius_diff, start = 0.0;
+    int *current, *active;
+    int m, iter, col, width = -1, active_count = count, n; /* Declare loop variables at the beginning of the block */
+
+    if (count <= 0)
+        return;
+    if (options == NULL)
+    {
+        default_solver_options(&defaults);
+        options = &defaults;
+    }
+    if (options->time_budget > 0.0)
+        start = wall_seconds();
+    n = initial_H[0]->rows;
+    workspaces = (h_workspace_t **)malloc((size_t)count * sizeof(h_workspace_t *));
+    points = (const matrix_t **)malloc((size_t)count * sizeof(matrix_t *));
+    current = (int *)malloc((size_t)count * sizeof(int));
+    active = (int *)malloc((size_t)count * sizeof(int));
+    if (workspaces == NULL || points == NULL || current == NULL || active == NULL)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    for (m = 0; m < count; m++)
+    {
+        workspaces[m] = allocate_h_workspace(n, initial_H[m]->cols);
+        copy_matrix_into(initial_H[m], workspaces[m]->H[0]);
+        current[m] = 0;
+        active[m] = 1;
+        iterations[m] = 0;
+    }
+
+    for (iter = 0; iter < options->max_iter && active_count > 0; iter++)
+    {
+        /* The points the active members evaluate, side by side */
+        col = 0;
+        for (m = 0; m < count; m++)
+        {
+            if (!active[m])
+                continue;
+            H = workspaces[m]->H[current[m]];
+            points[m] = options->method == SOLVER_NESTEROV ? nesterov_extrapolate(H, workspaces[m]) : H;
+            col += H->cols;
+        }
+        if (col != width)
+        {
+            /* Members dropped out: narrow the product */
+            free_matrix(wide);
+            free_matrix(wide_WH);
+            width = col;
+            wide = allocate_matrix(n, width);
+            wide_WH = allocate_matrix(n, width);
+        }
+        col = 0;
+        for (m = 0; m < count; m++)
+        {
+            if (!active[m])
+                continue;
+            copy_into_columns(points[m], wide, col);
+            col += points[m]->cols;
+        }
+
+        /* One product for the whole batch */
+        product(W, wide, wide_WH);
+
+        /* Each member steps from its own columns */
+        slice.WH = wide_WH;
+        col = 0;
+        for (m = 0; m < count; m++)
+        {
+            if (!active[m])
+                continue;
+            slice.col = col;
+            col += points[m]->cols;
+            H = workspaces[m]->H[current[m]];
+            H_new = workspaces[m]->H[1 - current[m]];
+            if (options->method == SOLVER_NESTEROV)
+                frobenius_diff = nesterov_step_into(H, &slice, batch_slice_product, workspaces[m], H_new, options->beta);
+            else if (options->method == SOLVER_BCD)
+                frobenius_diff = bcd_iteration_into(H, &slice, batch_slice_product, workspaces[m], H_new);
+            else
+                frobenius_diff = update_h_iteration_into(H, &slice, batch_slice_product, workspaces[m], H_new,
+                                                         options->beta);
+            current[m] = 1 - current[m];
+            iterations[m]++;
+            if (h_converged(options, frobenius_diff, H_new))
+            {
+                active[m] = 0;
+                active_count--;
+            }
+        }
+
+        if (options->time_budget > 0.0 && wall_seconds() - start >= options->time_budget)
+        {
+            break; /* Out of time: every member returns its latest H */
+        }
+    }
+
+    /* Hand the results over and measure each with one more wide product */
+    width = 0;
+    for (m = 0; m < count; m++)
+    {
+        final_H[m] = workspaces[m]->H[current[m]];
+        workspaces[m]->H[current[m]] = NULL;
+        free_h_workspace(workspaces[m]);
+        width += final_H[m]->cols;
+    }
+    free_matrix(wide);
+    free_matrix(wide_WH);
+    wide = allocate_matrix(n, width);
+    wide_WH = allocate_matrix(n, width);
+    col = 0;
+    for (m = 0; m < count; m++)
+    {
+        copy_into_columns(final_H[m], wide, col);
+        col += final_H[m]->cols;
+    }
+    product(W, wide, wide_WH);
+    col = 0;
+    for (m = 0; m < count; m++)
+    {
+        objectives[m] = batch_objective(final_H[m], wide_WH, col, w_squared_norm);
+        col += final_H[m]->cols;
+    }
+
+    free_matrix(wide);
+    free_matrix(wide_WH);
+    free(workspaces);
+    free(points);
+    free(current);
+    free(active);
+}
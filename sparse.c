@@ -0,0 +1,434 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> /* Required for memset */
+#include "symnmf.h" /* Include the header file */
+
+/*
+ * Sparse affinity mode for large n.
+ * The Gaussian affinity is kept only for the k nearest neighbours of each
+ * point and/or for pairs above a threshold, stored symmetrically in CSR form.
+ * The graph is found by blocked brute force over upper-triangle tiles of the
+ * similarity matrix, so memory stays O(n * neighbors) instead of O(n^2),
+ * and the H update multiplies by W with a sparse-dense product.
+ * The graph search itself runs on one thread (each affinity updates the
+ * heaps of two points); the row-wise stages after it are parallel with OpenMP.
+ */
+
+/* One stored affinity (i, j, A_ij) collected while building the graph */
+typedef struct
+{
+    int row;
+    int col;
+    double value;
+} sparse_entry_t;
+
+/* Growable list of affinities */
+typedef struct
+{
+    sparse_entry_t *entries;
+    size_t count;
+    size_t capacity;
+} entry_list_t;
+
+/* Helper function to append an affinity to a list, growing it as needed */
+static void append_entry(entry_list_t *list, int row, int col, double value)
+{
+    sparse_entry_t *grown;
+
+    if (list->count == list->capacity)
+    {
+        list->capacity = list->capacity > 0 ? 2 * list->capacity : 1024;
+        grown = (sparse_entry_t *)realloc(list->entries, list->capacity * sizeof(sparse_entry_t));
+        if (grown == NULL)
+        {
+            free(list->entries);
+            printf("An Error Has Occurred\n");
+            exit(1);
+        }
+        list->entries = grown;
+    }
+    list->entries[list->count].row = row;
+    list->entries[list->count].col = col;
+    list->entries[list->count].value = value;
+    list->count++;
+}
+
+/* Helper function to offer a neighbour to the size-limited min-heap of one point
+ * The heap keeps the `neighbors` largest affinities seen so far, smallest at the root.
+ */
+static void offer_neighbor(double *heap_values, int *heap_cols, int *heap_size, int neighbors, double value, int col)
+{
+    int pos, child, parent; /* Declare loop variables at the beginning of the block */
+
+    if (*heap_size < neighbors)
+    {
+        /* Sift the new entry up from the end */
+        pos = (*heap_size)++;
+        while (pos > 0)
+        {
+            parent = (pos - 1) / 2;
+            if (heap_values[parent] <= value)
+                break;
+            heap_values[pos] = heap_values[parent];
+            heap_cols[pos] = heap_cols[parent];
+            pos = parent;
+        }
+        heap_values[pos] = value;
+        heap_cols[pos] = col;
+        return;
+    }
+    if (value <= heap_values[0])
+        return;
+
+    /* Replace the root and sift it down */
+    pos = 0;
+    while ((child = 2 * pos + 1) < neighbors)
+    {
+        if (child + 1 < neighbors && heap_values[child + 1] < heap_values[child])
+            child++;
+        if (heap_values[child] >= value)
+            break;
+        heap_values[pos] = heap_values[child];
+        heap_cols[pos] = heap_cols[child];
+        pos = child;
+    }
+    heap_values[pos] = value;
+    heap_cols[pos] = col;
+}
+
+/* Helper function to order the entries of a row by column */
+static int compare_entries_by_col(const void *a, const void *b)
+{
+    const sparse_entry_t *ea = (const sparse_entry_t *)a, *eb = (const sparse_entry_t *)b;
+    return (ea->col > eb->col) - (ea->col < eb->col);
+}
+
+/* Helper function to allocate an empty CSR matrix with room for nnz entries */
+csr_matrix_t *allocate_csr_matrix(int n, size_t nnz)
+{
+    csr_matrix_t *matrix;
+
+    matrix = (csr_matrix_t *)malloc(sizeof(csr_matrix_t));
+    if (matrix == NULL || n < 0)
+    {
+        free(matrix);
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    matrix->n = n;
+    matrix->nnz = nnz;
+    matrix->row_ptr = (size_t *)calloc((size_t)n + 1, sizeof(size_t));
+    matrix->col_idx = (int *)malloc((nnz > 0 ? nnz : 1) * sizeof(int));
+    matrix->values = (double *)malloc((nnz > 0 ? nnz : 1) * sizeof(double));
+    if (matrix->row_ptr == NULL || matrix->col_idx == NULL || matrix->values == NULL)
+    {
+        free_csr_matrix(matrix);
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    return matrix;
+}
+
+/* Helper function to free a CSR matrix */
+void free_csr_matrix(csr_matrix_t *matrix)
+{
+    if (matrix == NULL)
+        return;
+    free(matrix->row_ptr);
+    free(matrix->col_idx);
+    free(matrix->values);
+    free(matrix);
+}
+
+/* Helper function to build a symmetric CSR matrix from a list of affinities
+ * Every entry (i, j, v) is stored at both (i, j) and (j, i); an edge listed
+ * more than once is stored once.
+ */
+static csr_matrix_t *csr_from_symmetric_entries(int n, const entry_list_t *list)
+{
+    csr_matrix_t *matrix;
+    sparse_entry_t *by_row;
+    size_t *fill, e, start, end, out;
+    int i; /* Declare loop variable at the beginning of the block */
+
+    /* Count both directions of every edge per row */
+    fill = (size_t *)calloc((size_t)n + 1, sizeof(size_t));
+    by_row = (sparse_entry_t *)malloc((2 * list->count > 0 ? 2 * list->count : 1) * sizeof(sparse_entry_t));
+    if (fill == NULL || by_row == NULL)
+    {
+        free(fill);
+        free(by_row);
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    for (e = 0; e < list->count; e++)
+    {
+        fill[list->entries[e].row + 1]++;
+        fill[list->entries[e].col + 1]++;
+    }
+    for (i = 0; i < n; i++)
+    {
+        fill[i + 1] += fill[i];
+    }
+
+    /* Scatter into rows */
+    for (e = 0; e < list->count; e++)
+    {
+        by_row[fill[list->entries[e].row]++] = list->entries[e];
+        by_row[fill[list->entries[e].col]].row = list->entries[e].col;
+        by_row[fill[list->entries[e].col]].col = list->entries[e].row;
+        by_row[fill[list->entries[e].col]++].value = list->entries[e].value;
+    }
+
+    /* fill[i] now marks the end of row i; sort each row and drop duplicates */
+    matrix = allocate_csr_matrix(n, 2 * list->count);
+    out = 0;
+    start = 0;
+    for (i = 0; i < n; i++)
+    {
+        end = fill[i];
+        qsort(by_row + start, end - start, sizeof(sparse_entry_t), compare_entries_by_col);
+        for (e = start; e < end; e++)
+        {
+            if (e > start && by_row[e].col == by_row[e - 1].col)
+                continue;
+            matrix->col_idx[out] = by_row[e].col;
+            matrix->values[out] = by_row[e].value;
+            out++;
+        }
+        matrix->row_ptr[i + 1] = out;
+        start = end;
+    }
+    matrix->nnz = out;
+
+    free(fill);
+    free(by_row);
+    return matrix;
+}
+
+/* Helper function to check that the kNN graph of n points fits in memory sizes */
+int sparse_neighbors_fit(int n, int neighbors)
+{
+    size_t limit;
+
+    if (n < 0 || neighbors < 0)
+        return 0;
+    if (neighbors > n - 1)
+        neighbors = n - 1;
+    if (neighbors == 0)
+        return 1;
+    /* The CSR matrix stores both directions of every neighbour (2 * n * neighbors values) */
+    limit = (size_t)-1 / (2 * sizeof(double));
+    return (size_t)neighbors <= limit / (size_t)n;
+}
+
+/* Function to calculate a sparse similarity matrix
+ * Upper-triangle tiles of the similarity matrix are computed one at a time
+ * with calculate_similarity_tile; each affinity is offered to the neighbour
+ * heaps of both of its points (kNN mode) or kept directly (threshold mode).
+ */
+csr_matrix_t *calculate_sparse_similarity_matrix(const matrix_t *data, int neighbors, double threshold)
+{
+    csr_matrix_t *affinity_matrix;
+    matrix_t *data_T, *scratch, tile_view;
+    entry_list_t list;
+    double *sq_norms, *heap_values = NULL, value;
+    const double *tile_row;
+    int *heap_cols = NULL, *heap_size = NULL;
+    int i, j, ib, jb, row, col, tile_rows, tile_cols, n = data->rows; /* Declare loop variables at the beginning of the block */
+
+    /* Without neighbours or a positive threshold every pair would be kept, denser than W itself */
+    if ((neighbors == 0 && threshold <= 0.0) || !sparse_neighbors_fit(n, neighbors))
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    if (neighbors > n - 1)
+        neighbors = n - 1;
+
+    list.entries = NULL;
+    list.count = 0;
+    list.capacity = 0;
+    if (neighbors > 0)
+    {
+        heap_values = (double *)malloc((size_t)n * (size_t)neighbors * sizeof(double));
+        heap_cols = (int *)malloc((size_t)n * (size_t)neighbors * sizeof(int));
+        heap_size = (int *)calloc((size_t)n, sizeof(int));
+        if (heap_values == NULL || heap_cols == NULL || heap_size == NULL)
+        {
+            printf("An Error Has Occurred\n");
+            exit(1);
+        }
+    }
+
+    data_T = calculate_Ht_matrix(data);
+    sq_norms = calculate_squared_norms(data);
+    scratch = allocate_matrix(SIMILARITY_TILE, SIMILARITY_TILE);
+
+    for (ib = 0; ib < n; ib += SIMILARITY_TILE)
+    {
+        tile_rows = n - ib < SIMILARITY_TILE ? n - ib : SIMILARITY_TILE;
+        for (jb = ib; jb < n; jb += SIMILARITY_TILE)
+        {
+            tile_cols = n - jb < SIMILARITY_TILE ? n - jb : SIMILARITY_TILE;
+            tile_view = matrix_view(scratch, 0, 0, tile_rows, tile_cols);
+            calculate_similarity_tile(data, data_T, sq_norms, ib, jb, &tile_view);
+
+            for (i = 0; i < tile_rows; i++)
+            {
+                row = ib + i;
+                tile_row = MATRIX_ROW(&tile_view, i);
+                for (j = row + 1 > jb ? row + 1 - jb : 0; j < tile_cols; j++)
+                {
+                    value = tile_row[j];
+                    if (value < threshold || value <= 0.0)
+                        continue;
+                    col = jb + j;
+                    if (neighbors > 0)
+                    {
+                        offer_neighbor(heap_values + (size_t)row * neighbors, heap_cols + (size_t)row * neighbors,
+                                       heap_size + row, neighbors, value, col);
+                        offer_neighbor(heap_values + (size_t)col * neighbors, heap_cols + (size_t)col * neighbors,
+                                       heap_size + col, neighbors, value, row);
+                    }
+                    else
+                    {
+                        append_entry(&list, row, col, value);
+                    }
+                }
+            }
+        }
+    }
+
+    /* The kNN graph is the union of every point's neighbour list */
+    if (neighbors > 0)
+    {
+        for (i = 0; i < n; i++)
+        {
+            for (j = 0; j < heap_size[i]; j++)
+            {
+                append_entry(&list, i, heap_cols[(size_t)i * neighbors + j], heap_values[(size_t)i * neighbors + j]);
+            }
+        }
+    }
+
+    affinity_matrix = csr_from_symmetric_entries(n, &list);
+
+    free(list.entries);
+    free(heap_values);
+    free(heap_cols);
+    free(heap_size);
+    free_matrix(scratch);
+    free(sq_norms);
+    free_matrix(data_T);
+    return affinity_matrix;
+}
+
+/* Function to calculate the degree vector (row sums) of a sparse similarity matrix */
+double *calculate_sparse_degree_vector(const csr_matrix_t *similarity_matrix)
+{
+    double *degrees, degree;
+    size_t e;
+    int i; /* Declare loop variable at the beginning of the block */
+
+    degrees = allocate_vector(similarity_matrix->n);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(get_thread_count()) schedule(static) private(degree, e) if (similarity_matrix->n >= PARALLEL_MIN_ROWS)
+#endif
+    for (i = 0; i < similarity_matrix->n; i++)
+    {
+        degree = 0.0;
+        for (e = similarity_matrix->row_ptr[i]; e < similarity_matrix->row_ptr[i + 1]; e++)
+        {
+            degree += similarity_matrix->values[e];
+        }
+        degrees[i] = degree;
+    }
+    return degrees;
+}
+
+/* Function to normalize a sparse similarity matrix in place, W_ij = A_ij / sqrt(d_i * d_j) */
+void normalize_sparse_similarity_matrix(csr_matrix_t *similarity_matrix, const double *degrees)
+{
+    double *inv_sqrt_degrees, scale;
+    size_t e;
+    int i; /* Declare loop variable at the beginning of the block */
+
+    inv_sqrt_degrees = calculate_inv_sqrt_degrees(degrees, similarity_matrix->n);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(get_thread_count()) schedule(static) private(scale, e) if (similarity_matrix->n >= PARALLEL_MIN_ROWS)
+#endif
+    for (i = 0; i < similarity_matrix->n; i++)
+    {
+        scale = inv_sqrt_degrees[i];
+        for (e = similarity_matrix->row_ptr[i]; e < similarity_matrix->row_ptr[i + 1]; e++)
+        {
+            similarity_matrix->values[e] = scale * similarity_matrix->values[e] * inv_sqrt_degrees[similarity_matrix->col_idx[e]];
+        }
+    }
+    free(inv_sqrt_degrees);
+}
+
+/* Helper function to calculate C = W * H for a sparse W into an existing matrix */
+void multiply_sparse_into(const csr_matrix_t *W, const matrix_t *H, matrix_t *C)
+{
+    const double *h_row;
+    double *c_row, w;
+    size_t e;
+    int i, l, k = H->cols; /* Declare loop variables at the beginning of the block */
+
+    /* Check if multiplication is possible */
+    if (H->rows != W->n || C->rows != W->n || C->cols != k)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(get_thread_count()) schedule(dynamic, PARALLEL_MIN_ROWS) private(h_row, c_row, w, e, l) if (W->n >= PARALLEL_MIN_ROWS)
+#endif
+    for (i = 0; i < W->n; i++)
+    {
+        c_row = MATRIX_ROW(C, i);
+        memset(c_row, 0, (size_t)k * sizeof(double));
+        for (e = W->row_ptr[i]; e < W->row_ptr[i + 1]; e++)
+        {
+            w = W->values[e];
+            h_row = MATRIX_ROW(H, W->col_idx[e]);
+            for (l = 0; l < k; l++)
+            {
+                c_row[l] += w * h_row[l];
+            }
+        }
+    }
+}
+
+/* Helper function to calculate W * H for a sparse W (a w_product_fn) */
+static void sparse_w_product(const void *W, const matrix_t *H, matrix_t *WH)
+{
+    multiply_sparse_into((const csr_matrix_t *)W, H, WH);
+}
+
+/* Function to optimize H using the iterative update rule with a sparse W */
+matrix_t *optimize_h_sparse(const matrix_t *H, const csr_matrix_t *W)
+{
+    return optimize_h_with(H, W, sparse_w_product);
+}
+
+/* Function to optimize H with a sparse W with the given options */
+matrix_t *optimize_h_sparse_options(const matrix_t *H, const csr_matrix_t *W, const solver_options_t *options,
+                                    symnmf_stats_t *stats)
+{
+    size_t e; /* Declare loop variable at the beginning of the block */
+
+    if (stats != NULL)
+    {
+        /* Both triangles are stored, so every element is counted once */
+        stats->w_squared_norm = 0.0;
+        for (e = 0; e < W->nnz; e++)
+        {
+            stats->w_squared_norm += W->values[e] * W->values[e];
+        }
+    }
+    return optimize_h_with_options(H, W, sparse_w_product, options, stats);
+}
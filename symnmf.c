@@ -1,484 +1,1163 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <math.h>
-#include <string.h> /* Required for strcmp */
-#include "symnmf.h" /* Include the header file */
-
-/*
- * C implementation of the symNMF functions.
- * Includes functions for calculating similarity matrix, diagonal degree matrix,
- * normalized similarity matrix, and optimizing H.
- * Also includes main function for standalone execution.
- */
-
-/* Helper function to allocate memory for a 2D array */
-double **allocate_matrix(int rows, int cols)
-{
-    double **matrix;
-    int i, j; /* Declare loop variable at the beginning of the block */
-
-    matrix = (double **)calloc(rows, sizeof(double *));
-    if (matrix == NULL)
-    {
-        printf("An Error Has Occurred\n");
-        exit(1);
-    }
-    for (i = 0; i < rows; i++)
-    {
-        matrix[i] = (double *)calloc(cols, sizeof(double));
-        if (matrix[i] == NULL)
-        {
-            /* Free previously allocated rows before exiting */
-            for (j = 0; j < i; j++)
-            {
-                free(matrix[j]);
-            }
-            free(matrix);
-            printf("An Error Has Occurred\n");
-            exit(1);
-        }
-    }
-    return matrix;
-}
-
-/* Helper function to free allocated memory for a 2D array */
-void free_matrix(double **matrix, int rows)
-{
-    int i; /* Declare loop variable at the beginning of the block */
-    if (matrix == NULL)
-        return;
-    for (i = 0; i < rows; i++)
-    {
-        free(matrix[i]);
-    }
-    free(matrix);
-}
-
-/* Helper function to calculate the squared Euclidean distance between two vectors */
-double squared_euclidean_distance(double *vec1, double *vec2, int d)
-{
-    double sum = 0.0;
-    int i;
-    for (i = 0; i < d; i++)
-    {
-        sum += pow(vec1[i] - vec2[i], 2);
-    }
-    return sum;
-}
-
-/* Helper function to calculate the Frobenius norm squared of the difference between two matrices */
-double frobenius_norm_squared_difference(double **matrix1, double **matrix2, int rows, int cols)
-{
-    double sum = 0.0;
-    int i, j; /* Declare loop variables at the beginning of the block */
-    for (i = 0; i < rows; i++)
-    {
-        for (j = 0; j < cols; j++)
-        {
-            sum += pow(matrix1[i][j] - matrix2[i][j], 2);
-        }
-    }
-    return sum;
-}
-
-/* Helper function to calculate matrix product C = A * B */
-double **multiply_matrices(double **A, double **B, int rows_A, int cols_A, int rows_B, int cols_B)
-{
-    double **C;
-    int i, j, l; /* Declare loop variables at the beginning of the block */
-
-    /* Check if multiplication is possible */
-    if (cols_A != rows_B)
-    {
-        printf("An Error Has Occurred\n");
-        exit(1);
-    }
-
-    C = allocate_matrix(rows_A, cols_B);
-
-    for (i = 0; i < rows_A; i++)
-    {
-        for (j = 0; j < cols_B; j++)
-        {
-            for (l = 0; l < cols_A; l++)
-            { /* Or rows_B */
-                C[i][j] += A[i][l] * B[l][j];
-            }
-        }
-    }
-    return C;
-}
-
-/* Function to calculate the similarity matrix */
-double **calculate_similarity_matrix(double **data, int n, int d)
-{
-    double **affinity_matrix, dist_sq;
-    int i, j; /* Declare loop variables at the beginning of the block */
-
-    affinity_matrix = allocate_matrix(n, n);
-
-    for (i = 0; i < n; i++)
-    {
-        for (j = 0; j < n; j++)
-        {
-            if (i == j)
-            {
-                affinity_matrix[i][j] = 0.0;
-            }
-            else
-            {
-                dist_sq = squared_euclidean_distance(data[i], data[j], d);
-                affinity_matrix[i][j] = exp(-dist_sq / 2.0);
-            }
-        }
-    }
-    return affinity_matrix;
-}
-
-/* Function to calculate the diagonal degree matrix */
-double **calculate_ddg_matrix(double **similarity_matrix, int n)
-{
-    double **degree_matrix, degree;
-    int i, j; /* Declare loop variables at the beginning of the block */
-
-    degree_matrix = allocate_matrix(n, n);
-
-    for (i = 0; i < n; i++)
-    {
-        degree = 0.0;
-        for (j = 0; j < n; j++)
-        {
-            degree += similarity_matrix[i][j];
-        }
-        degree_matrix[i][i] = degree;
-    }
-    return degree_matrix;
-}
-
-/* Function to calculate the normalized similarity matrix */
-double **calculate_normalized_similarity_matrix(double **similarity_matrix, double **ddg_matrix, int n)
-{
-    double **inv_sqrt_ddg, **temp_matrix, **normalized_matrix;
-    int i; /* Declare loop variable at the beginning of the block */
-
-    /* Calculate D^(-1/2) */
-    inv_sqrt_ddg = allocate_matrix(n, n);
-    for (i = 0; i < n; i++)
-    {
-        if (ddg_matrix[i][i] > 0)
-        { /* Avoid division by zero */
-            inv_sqrt_ddg[i][i] = 1.0 / sqrt(ddg_matrix[i][i]);
-        }
-        else
-        {
-            /* Handle cases where degree is zero, though problem assumes valid data */
-            inv_sqrt_ddg[i][i] = 0.0;
-        }
-    }
-
-    /* Calculate D^(-1/2) * A */
-    temp_matrix = multiply_matrices(inv_sqrt_ddg, similarity_matrix, n, n, n, n);
-
-    /* Calculate (D^(-1/2) * A) * D^(-1/2) */
-    normalized_matrix = multiply_matrices(temp_matrix, inv_sqrt_ddg, n, n, n, n);
-
-    free_matrix(inv_sqrt_ddg, n);
-    free_matrix(temp_matrix, n);
-
-    return normalized_matrix;
-}
-
-/* Helper function to calculate the transpose of a matrix */
-double** calculate_Ht_matrix(double** matrix, int rows, int cols) {
-    double** transposed_matrix;
-    int i, j; /* Declare loop variables at the beginning of the block */
-
-    transposed_matrix = allocate_matrix(cols, rows);
-
-    for (i = 0; i < rows; i++) {
-        for (j = 0; j < cols; j++) {
-            transposed_matrix[j][i] = matrix[i][j];
-        }
-    }
-    return transposed_matrix;
-}
-
-/* Helper function to perform one iteration of the H update rule */
-double** update_h_iteration(double** H, double** W, int n, int k) {
-    double** H_new, **H_T, **HH_T, **HHT_H, **WH;
-    int i, j; /* Declare loop variables at the beginning of the block */
-
-    H_new = allocate_matrix(n, k);
-
-    /* Calculate H^T */
-    H_T = calculate_Ht_matrix(H, n, k);
-
-    /* Calculate H * H^T */
-    HH_T = multiply_matrices(H, H_T, n, k, k, n);
-
-    /* Calculate (H * H^T) * H */
-    HHT_H = multiply_matrices(HH_T, H, n, n, n, k);
-
-    /* Calculate W * H */
-    WH = multiply_matrices(W, H, n, n, n, k);
-
-    /* Update H */
-    for (i = 0; i < n; i++) {
-        for (j = 0; j < k; j++) {
-            if (HHT_H[i][j] != 0)
-                H_new[i][j] = H[i][j] * (1 - BETA + BETA * (WH[i][j] / (HHT_H[i][j])));
-            else
-                H_new[i][j] = H[i][j] * (1 - BETA + BETA * (WH[i][j] / (HHT_H[i][j]+1e-6)));
-        }
-    }
-
-    /* Free temporary matrices */
-    free_matrix(H_T, k); /* Free H_T (k rows) */
-    free_matrix(HH_T, n);
-    free_matrix(HHT_H, n);
-    free_matrix(WH, n);
-
-    return H_new;
-}
-
-/* Function to optimize H using the iterative update rule */
-double **optimize_h(double **H, double **W, int n, int k)
-{
-    double **H_current, **H_prev, **H_new, frobenius_diff;
-    int iter, i, j; /* Declare loop variables at the beginning of the block */
-
-    H_current = allocate_matrix(n, k);
-    /* Copy initial H to H_current */
-    for (i = 0; i < n; i++)
-    {
-        for (j = 0; j < k; j++)
-        {
-            H_current[i][j] = H[i][j];
-        }
-    }
-
-    H_prev = allocate_matrix(n, k);
-
-    for (iter = 0; iter < MAX_ITER; iter++)
-    {
-        /* Copy H_current to H_prev for convergence check */
-        for (i = 0; i < n; i++)
-        {
-            for (j = 0; j < k; j++)
-            {
-                H_prev[i][j] = H_current[i][j];
-            }
-        }
-
-        /* Perform one update iteration */
-        H_new = update_h_iteration(H_current, W, n, k);
-
-        /* Free the previous H_current matrix */
-        free_matrix(H_current, n);
-        H_current = H_new; /* H_current now points to the newly updated matrix */
-
-        /* Check for convergence */
-        frobenius_diff = frobenius_norm_squared_difference(H_current, H_prev, n, k);
-
-        /* Check convergence condition */
-        if (frobenius_diff < EPSILON)
-        {
-            break; /* Converged */
-        }
-    }
-
-    /* Free the H_prev matrix */
-    free_matrix(H_prev, n);
-
-    /* Return the final optimized H matrix */
-    return H_current;
-}
-
-/* Helper function to read data from a file
- * Reads comma-separated float values into a 2D double array.
- * Assumes a rectangular matrix format.
- * Returns the 2D array and updates n (rows) and d (cols) by reference.
- */
-double **read_data_from_file(const char *file_name, int *n, int *d)
-{
-    FILE *file = fopen(file_name, "r");
-    char line[4096]; /* Assuming a maximum line length */
-    int i, j;        /* Declare loop variables at the beginning of the block */
-    double **data;
-
-    if (file == NULL)
-    {
-        printf("An Error Has Occurred\n");
-        exit(1);
-    }
-
-    /* Read the first line to determine the number of columns (d) */
-    if (fgets(line, sizeof(line), file) == NULL)
-    {
-        fclose(file);
-        *n = 0;
-        *d = 0;
-        return NULL; /* Empty file or read error */
-    }
-
-    *d = 0;
-    /* Count commas to determine number of columns */
-    for (i = 0; line[i] != '\0'; i++)
-    {
-        if (line[i] == ',')
-        {
-            (*d)++;
-        }
-    }
-    (*d)++; /* Add 1 for the last number */
-
-    /* Reset file pointer to the beginning to read data points */
-    fseek(file, 0, SEEK_SET);
-
-    /* Count the number of lines (n) */
-    *n = 0;
-    while (fgets(line, sizeof(line), file) != NULL)
-    {
-        (*n)++;
-    }
-
-    /* Reset file pointer again */
-    fseek(file, 0, SEEK_SET);
-
-    data = allocate_matrix(*n, *d);
-
-    /* Read data points */
-    for (i = 0; i < *n; i++)
-    {
-        for (j = 0; j < *d; j++)
-        {
-            if (fscanf(file, "%lf%*c", &data[i][j]) != 1)
-            {
-                /* Error reading data */
-                free_matrix(data, *n);
-                fclose(file);
-                printf("An Error Has Occurred\n");
-                exit(1);
-            }
-        }
-    }
-
-    fclose(file);
-    return data;
-}
-
-/* Helper function to print a matrix to standard output
- * Formats elements to 4 decimal places.
- */
-void print_matrix(double **matrix, int rows, int cols)
-{
-    int i, j; /* Declare loop variables at the beginning of the block */
-    for (i = 0; i < rows; i++)
-    {
-        for (j = 0; j < cols; j++)
-        {
-            printf("%.4f%s", matrix[i][j], (j == cols - 1) ? "" : ",");
-        }
-        printf("\n");
-    }
-}
-
-/* Helper function to process the goal and get the result matrix */
-double **process_goal_and_get_result(const char *goal, double **data, int n, int d)
-{
-    double **result_matrix = NULL, **similarity_matrix = NULL, **ddg_matrix = NULL;
-
-    if (strcmp(goal, "sym") == 0)
-    {
-        result_matrix = calculate_similarity_matrix(data, n, d);
-    }
-    else if (strcmp(goal, "ddg") == 0)
-    {
-        similarity_matrix = calculate_similarity_matrix(data, n, d);
-        if (similarity_matrix == NULL)
-            return NULL; /* Error handled in calculate_... */
-        result_matrix = calculate_ddg_matrix(similarity_matrix, n);
-        free_matrix(similarity_matrix, n); /* Free intermediate matrix */
-    }
-    else if (strcmp(goal, "norm") == 0)
-    {
-        similarity_matrix = calculate_similarity_matrix(data, n, d);
-        if (similarity_matrix == NULL)
-            return NULL; /* Error handled in calculate_... */
-        ddg_matrix = calculate_ddg_matrix(similarity_matrix, n);
-        if (ddg_matrix == NULL)
-        {
-            free_matrix(similarity_matrix, n);
-            return NULL; /* Error handled in calculate_... */
-        }
-        result_matrix = calculate_normalized_similarity_matrix(similarity_matrix, ddg_matrix, n);
-        free_matrix(similarity_matrix, n); /* Free intermediate matrices */
-        free_matrix(ddg_matrix, n);
-    }
-    else
-    {
-        /* Invalid goal - this case should ideally be caught before calling this function */
-        return NULL;
-    }
-
-    return result_matrix;
-}
-
-/* Main function for standalone execution */
-int main(int argc, char *argv[])
-{
-    char *goal, *file_name;
-    double **data, **result_matrix;
-    int n, d, result_rows, result_cols;
-
-    /* Check for correct number of arguments */
-    if (argc != 3)
-    {
-        printf("An Error Has Occurred\n");
-        return 1;
-    }
-
-    goal = argv[1];
-    file_name = argv[2];
-
-    /* Validate goal before reading data */
-    if (strcmp(goal, "sym") != 0 && strcmp(goal, "ddg") != 0 && strcmp(goal, "norm") != 0)
-    {
-        printf("An Error Has Occurred\n");
-        return 1;
-    }
-
-    data = read_data_from_file(file_name, &n, &d);
-
-    if (data == NULL || n == 0 || d == 0)
-    {
-        /* read_data_from_file handles errors and exits, but check for empty data */
-        if (data != NULL)
-            free_matrix(data, n);
-        printf("An Error Has Occurred\n");
-        return 1;
-    }
-
-    result_matrix = process_goal_and_get_result(goal, data, n, d);
-
-    /* Free the input data matrix as it's no longer needed */
-    free_matrix(data, n);
-
-    /* Print the result matrix */
-    if (result_matrix != NULL)
-    {
-        /* For sym, ddg, norm, result is n x n */
-        result_rows = n;
-        result_cols = n;
-        print_matrix(result_matrix, result_rows, result_cols);
-        free_matrix(result_matrix, result_rows); /* Free the result matrix */
-    }
-    else
-    {
-        /* Error occurred during processing */
-        printf("An Error Has Occurred\n");
-        return 1;
-    }
-
-    return 0;
-}
+#define _POSIX_C_SOURCE 199309L /* Required for clock_gettime */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h> /* Required for strcmp, strncmp, memcpy */
+#include <time.h>   /* Required for clock_gettime */
+#include "symnmf.h" /* Include the header file */
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+ * C implementation of the symNMF functions.
+ * Includes functions for calculating similarity matrix, diagonal degree matrix,
+ * normalized similarity matrix, and optimizing H.
+ * Also includes main function for standalone execution.
+ */
+
+/* Number of threads requested with set_thread_count, 0 until one is set
+ * Kept here rather than with omp_set_num_threads, which only affects the calling
+ * thread: every parallel region passes it in a num_threads clause, so the count
+ * holds whichever (Python) thread starts the computation. A region that sizes
+ * per-thread buffers reads it once and uses that value for both.
+ */
+static int thread_count = 0;
+
+/* Loads and stores of thread_count, atomic where the compiler offers it (it is shared between threads) */
+#if defined(__GNUC__) && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+#define LOAD_THREAD_COUNT() __atomic_load_n(&thread_count, __ATOMIC_RELAXED)
+#define STORE_THREAD_COUNT(value) __atomic_store_n(&thread_count, (value), __ATOMIC_RELAXED)
+#else
+#define LOAD_THREAD_COUNT() (thread_count)
+#define STORE_THREAD_COUNT(value) (thread_count = (value))
+#endif
+
+/* Helper function to set the number of threads used by the parallel loops */
+void set_thread_count(int threads)
+{
+    if (threads >= 1)
+        STORE_THREAD_COUNT(threads);
+}
+
+/* Helper function to get the number of threads used by the parallel loops */
+int get_thread_count(void)
+{
+#ifdef _OPENMP
+    int threads = LOAD_THREAD_COUNT();
+
+    return threads > 0 ? threads : omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+/* Helper function to get the index of the calling thread (0 outside a parallel region) */
+int get_thread_index(void)
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+/* Helper function to read a monotonic wall clock, in seconds */
+double wall_seconds(void)
+{
+#if defined(_OPENMP)
+    return omp_get_wtime();
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#else
+    return (double)clock() / CLOCKS_PER_SEC; /* Processor time where nothing better exists */
+#endif
+}
+
+/* Number of doubles in one MATRIX_ALIGNMENT-sized cache line */
+#define MATRIX_ALIGN_ELEMS ((int)(MATRIX_ALIGNMENT / sizeof(double)))
+
+/* Helper function to allocate a zero-initialized matrix in one aligned block */
+matrix_t *allocate_matrix(int rows, int cols)
+{
+    matrix_t *matrix;
+    size_t stride, offset;
+
+    matrix = (matrix_t *)malloc(sizeof(matrix_t));
+    if (matrix == NULL || rows < 0 || cols < 0)
+    {
+        free(matrix);
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+
+    /* Pad wide rows to whole cache lines so that every row starts aligned */
+    stride = (size_t)cols;
+    if (cols >= MATRIX_ALIGN_ELEMS)
+    {
+        stride = (stride + MATRIX_ALIGN_ELEMS - 1) / MATRIX_ALIGN_ELEMS * MATRIX_ALIGN_ELEMS;
+    }
+
+    /* Guard against size overflow before requesting the block */
+    if (stride > 0 && (size_t)rows > ((size_t)-1 - MATRIX_ALIGNMENT) / sizeof(double) / stride)
+    {
+        free(matrix);
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+
+    /* One zeroed block for all rows, over-allocated so the data can be aligned */
+    matrix->block = calloc((size_t)rows * stride * sizeof(double) + MATRIX_ALIGNMENT, 1);
+    if (matrix->block == NULL)
+    {
+        free(matrix);
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    offset = (MATRIX_ALIGNMENT - (size_t)matrix->block % MATRIX_ALIGNMENT) % MATRIX_ALIGNMENT;
+    matrix->data = (double *)((char *)matrix->block + offset);
+    matrix->rows = rows;
+    matrix->cols = cols;
+    matrix->stride = (int)stride;
+    return matrix;
+}
+
+/* Helper function to free a matrix allocated by allocate_matrix */
+void free_matrix(matrix_t *matrix)
+{
+    if (matrix == NULL)
+        return;
+    free(matrix->block);
+    free(matrix);
+}
+
+/* Helper function to copy a matrix into a newly allocated one */
+matrix_t *copy_matrix(const matrix_t *matrix)
+{
+    matrix_t *copy;
+    int i; /* Declare loop variable at the beginning of the block */
+
+    copy = allocate_matrix(matrix->rows, matrix->cols);
+    for (i = 0; i < matrix->rows; i++)
+    {
+        memcpy(MATRIX_ROW(copy, i), MATRIX_ROW(matrix, i), (size_t)matrix->cols * sizeof(double));
+    }
+    return copy;
+}
+
+/* Helper function to describe a block of a matrix without copying it
+ * The view shares the storage of the matrix (its block is NULL), so it must
+ * not be passed to free_matrix and must not outlive the matrix.
+ */
+matrix_t matrix_view(const matrix_t *matrix, int row, int col, int rows, int cols)
+{
+    matrix_t view;
+
+    view.data = (double *)MATRIX_ROW(matrix, row) + col;
+    view.block = NULL;
+    view.rows = rows;
+    view.cols = cols;
+    view.stride = matrix->stride;
+    return view;
+}
+
+/* Helper function to calculate the dot product of two vectors */
+double dot_product(const double *vec1, const double *vec2, int d)
+{
+    double sum = 0.0;
+    int i;
+    for (i = 0; i < d; i++)
+    {
+        sum += vec1[i] * vec2[i];
+    }
+    return sum;
+}
+
+/* Helper function to calculate the squared Euclidean distance between two vectors */
+double squared_euclidean_distance(const double *vec1, const double *vec2, int d)
+{
+    double sum = 0.0, diff;
+    int i;
+    for (i = 0; i < d; i++)
+    {
+        diff = vec1[i] - vec2[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+/* Helper function to calculate matrix product C = A * B */
+matrix_t *multiply_matrices(const matrix_t *A, const matrix_t *B)
+{
+    matrix_t *C;
+
+    /* Check if multiplication is possible */
+    if (A->cols != B->rows)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+
+    C = allocate_matrix(A->rows, B->cols);
+    multiply_matrices_into(A, B, C); /* Blocked kernel, see gemm.c */
+    return C;
+}
+
+/* Helper function to calculate the squared norm of every row of a matrix */
+double *calculate_squared_norms(const matrix_t *data)
+{
+    double *sq_norms;
+    int i; /* Declare loop variable at the beginning of the block */
+
+    sq_norms = allocate_vector(data->rows);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(get_thread_count()) schedule(static) if (data->rows >= PARALLEL_MIN_ROWS)
+#endif
+    for (i = 0; i < data->rows; i++)
+    {
+        sq_norms[i] = dot_product(MATRIX_ROW(data, i), MATRIX_ROW(data, i), data->cols);
+    }
+    return sq_norms;
+}
+
+/* Helper function to calculate one tile of the squared distances between the data points
+ * The inner products of the tile come from the matrix product kernel
+ * (||x_i - x_j||^2 = ||x_i||^2 + ||x_j||^2 - 2 x_i . x_j).
+ */
+void calculate_squared_distance_tile(const matrix_t *data, const matrix_t *data_T, const double *sq_norms,
+                                     int row, int col, matrix_t *tile)
+{
+    matrix_t rows_view, cols_view;
+    double *tile_row, dist_sq;
+    int i, j; /* Declare loop variables at the beginning of the block */
+
+    rows_view = matrix_view(data, row, 0, tile->rows, data->cols);
+    cols_view = matrix_view(data_T, 0, col, data->cols, tile->cols);
+
+    /* Inner products x_i . x_j of the tile */
+    multiply_matrices_into(&rows_view, &cols_view, tile);
+
+    for (i = 0; i < tile->rows; i++)
+    {
+        tile_row = MATRIX_ROW(tile, i);
+        for (j = 0; j < tile->cols; j++)
+        {
+            dist_sq = sq_norms[row + i] + sq_norms[col + j] - 2.0 * tile_row[j];
+            /* Rounding can make the distance of near-identical points negative */
+            tile_row[j] = dist_sq > 0.0 ? dist_sq : 0.0;
+        }
+
+        /* Exactly zero from a point to itself */
+        if (row + i >= col && row + i < col + tile->cols)
+        {
+            tile_row[row + i - col] = 0.0;
+        }
+    }
+}
+
+/* Helper function to calculate one tile of the similarity matrix
+ * exp(-||x_i - x_j||^2 / 2) of the squared distances, applied with vector_exp.
+ */
+void calculate_similarity_tile(const matrix_t *data, const matrix_t *data_T, const double *sq_norms,
+                               int row, int col, matrix_t *tile)
+{
+    double *tile_row;
+    int i, j; /* Declare loop variables at the beginning of the block */
+
+    calculate_squared_distance_tile(data, data_T, sq_norms, row, col, tile);
+
+    /* Turn them into exponents -||x_i - x_j||^2 / 2 and exponentiate */
+    for (i = 0; i < tile->rows; i++)
+    {
+        tile_row = MATRIX_ROW(tile, i);
+        for (j = 0; j < tile->cols; j++)
+        {
+            tile_row[j] = -tile_row[j] / 2.0;
+        }
+        vector_exp(tile_row, tile->cols);
+
+        /* No self-similarity on the diagonal */
+        if (row + i >= col && row + i < col + tile->cols)
+        {
+            tile_row[row + i - col] = 0.0;
+        }
+    }
+}
+
+/* Function to calculate the similarity matrix
+ * Only the upper triangle is computed, in SIMILARITY_TILE x SIMILARITY_TILE
+ * tiles, and each finished tile is mirrored below the diagonal.
+ * Row blocks of tiles are shared out between threads; every tile is written
+ * by one thread only.
+ */
+matrix_t *calculate_similarity_matrix(const matrix_t *data)
+{
+    matrix_t *affinity_matrix, *data_T, tile_view;
+    double *sq_norms, *tile_row;
+    int i, j, ib, jb, tile_rows, tile_cols, n = data->rows; /* Declare loop variables at the beginning of the block */
+
+    affinity_matrix = allocate_matrix(n, n);
+    data_T = calculate_Ht_matrix(data);
+    sq_norms = calculate_squared_norms(data);
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(get_thread_count()) schedule(dynamic, 1) private(i, j, jb, tile_rows, tile_cols, tile_view, tile_row)
+#endif
+    for (ib = 0; ib < n; ib += SIMILARITY_TILE)
+    {
+        tile_rows = n - ib < SIMILARITY_TILE ? n - ib : SIMILARITY_TILE;
+        for (jb = ib; jb < n; jb += SIMILARITY_TILE)
+        {
+            tile_cols = n - jb < SIMILARITY_TILE ? n - jb : SIMILARITY_TILE;
+            tile_view = matrix_view(affinity_matrix, ib, jb, tile_rows, tile_cols);
+            calculate_similarity_tile(data, data_T, sq_norms, ib, jb, &tile_view);
+
+            if (ib != jb)
+            {
+                /* Mirror the tile into the lower triangle */
+                for (i = 0; i < tile_rows; i++)
+                {
+                    tile_row = MATRIX_ROW(&tile_view, i);
+                    for (j = 0; j < tile_cols; j++)
+                    {
+                        MATRIX_AT(affinity_matrix, jb + j, ib + i) = tile_row[j];
+                    }
+                }
+            }
+        }
+    }
+
+    free(sq_norms);
+    free_matrix(data_T);
+    return affinity_matrix;
+}
+
+/* Helper function to allocate a zero-initialized vector */
+double *allocate_vector(int length)
+{
+    double *vector;
+
+    vector = (double *)calloc(length > 0 ? (size_t)length : 1, sizeof(double));
+    if (vector == NULL)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    return vector;
+}
+
+/* Function to calculate the degree vector (the diagonal of D) */
+double *calculate_degree_vector(const matrix_t *similarity_matrix)
+{
+    double *degrees, degree;
+    const double *row;
+    int i, j, n = similarity_matrix->rows; /* Declare loop variables at the beginning of the block */
+
+    degrees = allocate_vector(n);
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(get_thread_count()) schedule(static) private(row, degree, j) if (n >= PARALLEL_MIN_ROWS)
+#endif
+    for (i = 0; i < n; i++)
+    {
+        row = MATRIX_ROW(similarity_matrix, i);
+        degree = 0.0;
+        for (j = 0; j < n; j++)
+        {
+            degree += row[j];
+        }
+        degrees[i] = degree;
+    }
+    return degrees;
+}
+
+/* Function to calculate the diagonal degree matrix */
+matrix_t *calculate_ddg_matrix(const matrix_t *similarity_matrix)
+{
+    matrix_t *degree_matrix;
+    double *degrees;
+    int i, n = similarity_matrix->rows; /* Declare loop variable at the beginning of the block */
+
+    degrees = calculate_degree_vector(similarity_matrix);
+    degree_matrix = allocate_matrix(n, n);
+    for (i = 0; i < n; i++)
+    {
+        MATRIX_AT(degree_matrix, i, i) = degrees[i];
+    }
+    free(degrees);
+    return degree_matrix;
+}
+
+/* Helper function to calculate the diagonal of D^(-1/2) from the degree vector */
+double *calculate_inv_sqrt_degrees(const double *degrees, int n)
+{
+    double *inv_sqrt_degrees;
+    int i; /* Declare loop variable at the beginning of the block */
+
+    inv_sqrt_degrees = allocate_vector(n);
+    for (i = 0; i < n; i++)
+    {
+        if (degrees[i] > 0)
+        { /* Avoid division by zero */
+            inv_sqrt_degrees[i] = 1.0 / sqrt(degrees[i]);
+        }
+        else
+        {
+            /* Handle cases where degree is zero, though problem assumes valid data */
+            inv_sqrt_degrees[i] = 0.0;
+        }
+    }
+    return inv_sqrt_degrees;
+}
+
+/* Function to normalize a similarity matrix in place
+ * Applies W = D^(-1/2) * A * D^(-1/2) as the diagonal scaling
+ * W_ij = A_ij / sqrt(d_i * d_j) in a single O(n^2) pass.
+ */
+void normalize_similarity_matrix(matrix_t *similarity_matrix, const double *degrees)
+{
+    double *inv_sqrt_degrees, *row, scale;
+    int i, j, n = similarity_matrix->rows; /* Declare loop variables at the beginning of the block */
+
+    inv_sqrt_degrees = calculate_inv_sqrt_degrees(degrees, n);
+
+    /* Scale row i by d_i^(-1/2) and column j by d_j^(-1/2) */
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(get_thread_count()) schedule(static) private(row, scale, j) if (n >= PARALLEL_MIN_ROWS)
+#endif
+    for (i = 0; i < n; i++)
+    {
+        row = MATRIX_ROW(similarity_matrix, i);
+        scale = inv_sqrt_degrees[i];
+        for (j = 0; j < n; j++)
+        {
+            row[j] = scale * row[j] * inv_sqrt_degrees[j];
+        }
+    }
+
+    free(inv_sqrt_degrees);
+}
+
+/* Function to calculate the normalized similarity matrix */
+matrix_t *calculate_normalized_similarity_matrix(const matrix_t *similarity_matrix, const double *degrees)
+{
+    matrix_t *normalized_matrix;
+
+    normalized_matrix = copy_matrix(similarity_matrix);
+    normalize_similarity_matrix(normalized_matrix, degrees);
+    return normalized_matrix;
+}
+
+/* Helper function to calculate the transpose of a matrix */
+matrix_t *calculate_Ht_matrix(const matrix_t *matrix) {
+    matrix_t *transposed_matrix;
+    const double *row;
+    int i, j; /* Declare loop variables at the beginning of the block */
+
+    transposed_matrix = allocate_matrix(matrix->cols, matrix->rows);
+
+    for (i = 0; i < matrix->rows; i++) {
+        row = MATRIX_ROW(matrix, i);
+        for (j = 0; j < matrix->cols; j++) {
+            MATRIX_AT(transposed_matrix, j, i) = row[j];
+        }
+    }
+    return transposed_matrix;
+}
+
+/* Helper function to calculate the k x k Gram matrix H^T * H */
+matrix_t *calculate_gram_matrix(const matrix_t *H)
+{
+    matrix_t *G;
+
+    G = allocate_matrix(H->cols, H->cols);
+    calculate_gram_matrix_into(H, G); /* Backend specific, see gemm.c */
+    return G;
+}
+
+/* Helper function to calculate W * H for a dense symmetric W (a w_product_fn) */
+static void dense_w_product(const void *W, const matrix_t *H, matrix_t *WH)
+{
+    multiply_symmetric_into((const matrix_t *)W, H, WH);
+}
+
+/* Helper function to allocate the workspace of optimize_h */
+h_workspace_t *allocate_h_workspace(int n, int k)
+{
+    h_workspace_t *workspace;
+
+    workspace = (h_workspace_t *)malloc(sizeof(h_workspace_t));
+    if (workspace == NULL)
+    {
+        printf("An Error Has Occurred\n");
+        exit(1);
+    }
+    workspace->H[0] = allocate_matrix(n, k);
+    workspace->H[1] = allocate_matrix(n, k);
+    workspace->gram = allocate_matrix(k, k);
+    workspace->HHT_H = allocate_matrix(n, k);
+    workspace->WH = allocate_matrix(n, k);
+    workspace->evaluated = NULL;
+    workspace->previous = NULL;
+    workspace->extrapolated = NULL;
+    workspace->momentum = 1.0;
+    workspace->last_value = 0.0;
+    return workspace;
+}
+
+/* Helper function to free the workspace of optimize_h */
+void free_h_workspace(h_workspace_t *workspace)
+{
+    if (workspace == NULL)
+        return;
+    free_matrix(workspace->H[0]);
+    free_matrix(workspace->H[1]);
+    free_matrix(workspace->gram);
+    free_matrix(workspace->HHT_H);
+    free_matrix(workspace->WH);
+    free_matrix(workspace->previous);
+    free_matrix(workspace->extrapolated);
+    free(workspace);
+}
+
+/* Helper function to perform one iteration of the H update rule into an existing matrix
+ * The denominator (H * H^T) * H is evaluated as H * (H^T * H), which needs
+ * only a k x k Gram matrix and O(nk^2) work instead of an n x n product.
+ * With OpenMP the distance is summed per thread over fixed row ranges and
+ * the partial sums are added in thread order.
+ */
+double update_h_iteration_into(const matrix_t *H, const void *W, w_product_fn product,
+                               h_workspace_t *workspace, matrix_t *H_new, double beta) {
+    const double *h_row, *wh_row, *den_row;
+    double *new_row, *partials, partial, diff, sum = 0.0;
+    int i, j, t, threads, n = H->rows, k = H->cols; /* Declare loop variables at the beginning of the block */
+
+    /* Calculate H^T * H */
+    calculate_gram_matrix_into(H, workspace->gram);
+
+    /* Calculate H * (H^T * H), equal to (H * H^T) * H */
+    multiply_matrices_into(H, workspace->gram, workspace->HHT_H);
+
+    /* Calculate W * H with the kernel for W's storage format */
+    product(W, H, workspace->WH);
+    workspace->evaluated = H;
+
+    /* Update H, summing the squared change on the way */
+    threads = get_thread_count();
+    partials = allocate_vector(threads);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads) if (n >= PARALLEL_MIN_ROWS) private(h_row, wh_row, den_row, new_row, partial, diff, i, j)
+#endif
+    {
+        partial = 0.0;
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (i = 0; i < n; i++) {
+            h_row = MATRIX_ROW(H, i);
+            wh_row = MATRIX_ROW(workspace->WH, i);
+            den_row = MATRIX_ROW(workspace->HHT_H, i);
+            new_row = MATRIX_ROW(H_new, i);
+            for (j = 0; j < k; j++) {
+                if (den_row[j] != 0)
+                    new_row[j] = h_row[j] * (1 - beta + beta * (wh_row[j] / (den_row[j])));
+                else
+                    new_row[j] = h_row[j] * (1 - beta + beta * (wh_row[j] / (den_row[j]+1e-6)));
+                diff = new_row[j] - h_row[j];
+                partial += diff * diff;
+            }
+        }
+        partials[get_thread_index()] = partial;
+    }
+    for (t = 0; t < threads; t++) {
+        sum += partials[t];
+    }
+    free(partials);
+
+    return sum;
+}
+
+/* Helper function to perform one iteration of the H update rule for any storage of W */
+matrix_t *update_h_iteration_with(const matrix_t *H, const void *W, w_product_fn product) {
+    h_workspace_t *workspace;
+    matrix_t *H_new;
+
+    workspace = allocate_h_workspace(H->rows, H->cols);
+    H_new = workspace->H[0];
+    workspace->H[0] = NULL; /* The result outlives the workspace */
+    update_h_iteration_into(H, W, product, workspace, H_new, BETA);
+    free_h_workspace(workspace);
+    return H_new;
+}
+
+/* Helper function to perform one iteration of the H update rule */
+matrix_t *update_h_iteration(const matrix_t *H, const matrix_t *W) {
+    return update_h_iteration_with(H, W, dense_w_product);
+}
+
+/* Helper function to reset statistics before a run */
+void clear_stats(symnmf_stats_t *stats)
+{
+    memset(stats, 0, sizeof(symnmf_stats_t));
+    stats->deltas = NULL;
+    stats->objectives = NULL;
+}
+
+/* Helper function to release the convergence history of statistics */
+void free_stats(symnmf_stats_t *stats)
+{
+    if (stats == NULL)
+        return;
+    free(stats->deltas);
+    free(stats->objectives);
+    stats->deltas = NULL;
+    stats->objectives = NULL;
+}
+
+/* Helper function to calculate the squared Frobenius norm of a matrix */
+double matrix_squared_norm(const matrix_t *matrix)
+{
+    const double *row;
+    double sum = 0.0;
+    int i, j; /* Declare loop variables at the beginning of the block */
+
+    for (i = 0; i < matrix->rows; i++)
+    {
+        row = MATRIX_ROW(matrix, i);
+        for (j = 0; j < matrix->cols; j++)
+        {
+            sum += row[j] * row[j];
+        }
+    }
+    return sum;
+}
+
+/* Helper function to calculate ||W - H H^T||_F at the point an update evaluated
+ * Expands to ||W||^2 - 2 tr(H^T W H) + ||H^T H||^2, using the W * H and
+ * H^T * H products the update left in the workspace.
+ */
+static double h_objective(const h_workspace_t *workspace, double w_squared_norm)
+{
+    const matrix_t *H = workspace->evaluated;
+    const double *h_row, *wh_row;
+    double trace = 0.0, value;
+    int i, j; /* Declare loop variables at the beginning of the block */
+
+    for (i = 0; i < H->rows; i++)
+    {
+        h_row = MATRIX_ROW(H, i);
+        wh_row = MATRIX_ROW(workspace->WH, i);
+        for (j = 0; j < H->cols; j++)
+        {
+            trace += h_row[j] * wh_row[j];
+        }
+    }
+    value = w_squared_norm - 2.0 * trace + matrix_squared_norm(workspace->gram);
+    return value > 0.0 ? sqrt(value) : 0.0; /* Rounding can take a near-exact fit below 0 */
+}
+
+/* Helper function to set solver options to the defaults */
+void default_solver_options(solver_options_t *options)
+{
+    options->epsilon = EPSILON;
+    options->relative_tolerance = 0.0;
+    options->time_budget = 0.0;
+    options->max_iter = MAX_ITER;
+    options->beta = BETA;
+    options->method = SOLVER_MULTIPLICATIVE;
+}
+
+/* Helper function to check solver options */
+int valid_solver_options(const solver_options_t *options)
+{
+    return options->epsilon >= 0.0 && options->relative_tolerance >= 0.0 && options->time_budget >= 0.0 &&
+           options->max_iter >= 0 && options->beta > 0.0 && options->beta <= 1.0 &&
+           options->method >= 0 && options->method < SOLVER_COUNT;
+}
+
+/* Helper function to test the convergence conditions of solver options after an update */
+int h_converged(const solver_options_t *options, double frobenius_diff, const matrix_t *H_new)
+{
+    double relative_limit = options->relative_tolerance * options->relative_tolerance;
+
+    return frobenius_diff < options->epsilon ||
+           (relative_limit > 0.0 && frobenius_diff < relative_limit * matrix_squared_norm(H_new));
+}
+
+/* Function to optimize H using the iterative update rule for any storage of W */
+matrix_t *optimize_h_with(const matrix_t *H, const void *W, w_product_fn product)
+{
+    return optimize_h_with_options(H, W, product, NULL, NULL);
+}
+
+/* Function to optimize H for any storage of W with the given options, recording statistics
+ * All buffers come from one workspace allocated up front; the current and
+ * the next H alternate between its two H buffers instead of being copied,
+ * and the convergence distance comes out of the update itself. The clock
+ * is only read when there is a time budget or statistics are recorded.
+ */
+matrix_t *optimize_h_with_options(const matrix_t *H, const void *W, w_product_fn product,
+                                  const solver_options_t *options, symnmf_stats_t *stats)
+{
+    solver_options_t defaults;
+    h_workspace_t *workspace;
+    matrix_t *H_final;
+    double frobenius_diff, start = 0.0;
+    int iter, i, current = 0; /* Declare loop variables at the beginning of the block */
+
+    if (options == NULL)
+    {
+        default_solver_options(&defaults);
+        options = &defaults;
+    }
+    if (stats != NULL || options->time_budget > 0.0)
+        start = wall_seconds();
+    if (stats != NULL)
+    {
+        free_stats(stats);
+        stats->deltas = allocate_vector(options->max_iter > 0 ? options->max_iter : 1);
+        stats->objectives = allocate_vector(options->max_iter > 0 ? options->max_iter : 1);
+        stats->iterations = 0;
+        stats->converged = 0;
+    }
+    workspace = allocate_h_workspace(H->rows, H->cols);
+
+    /* Copy initial H to the current buffer */
+    for (i = 0; i < H->rows; i++)
+    {
+        memcpy(MATRIX_ROW(workspace->H[0], i), MATRIX_ROW(H, i), (size_t)H->cols * sizeof(double));
+    }
+
+    for (iter = 0; iter < options->max_iter; iter++)
+    {
+        /* Perform one update iteration of the chosen engine into the other buffer and swap */
+        if (options->method == SOLVER_NESTEROV)
+            frobenius_diff = nesterov_iteration_into(workspace->H[current], W, product, workspace,
+                                                     workspace->H[1 - current], options->beta);
+        else if (options->method == SOLVER_BCD)
+            frobenius_diff = bcd_iteration_into(workspace->H[current], W, product, workspace, workspace->H[1 - current]);
+        else
+            frobenius_diff = update_h_iteration_into(workspace->H[current], W, product, workspace,
+                                                     workspace->H[1 - current], options->beta);
+        if (stats != NULL)
+        {
+            stats->deltas[iter] = frobenius_diff;
+            stats->objectives[iter] = h_objective(workspace, stats->w_squared_norm);
+            stats->iterations = iter + 1;
+        }
+        current = 1 - current;
+
+        /* Check the convergence conditions, then the time budget */
+        if (h_converged(options, frobenius_diff, workspace->H[current]))
+        {
+            if (stats != NULL)
+                stats->converged = 1;
+            break; /* Converged */
+        }
+        if (options->time_budget > 0.0 && wall_seconds() - start >= options->time_budget)
+        {
+            break; /* Out of time: the latest H is returned */
+        }
+    }
+
+    /* Hand the final H over to the caller and free the rest */
+    H_final = workspace->H[current];
+    workspace->H[current] = NULL;
+    free_h_workspace(workspace);
+    if (stats != NULL)
+        stats->optimize_seconds = wall_seconds() - start;
+    return H_final;
+}
+
+/* Function to optimize H using the iterative update rule */
+matrix_t *optimize_h(const matrix_t *H, const matrix_t *W)
+{
+    return optimize_h_with(H, W, dense_w_product);
+}
+
+/* Function to optimize H using the iterative update rule with the given options */
+matrix_t *optimize_h_options(const matrix_t *H, const matrix_t *W, const solver_options_t *options,
+                             symnmf_stats_t *stats)
+{
+    if (stats != NULL)
+        stats->w_squared_norm = matrix_squared_norm(W);
+    return optimize_h_with_options(H, W, dense_w_product, options, stats);
+}
+
+/* Function to optimize a batch of H matrices against a dense W */
+void optimize_h_batch_dense(const matrix_t *const *initial_H, int count, const matrix_t *W,
+                            const solver_options_t *options, matrix_t **final_H, double *objectives,
+                            int *iterations)
+{
+    optimize_h_batch(initial_H, count, W, dense_w_product, matrix_squared_norm(W), options, final_H, objectives,
+                     iterations);
+}
+
+/* Mersenne Twister parameters */
+#define RNG_SHIFT 397
+#define RNG_MATRIX_A 0x9908b0dfUL
+#define RNG_UPPER_MASK 0x80000000UL
+#define RNG_LOWER_MASK 0x7fffffffUL
+
+/* Helper function to seed a random number generator (as numpy.random.seed(seed)) */
+void rng_seed(rng_t *rng, unsigned long seed)
+{
+    int pos; /* Declare loop variable at the beginning of the block */
+
+    seed &= 0xffffffffUL;
+    for (pos = 0; pos < RNG_STATE_LENGTH; pos++)
+    {
+        rng->key[pos] = seed;
+        seed = (1812433253UL * (seed ^ (seed >> 30)) + (unsigned long)pos + 1) & 0xffffffffUL;
+    }
+    rng->pos = RNG_STATE_LENGTH;
+}
+
+/* Helper function to draw the next tempered 32-bit word, regenerating the state when used up */
+static unsigned long rng_next32(rng_t *rng)
+{
+    unsigned long y;
+    int i; /* Declare loop variable at the beginning of the block */
+
+    if (rng->pos == RNG_STATE_LENGTH)
+    {
+        for (i = 0; i < RNG_STATE_LENGTH; i++)
+        {
+            y = (rng->key[i] & RNG_UPPER_MASK) | (rng->key[(i + 1) % RNG_STATE_LENGTH] & RNG_LOWER_MASK);
+            rng->key[i] = rng->key[(i + RNG_SHIFT) % RNG_STATE_LENGTH] ^ (y >> 1) ^ ((y & 1UL) ? RNG_MATRIX_A : 0UL);
+        }
+        rng->pos = 0;
+    }
+
+    y = rng->key[rng->pos++];
+    y ^= y >> 11;
+    y ^= (y << 7) & 0x9d2c5680UL;
+    y ^= (y << 15) & 0xefc60000UL;
+    y ^= y >> 18;
+    return y & 0xffffffffUL;
+}
+
+/* Helper function to draw a uniform value in [0, 1) with 53 random bits */
+double rng_uniform(rng_t *rng)
+{
+    unsigned long a, b;
+
+    a = rng_next32(rng) >> 5;
+    b = rng_next32(rng) >> 6;
+    return ((double)a * 67108864.0 + (double)b) / 9007199254740992.0;
+}
+
+/* Function to initialize H for optimize_h */
+matrix_t *initialize_h(int n, int k, double mean, rng_t *rng)
+{
+    matrix_t *H;
+    double upper_bound;
+    int i, j; /* Declare loop variables at the beginning of the block */
+
+    H = allocate_matrix(n, k);
+    upper_bound = 2.0 * sqrt(mean / k);
+    for (i = 0; i < n; i++)
+    {
+        for (j = 0; j < k; j++)
+        {
+            MATRIX_AT(H, i, j) = upper_bound * rng_uniform(rng);
+        }
+    }
+    return H;
+}
+
+/* Helper function to process the goal and print the result matrix
+ * The similarity and normalized matrices are kept in packed symmetric storage.
+ * binary: Nonzero to write the result in the binary matrix format instead of text
+ * stats: Statistics receiving the time of each stage, or NULL
+ * Returns: 0 on success, 1 for an invalid goal or a failed write
+ */
+int process_goal_and_print_result(const char *goal, const matrix_t *data, int binary, symnmf_stats_t *stats)
+{
+    packed_matrix_t *similarity_matrix;
+    double *degrees, time = 0.0;
+    int status;
+
+    if (strcmp(goal, "sym") != 0 && strcmp(goal, "ddg") != 0 && strcmp(goal, "norm") != 0)
+    {
+        /* Invalid goal - this case should ideally be caught before calling this function */
+        return 1;
+    }
+
+    if (stats != NULL)
+        time = wall_seconds();
+    similarity_matrix = calculate_packed_similarity_matrix(data);
+    if (stats != NULL)
+        stats->similarity_seconds = wall_seconds() - time;
+
+    if (strcmp(goal, "sym") == 0)
+    {
+        status = write_packed_matrix(stdout, similarity_matrix, binary);
+    }
+    else
+    {
+        if (stats != NULL)
+            time = wall_seconds();
+        degrees = calculate_packed_degree_vector(similarity_matrix);
+        if (stats != NULL)
+            stats->degree_seconds = wall_seconds() - time;
+        if (strcmp(goal, "norm") == 0)
+        {
+            /* Normalize in place: the similarity buffer becomes the result */
+            if (stats != NULL)
+                time = wall_seconds();
+            normalize_packed_similarity_matrix(similarity_matrix, degrees);
+            if (stats != NULL)
+                stats->normalize_seconds = wall_seconds() - time;
+            status = write_packed_matrix(stdout, similarity_matrix, binary);
+        }
+        else
+        {
+            status = write_diagonal_matrix(stdout, degrees, data->rows, binary);
+        }
+        free(degrees);
+    }
+
+    free_packed_matrix(similarity_matrix);
+    return status;
+}
+
+/* Helper function to process the goal and print the result matrix in float32 mode
+ * Same as process_goal_and_print_result with the matrices stored in float;
+ * the degrees are still summed in double.
+ */
+int process_goal_and_print_result_f32(const char *goal, const matrix_t *data, int binary, symnmf_stats_t *stats)
+{
+    packed_matrix_f32_t *similarity_matrix;
+    double *degrees, time = 0.0;
+    int status;
+
+    if (strcmp(goal, "sym") != 0 && strcmp(goal, "ddg") != 0 && strcmp(goal, "norm") != 0)
+    {
+        return 1;
+    }
+
+    if (stats != NULL)
+        time = wall_seconds();
+    similarity_matrix = calculate_packed_similarity_matrix_f32(data);
+    if (stats != NULL)
+        stats->similarity_seconds = wall_seconds() - time;
+
+    if (strcmp(goal, "sym") == 0)
+    {
+        status = write_packed_matrix_f32(stdout, similarity_matrix, binary);
+    }
+    else
+    {
+        if (stats != NULL)
+            time = wall_seconds();
+        degrees = calculate_packed_degree_vector_f32(similarity_matrix);
+        if (stats != NULL)
+            stats->degree_seconds = wall_seconds() - time;
+        if (strcmp(goal, "norm") == 0)
+        {
+            if (stats != NULL)
+                time = wall_seconds();
+            normalize_packed_similarity_matrix_f32(similarity_matrix, degrees);
+            if (stats != NULL)
+                stats->normalize_seconds = wall_seconds() - time;
+            status = write_packed_matrix_f32(stdout, similarity_matrix, binary);
+        }
+        else
+        {
+            status = write_diagonal_matrix(stdout, degrees, data->rows, binary);
+        }
+        free(degrees);
+    }
+
+    free_packed_matrix_f32(similarity_matrix);
+    return status;
+}
+
+/* Helper function to process the goal and print the result matrix out of core
+ * The similarity matrix is written to a memory-mapped file in panels and
+ * normalized there, so it never has to fit in memory.
+ * binary: Nonzero to write the result in the binary matrix format instead of text
+ * w_file: Path of the file holding the similarity matrix (created or truncated, and kept)
+ * panel_rows: Rows of the matrix processed at a time, or 0 for the default
+ * stats: Statistics receiving the time of each stage (the degrees are summed with the similarity matrix), or NULL
+ * Returns: 0 on success, 1 for an invalid goal, a file that cannot be created or a failed write
+ */
+int process_goal_out_of_core(const char *goal, const matrix_t *data, int binary, const char *w_file, int panel_rows,
+                             symnmf_stats_t *stats)
+{
+    mapped_matrix_t *similarity_matrix;
+    matrix_t similarity_view;
+    double *degrees, time = 0.0;
+    int status;
+
+    if (strcmp(goal, "sym") != 0 && strcmp(goal, "ddg") != 0 && strcmp(goal, "norm") != 0)
+    {
+        return 1;
+    }
+
+    if (stats != NULL)
+        time = wall_seconds();
+    degrees = allocate_vector(data->rows);
+    similarity_matrix = calculate_mapped_similarity_matrix(data, w_file, panel_rows, degrees);
+    if (similarity_matrix == NULL)
+    {
+        free(degrees);
+        return 1;
+    }
+    if (stats != NULL)
+        stats->similarity_seconds = wall_seconds() - time;
+
+    if (strcmp(goal, "ddg") == 0)
+    {
+        status = write_diagonal_matrix(stdout, degrees, data->rows, binary);
+    }
+    else
+    {
+        if (strcmp(goal, "norm") == 0)
+        {
+            if (stats != NULL)
+                time = wall_seconds();
+            normalize_mapped_similarity_matrix(similarity_matrix, degrees);
+            if (stats != NULL)
+                stats->normalize_seconds = wall_seconds() - time;
+        }
+        similarity_view = mapped_rows_view(similarity_matrix, 0, data->rows);
+        status = write_matrix(stdout, &similarity_view, binary);
+    }
+
+    free(degrees);
+    free_mapped_matrix(similarity_matrix);
+    return status;
+}
+
+#ifndef SYMNMF_NO_MAIN
+/* Helper function to parse a whole number of at least 1 from a command line argument
+ * Returns: 1 on success (the number is stored in value), 0 otherwise
+ */
+static int parse_positive_int(const char *text, int *value)
+{
+    char *end;
+    long parsed;
+
+    parsed = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || parsed < 1 || parsed > 1000000L)
+        return 0;
+    *value = (int)parsed;
+    return 1;
+}
+
+/* Main function for standalone execution
+ * Usage: symnmf [--threads N] [--binary] [--precision float32|float64] [--stats]
+ *               [--out-of-core W_FILE [--panel-rows N]] goal file_name
+ * --binary writes the result in the binary matrix format (see io.c) instead of text;
+ * binary input files are recognized by their contents.
+ * --out-of-core keeps the similarity matrix in the memory-mapped file W_FILE
+ * (see mapped.c), processed N rows at a time.
+ * --precision float32 stores the matrices in single precision (half the memory);
+ * the out-of-core mode is always float64.
+ * --stats writes the time of each stage to stderr once the result is written.
+ */
+int main(int argc, char *argv[])
+{
+    char *goal, *file_name, *w_file = NULL;
+    matrix_t *data;
+    symnmf_stats_t stats, *stats_target = NULL;
+    int n, d, status, threads, binary = 0, single = 0, panel_rows = 0, arg = 1;
+
+    /* Leading options */
+    while (arg < argc && strncmp(argv[arg], "--", 2) == 0)
+    {
+        if (strcmp(argv[arg], "--threads") == 0 && arg + 1 < argc && parse_positive_int(argv[arg + 1], &threads))
+        {
+            set_thread_count(threads);
+            arg += 2;
+        }
+        else if (strcmp(argv[arg], "--binary") == 0)
+        {
+            binary = 1;
+            arg++;
+        }
+        else if (strcmp(argv[arg], "--stats") == 0)
+        {
+            clear_stats(&stats);
+            stats_target = &stats;
+            arg++;
+        }
+        else if (strcmp(argv[arg], "--precision") == 0 && arg + 1 < argc &&
+                 (strcmp(argv[arg + 1], "float32") == 0 || strcmp(argv[arg + 1], "float64") == 0))
+        {
+            single = strcmp(argv[arg + 1], "float32") == 0;
+            arg += 2;
+        }
+        else if (strcmp(argv[arg], "--out-of-core") == 0 && arg + 1 < argc)
+        {
+            w_file = argv[arg + 1];
+            arg += 2;
+        }
+        else if (strcmp(argv[arg], "--panel-rows") == 0 && arg + 1 < argc && parse_positive_int(argv[arg + 1], &panel_rows))
+        {
+            arg += 2;
+        }
+        else
+        {
+            printf("An Error Has Occurred\n");
+            return 1;
+        }
+    }
+
+    /* Check for correct number of arguments */
+    if (argc - arg != 2)
+    {
+        printf("An Error Has Occurred\n");
+        return 1;
+    }
+
+    goal = argv[arg];
+    file_name = argv[arg + 1];
+
+    /* Validate goal before reading data */
+    if (strcmp(goal, "sym") != 0 && strcmp(goal, "ddg") != 0 && strcmp(goal, "norm") != 0)
+    {
+        printf("An Error Has Occurred\n");
+        return 1;
+    }
+
+    data = read_data_from_file(file_name, &n, &d);
+
+    if (data == NULL || n == 0 || d == 0)
+    {
+        /* read_data_from_file handles errors and exits, but check for empty data */
+        if (data != NULL)
+            free_matrix(data);
+        printf("An Error Has Occurred\n");
+        return 1;
+    }
+
+    if (w_file != NULL)
+        status = process_goal_out_of_core(goal, data, binary, w_file, panel_rows, stats_target);
+    else if (single)
+        status = process_goal_and_print_result_f32(goal, data, binary, stats_target);
+    else
+        status = process_goal_and_print_result(goal, data, binary, stats_target);
+    if (status == 0 && stats_target != NULL)
+        status = write_stats(stderr, stats_target);
+
+    /* Free the input data matrix as it's no longer needed */
+    free_matrix(data);
+
+    if (status != 0)
+    {
+        /* Error occurred during processing */
+        printf("An Error Has Occurred\n");
+        return 1;
+    }
+
+    return 0;
+}
+#endif /* SYMNMF_NO_MAIN */
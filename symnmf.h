@@ -1,105 +1,1030 @@
-#ifndef SYMNMF_H
-#define SYMNMF_H
-
-/*
- * Header file for the C implementation of symNMF functions.
- * Declares function prototypes used in symnmfmodule.c and implemented in symnmf.c.
- */
-
-/* Define constants for convergence (moved from symnmf.c for potential shared use) */
-#define EPSILON 1e-4
-#define MAX_ITER 300
-#define BETA 0.5
-
-/* Define a small epsilon for numerical stability in division */
-#define EPSILON_DIV 1e-10
-
-/* Function to calculate the similarity matrix
- * data: 2D array of data points (n x d)
- * n: number of data points
- * d: dimension of data points
- * Returns: 2D array representing the similarity matrix (n x n)
- */
-double** calculate_similarity_matrix(double** data, int n, int d);
-
-/* Function to calculate the diagonal degree matrix
- * similarity_matrix: 2D array of the similarity matrix (n x n)
- * n: number of data points
- * Returns: 2D array representing the diagonal degree matrix (n x n)
- */
-double** calculate_ddg_matrix(double** similarity_matrix, int n);
-
-/* Function to calculate the normalized similarity matrix
- * similarity_matrix: 2D array of the similarity matrix (n x n)
- * ddg_matrix: 2D array of the diagonal degree matrix (n x n)
- * n: number of data points
- * Returns: 2D array representing the normalized similarity matrix (n x n)
- */
-double** calculate_normalized_similarity_matrix(double** similarity_matrix, double** ddg_matrix, int n);
-
-/* Function to optimize H using the iterative update rule
- * H: Initial H matrix (n x k)
- * W: Normalized similarity matrix (n x n)
- * n: number of data points
- * k: number of clusters
- * Returns: Optimized H matrix (n x k)
- */
-double** optimize_h(double** H, double** W, int n, int k);
-
-/* Helper function to free allocated memory for a 2D array
- * matrix: The 2D array to free
- * rows: The number of rows in the matrix
- */
-void free_matrix(double** matrix, int rows);
-
-/* Helper function to allocate memory for a 2D array
- * rows: The number of rows
- * cols: The number of columns
- * Returns: Allocated 2D array
- */
-double** allocate_matrix(int rows, int cols);
-
-/* Helper function to calculate the squared Euclidean distance between two vectors
- * vec1: The first vector
- * vec2: The second vector
- * d: The dimension of the vectors
- * Returns: The squared Euclidean distance
- */
-double squared_euclidean_distance(double* vec1, double* vec2, int d);
-
-/* Helper function to calculate the Frobenius norm squared of the difference between two matrices
- * matrix1: The first matrix
- * matrix2: The second matrix
- * rows: The number of rows
- * cols: The number of columns
- * Returns: The squared Frobenius norm of the difference
- */
-double frobenius_norm_squared_difference(double** matrix1, double** matrix2, int rows, int cols);
-
-/* Helper function to calculate matrix product C = A * B
- * A: First matrix (rows_A x cols_A)
- * B: Second matrix (rows_B x cols_B)
- * rows_A, cols_A, rows_B, cols_B: Dimensions of matrices A and B
- * Returns: Result matrix C (rows_A x cols_B)
- */
-double** multiply_matrices(double** A, double** B, int rows_A, int cols_A, int rows_B, int cols_B);
-
-/* Helper function to perform one iteration of the H update rule
- * H: Current H matrix (n x k)
- * W: Normalized similarity matrix (n x n)
- * n: number of data points
- * k: number of clusters
- * Returns: Updated H matrix (n x k)
- */
-double** update_h_iteration(double** H, double** W, int n, int k);
-
-/* Helper function to calculate the transpose of a matrix
- * matrix: The input matrix (rows x cols)
- * rows: The number of rows in the input matrix
- * cols: The number of columns in the input matrix
- * Returns: The transposed matrix (cols x rows)
- */
-double** calculate_Ht_matrix(double** matrix, int rows, int cols);
-
-
-#endif /* SYMNMF_H */
+#ifndef SYMNMF_H
+#define SYMNMF_H
+
+#include <stddef.h> /* Required for size_t */
+#include <stdio.h>  /* Required for FILE */
+
+/*
+ * Header file for the C implementation of symNMF functions.
+ * Declares function prototypes used in symnmfmodule.c and implemented in symnmf.c
+ * (matrix product backends are implemented in gemm.c).
+ */
+
+/* Default solver parameters (see solver_options_t) */
+#define EPSILON 1e-4
+#define MAX_ITER 300
+#define BETA 0.5
+
+/* Default k-means parameters (as in kmeans.py) */
+#define KMEANS_EPSILON 0.001
+#define KMEANS_MAX_ITER 200
+
+/* H update engines (solver_options_t.method, see solvers.c) */
+#define SOLVER_MULTIPLICATIVE 0 /* The damped multiplicative update */
+#define SOLVER_NESTEROV 1       /* The same update from an extrapolated point */
+#define SOLVER_BCD 2            /* Proximal block coordinate descent (ANLS) on the k x k Gram matrix */
+#define SOLVER_COUNT 3
+
+/* Define a small epsilon for numerical stability in division */
+#define EPSILON_DIV 1e-10
+
+/* Alignment in bytes of matrix storage (one cache line) */
+#define MATRIX_ALIGNMENT 64
+
+/* Default size in bytes of the panels of W streamed in out-of-core mode */
+#define MAPPED_PANEL_BYTES ((size_t)64 << 20)
+
+/* Binary matrix files (see io.c): leading bytes, header size and element type codes */
+#define BINARY_MAGIC "SYMNMFB1"
+#define BINARY_MAGIC_LENGTH 8
+#define BINARY_HEADER_SIZE 32
+#define BINARY_DTYPE_FLOAT64 1
+
+/* Dense row-major matrix stored in a single aligned block.
+ * Rows are `stride` elements apart; the stride is padded to a whole number
+ * of cache lines for wide matrices so every row starts on a cache line.
+ */
+typedef struct
+{
+    double *data; /* First element of row 0, aligned to MATRIX_ALIGNMENT */
+    void *block;  /* Start of the underlying allocation (what gets freed) */
+    int rows;     /* Number of rows */
+    int cols;     /* Number of columns */
+    int stride;   /* Number of elements between the starts of consecutive rows */
+} matrix_t;
+
+/* Pointer to the first element of row i of matrix m */
+#define MATRIX_ROW(m, i) ((m)->data + (size_t)(i) * (size_t)(m)->stride)
+
+/* Element (i, j) of matrix m */
+#define MATRIX_AT(m, i, j) (MATRIX_ROW(m, i)[j])
+
+/* Side of the square tiles in which the similarity matrix is built */
+#define SIMILARITY_TILE 256
+
+/* Fewest rows for which a loop is split across threads in the OpenMP build */
+#define PARALLEL_MIN_ROWS 64
+
+/* Symmetric n x n matrix in packed upper-triangular storage.
+ * Row i holds the elements (i, i) .. (i, n - 1), and the rows follow each
+ * other without gaps, so the matrix takes n (n + 1) / 2 elements.
+ */
+typedef struct
+{
+    double *data; /* Packed upper triangle, row by row */
+    int n;        /* Number of rows (and columns) */
+} packed_matrix_t;
+
+/* Packed symmetric matrix with float elements (float32 mode), laid out like packed_matrix_t */
+typedef struct
+{
+    float *data; /* Packed upper triangle, row by row */
+    int n;       /* Number of rows (and columns) */
+} packed_matrix_f32_t;
+
+/* Pointer to element (i, i) of packed matrix m; row i continues with (i, i + 1) .. (i, n - 1) */
+#define PACKED_ROW(m, i) ((m)->data + (size_t)(i) * (2 * (size_t)(m)->n - (size_t)(i) + 1) / 2)
+
+/* Element (i, j) of packed matrix m, valid for j >= i */
+#define PACKED_AT(m, i, j) (PACKED_ROW(m, i)[(j) - (i)])
+
+/* Sparse symmetric n x n matrix in compressed sparse row (CSR) form.
+ * The stored elements of row i are values[row_ptr[i]] .. values[row_ptr[i + 1] - 1],
+ * in increasing column order; both (i, j) and (j, i) are stored.
+ */
+typedef struct
+{
+    size_t *row_ptr; /* Start of every row in col_idx/values (n + 1 entries) */
+    int *col_idx;    /* Column of every stored element */
+    double *values;  /* Value of every stored element */
+    size_t nnz;      /* Number of stored elements */
+    int n;           /* Number of rows (and columns) */
+} csr_matrix_t;
+
+/* Number of 32-bit words in the state of the Mersenne Twister generator */
+#define RNG_STATE_LENGTH 624
+
+/* Default seed of the H initialization (the seed symnmf.py gives NumPy) */
+#define DEFAULT_SEED 1234
+
+/* MT19937 random number generator.
+ * Seeded and sampled the way numpy.random.seed / numpy.random.uniform are,
+ * so a seed gives the same values as NumPy's legacy global generator.
+ */
+typedef struct
+{
+    unsigned long key[RNG_STATE_LENGTH]; /* State words (32 significant bits each) */
+    int pos;                             /* Next word of key to temper and return */
+} rng_t;
+
+/* Dense row-major n x n matrix in a memory-mapped file (out-of-core mode),
+ * processed in panels of panel_rows rows
+ */
+typedef struct
+{
+    double *data; /* The mapping: row i starts at data + i * n */
+    size_t bytes; /* Size of the mapping */
+    int n;
+    int panel_rows;
+    int fd; /* Descriptor of the mapped file */
+} mapped_matrix_t;
+
+/* Similarity matrix A of a growing set of data points (incremental mode).
+ * The lower triangle is stored by rows, row i holding A_i0 .. A_ii, so the
+ * rows of appended points are appended without moving the previous ones.
+ * W = D^(-1/2) A D^(-1/2) is never formed; products with W scale H instead.
+ */
+typedef struct
+{
+    double *data;     /* Row i starts at data + i (i + 1) / 2 */
+    size_t capacity;  /* Elements allocated in data */
+    double *degrees;  /* Row sums of A (n) */
+    matrix_t *points; /* The data points (n x d), needed for the affinities of new points */
+    int n;
+} affinity_matrix_t;
+
+/* Pointer to element (i, 0) of affinity matrix m; row i continues with (i, 1) .. (i, i) */
+#define AFFINITY_ROW(m, i) ((m)->data + (size_t)(i) * ((size_t)(i) + 1) / 2)
+
+/* Buffers reused by every iteration of optimize_h, allocated once per run */
+typedef struct
+{
+    matrix_t *H[2];  /* Double buffer holding the current and the next H (n x k) */
+    matrix_t *gram;  /* H^T * H (k x k) */
+    matrix_t *HHT_H; /* H * (H^T * H) (n x k) */
+    matrix_t *WH;    /* W * H (n x k) */
+    const matrix_t *evaluated; /* The matrix whose products the last iteration left in gram and WH */
+    matrix_t *previous;        /* Previous H (nesterov engine only, else NULL) */
+    matrix_t *extrapolated;    /* Extrapolated point (nesterov engine only, else NULL) */
+    double momentum;           /* Nesterov t_k */
+    double last_value;         /* Objective (less ||W||^2) at the last extrapolated point */
+} h_workspace_t;
+
+/* Parameters of the H update loop, chosen at run time
+ * Start from default_solver_options; the loop stops at the first limit reached.
+ */
+typedef struct
+{
+    double epsilon;            /* Stop once ||H_new - H||_F^2 < epsilon */
+    double relative_tolerance; /* Stop once ||H_new - H||_F < relative_tolerance * ||H_new||_F (0 to disable) */
+    double time_budget;        /* Stop after this many seconds of updates (0 for no limit) */
+    int max_iter;              /* Most updates performed */
+    double beta;               /* Step of the damped update, 0 < beta <= 1 */
+    int method;                /* Update engine, one of SOLVER_* */
+} solver_options_t;
+
+/* Statistics of one symNMF run, filled in only when a caller asks for them
+ * Times are wall-clock seconds; stages a path does not run stay 0.
+ * Start from clear_stats and release the history with free_stats.
+ */
+typedef struct
+{
+    double similarity_seconds; /* Building the similarity matrix */
+    double degree_seconds;     /* Summing the degrees */
+    double normalize_seconds;  /* Normalizing the similarity matrix into W */
+    double optimize_seconds;   /* The H update loop */
+    double w_squared_norm;     /* ||W||_F^2, set before optimizing to record objectives */
+    int iterations;            /* Updates performed */
+    int converged;             /* Nonzero if the loop met a tolerance rather than the iteration cap or time budget */
+    double *deltas;            /* ||H_new - H||_F^2 of every iteration */
+    double *objectives;        /* ||W - H H^T||_F at the point every iteration evaluated (see h_workspace_t) */
+} symnmf_stats_t;
+
+/* Kernel computing WH = W * H for a symmetric W in some storage format
+ * W: The matrix (a matrix_t, packed_matrix_t, ... matching the kernel)
+ * H: The right-hand side (n x k)
+ * WH: Output matrix (n x k), overwritten
+ */
+typedef void (*w_product_fn)(const void *W, const matrix_t *H, matrix_t *WH);
+
+/* Function to calculate the similarity matrix
+ * data: Matrix of data points (n x d)
+ * Returns: Matrix representing the similarity matrix (n x n)
+ */
+matrix_t *calculate_similarity_matrix(const matrix_t *data);
+
+/* Helper function to calculate the squared norm of every row of a matrix
+ * data: Matrix of data points (n x d)
+ * Returns: Allocated vector of the n squared norms, to be released with free
+ */
+double *calculate_squared_norms(const matrix_t *data);
+
+/* Helper function to calculate one tile of the squared Euclidean distances between the data points
+ * Same parameters as calculate_similarity_tile; the distances are clamped at
+ * zero and the distance of a point to itself is exactly zero.
+ */
+void calculate_squared_distance_tile(const matrix_t *data, const matrix_t *data_T, const double *sq_norms,
+                                     int row, int col, matrix_t *tile);
+
+/* Helper function to calculate one tile of the similarity matrix
+ * data: Matrix of data points (n x d)
+ * data_T: Transpose of data (d x n)
+ * sq_norms: Squared norms of the data points (see calculate_squared_norms)
+ * row, col: Position of the tile's top-left element in the similarity matrix
+ * tile: Output tile, its shape sets the tile size; overwritten
+ */
+void calculate_similarity_tile(const matrix_t *data, const matrix_t *data_T, const double *sq_norms,
+                               int row, int col, matrix_t *tile);
+
+/* Function to calculate the degree vector (row sums of the similarity matrix)
+ * similarity_matrix: The similarity matrix (n x n)
+ * Returns: Allocated vector of the n degrees, to be released with free
+ */
+double *calculate_degree_vector(const matrix_t *similarity_matrix);
+
+/* Function to calculate the diagonal degree matrix
+ * Only needed when the dense matrix itself is requested (the ddg goal);
+ * the normalization works from the degree vector.
+ * similarity_matrix: The similarity matrix (n x n)
+ * Returns: Matrix representing the diagonal degree matrix (n x n)
+ */
+matrix_t *calculate_ddg_matrix(const matrix_t *similarity_matrix);
+
+/* Helper function to calculate the diagonal of D^(-1/2), with 0 for zero degrees
+ * degrees: The degree vector (n)
+ * n: The number of degrees
+ * Returns: Allocated vector of the n values d_i^(-1/2), to be released with free
+ */
+double *calculate_inv_sqrt_degrees(const double *degrees, int n);
+
+/* Function to normalize the similarity matrix in place, W_ij = A_ij / sqrt(d_i * d_j)
+ * similarity_matrix: The similarity matrix (n x n), overwritten with W
+ * degrees: The degree vector (n)
+ */
+void normalize_similarity_matrix(matrix_t *similarity_matrix, const double *degrees);
+
+/* Function to calculate the normalized similarity matrix
+ * similarity_matrix: The similarity matrix (n x n)
+ * degrees: The degree vector (n)
+ * Returns: Matrix representing the normalized similarity matrix (n x n)
+ */
+matrix_t *calculate_normalized_similarity_matrix(const matrix_t *similarity_matrix, const double *degrees);
+
+/* Function to optimize H using the iterative update rule
+ * H: Initial H matrix (n x k)
+ * W: Normalized similarity matrix (n x n)
+ * Returns: Optimized H matrix (n x k)
+ */
+matrix_t *optimize_h(const matrix_t *H, const matrix_t *W);
+
+/* Function to optimize H using the iterative update rule with the given options
+ * (see optimize_h_with_options; ||W||_F^2 is calculated here for the statistics)
+ * options: Solver parameters, or NULL for the defaults
+ * stats: Statistics to fill in, or NULL
+ */
+matrix_t *optimize_h_options(const matrix_t *H, const matrix_t *W, const solver_options_t *options,
+                             symnmf_stats_t *stats);
+
+/* Function to optimize H using the iterative update rule for any storage of W
+ * H: Initial H matrix (n x k)
+ * W: Normalized similarity matrix (n x n) in the format product expects
+ * product: Kernel computing W * H
+ * Returns: Optimized H matrix (n x k)
+ */
+matrix_t *optimize_h_with(const matrix_t *H, const void *W, w_product_fn product);
+
+/* Function to optimize H for any storage of W with the given options, recording statistics
+ * Same as optimize_h_with, which uses the default options; with stats, the
+ * iteration count, the convergence history and the time of the loop are
+ * recorded. The objective is derived from products the update computes
+ * anyway, so recording costs O(nk) per iteration, and nothing without stats.
+ * options: Solver parameters, or NULL for the defaults
+ * stats: Statistics to fill in (w_squared_norm set by the caller), or NULL
+ */
+matrix_t *optimize_h_with_options(const matrix_t *H, const void *W, w_product_fn product,
+                                  const solver_options_t *options, symnmf_stats_t *stats);
+
+/* Helper function to set solver options to the defaults (EPSILON, MAX_ITER, BETA, no other limit,
+ * the multiplicative engine)
+ * options: The options to set
+ */
+void default_solver_options(solver_options_t *options);
+
+/* Helper function to check solver options
+ * options: The options to check
+ * Returns: 1 if every parameter is in range, 0 otherwise
+ */
+int valid_solver_options(const solver_options_t *options);
+
+/* Helper function to test the convergence conditions of solver options after an update
+ * options: Solver parameters (epsilon and relative_tolerance are used)
+ * frobenius_diff: ||H_new - H||_F^2 of the update
+ * H_new: The updated H
+ * Returns: 1 if the solver should stop, 0 otherwise
+ */
+int h_converged(const solver_options_t *options, double frobenius_diff, const matrix_t *H_new);
+
+/* Function to optimize a batch of H matrices against the same W (implemented in solvers.c)
+ * Each iteration computes one wide product W * [H_1 H_2 ...] for the members
+ * still running; every member otherwise behaves as its own optimize_h_with_options
+ * run (engine, epsilon, relative_tolerance and max_iter apply per member, the
+ * time budget to the whole batch).
+ * initial_H: The count initial H matrices (n x k_m, the k_m may differ)
+ * count: The number of members (at least 1)
+ * W: Normalized similarity matrix (n x n) in the format product expects
+ * product: Kernel computing W * H
+ * w_squared_norm: ||W||_F^2, for the objectives
+ * options: Solver parameters, or NULL for the defaults
+ * final_H: Output array of count optimized H matrices (n x k_m), to be freed by the caller
+ * objectives: Output array of count values of ||W - H H^T||_F
+ * iterations: Output array of count iteration counts
+ */
+void optimize_h_batch(const matrix_t *const *initial_H, int count, const void *W, w_product_fn product,
+                      double w_squared_norm, const solver_options_t *options,
+                      matrix_t **final_H, double *objectives, int *iterations);
+
+/* Function to optimize a batch of H matrices against a dense W (see optimize_h_batch) */
+void optimize_h_batch_dense(const matrix_t *const *initial_H, int count, const matrix_t *W,
+                            const solver_options_t *options, matrix_t **final_H, double *objectives,
+                            int *iterations);
+
+/* Helper function to reset statistics before a run
+ * stats: The statistics to reset (no history allocated)
+ */
+void clear_stats(symnmf_stats_t *stats);
+
+/* Helper function to release the convergence history of statistics
+ * stats: The statistics whose history to free (may be NULL)
+ */
+void free_stats(symnmf_stats_t *stats);
+
+/* Helper function to read a monotonic wall clock
+ * Returns: Seconds since an arbitrary starting point
+ */
+double wall_seconds(void);
+
+/* Helper function to calculate the squared Frobenius norm of a matrix
+ * matrix: The input matrix
+ * Returns: The sum of the squares of all elements
+ */
+double matrix_squared_norm(const matrix_t *matrix);
+
+/* Helper function to seed a random number generator (as numpy.random.seed(seed))
+ * rng: The generator to seed
+ * seed: The seed, 0 .. 2^32 - 1
+ */
+void rng_seed(rng_t *rng, unsigned long seed);
+
+/* Helper function to draw a uniform value in [0, 1) with 53 random bits
+ * (as numpy.random.random_sample)
+ * rng: A seeded generator
+ * Returns: The value
+ */
+double rng_uniform(rng_t *rng);
+
+/* Function to initialize H for optimize_h
+ * Values are uniform in [0, 2 * sqrt(mean / k)), drawn in row-major order
+ * like numpy.random.uniform(0, 2 * sqrt(mean / k), size=(n, k)).
+ * n: The number of data points
+ * k: The number of clusters
+ * mean: The average of all n x n entries of W
+ * rng: A seeded generator
+ * Returns: Initial H matrix (n x k)
+ */
+matrix_t *initialize_h(int n, int k, double mean, rng_t *rng);
+
+/* Function to run the whole symNMF pipeline on the data points
+ * Builds W in packed storage, initializes H from its mean (unless an initial
+ * H is given) and optimizes H; W never leaves this function.
+ * (Implemented in packed.c, with symnmf_from_data_f32 for float32 mode.)
+ * data: Matrix of data points (n x d)
+ * k: The number of clusters
+ * seed: Seed for the H initialization
+ * initial_H: Initial H matrix (n x k), or NULL to draw one
+ * options: Solver parameters, or NULL for the defaults
+ * stats: Statistics to fill in (stage times and convergence), or NULL
+ * Returns: Optimized H matrix (n x k)
+ */
+matrix_t *symnmf_from_data(const matrix_t *data, int k, unsigned long seed, const matrix_t *initial_H,
+                           const solver_options_t *options, symnmf_stats_t *stats);
+
+/* Helper function to free a matrix allocated by allocate_matrix
+ * matrix: The matrix to free (may be NULL)
+ */
+void free_matrix(matrix_t *matrix);
+
+/* Helper function to allocate a zero-initialized matrix in one aligned block
+ * rows: The number of rows
+ * cols: The number of columns
+ * Returns: Allocated matrix
+ */
+matrix_t *allocate_matrix(int rows, int cols);
+
+/* Helper function to allocate a zero-initialized vector
+ * length: The number of elements
+ * Returns: Allocated vector, to be released with free
+ */
+double *allocate_vector(int length);
+
+/* Helper function to copy a matrix into a newly allocated one
+ * matrix: The matrix to copy
+ * Returns: Allocated copy of the matrix
+ */
+matrix_t *copy_matrix(const matrix_t *matrix);
+
+/* Helper function to describe a block of a matrix without copying it
+ * matrix: The matrix to view
+ * row, col: Position of the top-left element of the block
+ * rows, cols: Shape of the block
+ * Returns: A view sharing the matrix storage (never passed to free_matrix)
+ */
+matrix_t matrix_view(const matrix_t *matrix, int row, int col, int rows, int cols);
+
+/* Helper function to calculate the dot product of two vectors
+ * vec1: The first vector
+ * vec2: The second vector
+ * d: The dimension of the vectors
+ * Returns: The dot product
+ */
+double dot_product(const double *vec1, const double *vec2, int d);
+
+/* Helper function to calculate the squared Euclidean distance between two vectors
+ * vec1: The first vector
+ * vec2: The second vector
+ * d: The dimension of the vectors
+ * Returns: The squared Euclidean distance
+ */
+double squared_euclidean_distance(const double *vec1, const double *vec2, int d);
+
+/* Helper function to calculate matrix product C = A * B
+ * A: First matrix (rows_A x cols_A)
+ * B: Second matrix (rows_B x cols_B), rows_B must equal cols_A
+ * Returns: Result matrix C (rows_A x cols_B)
+ */
+matrix_t *multiply_matrices(const matrix_t *A, const matrix_t *B);
+
+/* Helper function to calculate matrix product C = A * B into an existing matrix
+ * Uses CBLAS dgemm when built with SYMNMF_USE_CBLAS, otherwise a cache-blocked
+ * kernel with a SIMD micro-kernel selected at runtime.
+ * A: First matrix (m x k)
+ * B: Second matrix (k x n)
+ * C: Output matrix (m x n), overwritten
+ */
+void multiply_matrices_into(const matrix_t *A, const matrix_t *B, matrix_t *C);
+
+/* Helper function to calculate C += A * B into an existing matrix
+ * A: First matrix (m x k)
+ * B: Second matrix (k x n)
+ * C: Matrix (m x n) the product is added to
+ */
+void multiply_matrices_accumulate(const matrix_t *A, const matrix_t *B, matrix_t *C);
+
+/* Helper function to calculate C = W * H for a symmetric W into an existing matrix
+ * Uses CBLAS dsymm when available, otherwise multiply_matrices_into.
+ * W: Symmetric matrix (n x n)
+ * H: Second matrix (n x k)
+ * C: Output matrix (n x k), overwritten
+ */
+void multiply_symmetric_into(const matrix_t *W, const matrix_t *H, matrix_t *C);
+
+/* Helper function to calculate the Gram matrix H^T * H into an existing matrix
+ * Uses CBLAS dsyrk when available, otherwise a single streaming pass over H.
+ * H: The input matrix (n x k)
+ * G: Output matrix (k x k), overwritten
+ */
+void calculate_gram_matrix_into(const matrix_t *H, matrix_t *G);
+
+/* Helper function to replace every value of a vector by its exponential
+ * Uses an AVX-512 or AVX2 polynomial kernel when the CPU supports it.
+ * values: The vector, overwritten with exp of each element
+ * length: The number of elements
+ */
+void vector_exp(double *values, int length);
+
+/* Helper function to choose the SIMD kernels for this CPU up front
+ * They are otherwise chosen on first use; callers that may start computations
+ * from several threads at once call this first so no two threads race to do it.
+ */
+void select_kernels(void);
+
+/* Helper function to name the built-in micro-kernel
+ * Returns: "avx512", "avx2" or "scalar"
+ */
+const char *gemm_kernel_name(void);
+
+/* Helper function to name the backend used for matrix products
+ * Returns: "cblas" when built with SYMNMF_USE_CBLAS, otherwise gemm_kernel_name()
+ */
+const char *matrix_backend_name(void);
+
+/* Helper function to calculate the Gram matrix H^T * H
+ * H: The input matrix (n x k)
+ * Returns: The symmetric Gram matrix (k x k)
+ */
+matrix_t *calculate_gram_matrix(const matrix_t *H);
+
+/* Helper function to perform one iteration of the H update rule
+ * H: Current H matrix (n x k)
+ * W: Normalized similarity matrix (n x n)
+ * Returns: Updated H matrix (n x k)
+ */
+matrix_t *update_h_iteration(const matrix_t *H, const matrix_t *W);
+
+/* Helper function to perform one iteration of the H update rule for any storage of W
+ * H: Current H matrix (n x k)
+ * W: Normalized similarity matrix (n x n) in the format product expects
+ * product: Kernel computing W * H
+ * Returns: Updated H matrix (n x k)
+ */
+matrix_t *update_h_iteration_with(const matrix_t *H, const void *W, w_product_fn product);
+
+/* Helper function to allocate the workspace of optimize_h
+ * n: The number of rows of H
+ * k: The number of columns of H
+ * Returns: Allocated workspace
+ */
+h_workspace_t *allocate_h_workspace(int n, int k);
+
+/* Helper function to free the workspace of optimize_h
+ * workspace: The workspace to free (may be NULL); its H buffers may be NULL
+ */
+void free_h_workspace(h_workspace_t *workspace);
+
+/* Helper function to perform one iteration of the H update rule into an existing matrix
+ * The squared Frobenius distance between the new and the old H is summed
+ * while the update is written, so no separate pass is needed for convergence.
+ * H: Current H matrix (n x k)
+ * W: Normalized similarity matrix (n x n) in the format product expects
+ * product: Kernel computing W * H
+ * workspace: Workspace from allocate_h_workspace(n, k) (its H buffers are not used)
+ * H_new: Output matrix (n x k), overwritten; must not be H
+ * beta: Step of the damped update (BETA by default)
+ * Returns: ||H_new - H||_F^2
+ */
+double update_h_iteration_into(const matrix_t *H, const void *W, w_product_fn product,
+                               h_workspace_t *workspace, matrix_t *H_new, double beta);
+
+/* Function to perform one iteration of the extrapolated (Nesterov-style) multiplicative update
+ * (implemented in solvers.c, as are the other engines and their names)
+ * Same contract as update_h_iteration_into; the momentum is kept in the
+ * workspace, so it must serve one run from its first iteration.
+ * Returns: ||H_new - H||_F^2
+ */
+double nesterov_iteration_into(const matrix_t *H, const void *W, w_product_fn product,
+                               h_workspace_t *workspace, matrix_t *H_new, double beta);
+
+/* Helper function to calculate the point the next Nesterov iteration evaluates
+ * (the first half of nesterov_iteration_into, for callers that compute W * Y themselves)
+ * H: The current H matrix (n x k)
+ * workspace: The workspace of the run
+ * Returns: The extrapolated point Y (owned by the workspace)
+ */
+matrix_t *nesterov_extrapolate(const matrix_t *H, h_workspace_t *workspace);
+
+/* Helper function to finish a Nesterov iteration from the point nesterov_extrapolate returned
+ * product must compute W * Y for that point; the rest is as nesterov_iteration_into.
+ * Returns: ||H_new - H||_F^2
+ */
+double nesterov_step_into(const matrix_t *H, const void *W, w_product_fn product,
+                          h_workspace_t *workspace, matrix_t *H_new, double beta);
+
+/* Function to perform one iteration of the proximal block coordinate descent (ANLS) update
+ * Same contract as update_h_iteration_into (there is no beta).
+ * Returns: ||H_new - H||_F^2
+ */
+double bcd_iteration_into(const matrix_t *H, const void *W, w_product_fn product,
+                          h_workspace_t *workspace, matrix_t *H_new);
+
+/* Helper function to look up an update engine by name
+ * name: "multiplicative", "nesterov" or "bcd"
+ * Returns: The SOLVER_* value, or -1 for an unknown name
+ */
+int solver_method_from_name(const char *name);
+
+/* Helper function to get the name of an update engine
+ * method: One of SOLVER_*
+ * Returns: Its name, as accepted by solver_method_from_name
+ */
+const char *solver_method_name(int method);
+
+/* Helper function to calculate the transpose of a matrix
+ * matrix: The input matrix (rows x cols)
+ * Returns: The transposed matrix (cols x rows)
+ */
+matrix_t *calculate_Ht_matrix(const matrix_t *matrix);
+
+/* Helper function to set the number of threads used by the parallel loops
+ * Only has an effect when built with OpenMP (make OPENMP=1). The count is
+ * shared by the process, so it holds for computations started from any thread.
+ * threads: The number of threads, at least 1
+ */
+void set_thread_count(int threads);
+
+/* Helper function to get the number of threads used by the parallel loops
+ * Returns: The count given to set_thread_count (the OpenMP default before that), always 1 without OpenMP
+ */
+int get_thread_count(void);
+
+/* Helper function to get the index of the calling thread inside a parallel loop
+ * Returns: A value in [0, get_thread_count()), 0 outside a parallel region
+ */
+int get_thread_index(void);
+
+/* Packed symmetric storage (implemented in packed.c) */
+
+/* Helper function to allocate a zero-initialized packed symmetric matrix
+ * n: The number of rows (and columns)
+ * Returns: Allocated packed matrix
+ */
+packed_matrix_t *allocate_packed_matrix(int n);
+
+/* Helper function to free a packed symmetric matrix
+ * matrix: The matrix to free (may be NULL)
+ */
+void free_packed_matrix(packed_matrix_t *matrix);
+
+/* Helper function to expand a packed symmetric matrix into a dense one
+ * matrix: The packed matrix (n x n)
+ * Returns: Dense matrix (n x n)
+ */
+matrix_t *unpack_matrix(const packed_matrix_t *matrix);
+
+/* Function to calculate the similarity matrix in packed storage
+ * data: Matrix of data points (n x d)
+ * Returns: Packed similarity matrix (n x n)
+ */
+packed_matrix_t *calculate_packed_similarity_matrix(const matrix_t *data);
+
+/* Function to calculate the degree vector of a packed similarity matrix
+ * similarity_matrix: The packed similarity matrix (n x n)
+ * Returns: Allocated vector of the n degrees, to be released with free
+ */
+double *calculate_packed_degree_vector(const packed_matrix_t *similarity_matrix);
+
+/* Function to normalize a packed similarity matrix in place, W_ij = A_ij / sqrt(d_i * d_j)
+ * similarity_matrix: The packed similarity matrix (n x n), overwritten with W
+ * degrees: The degree vector (n)
+ */
+void normalize_packed_similarity_matrix(packed_matrix_t *similarity_matrix, const double *degrees);
+
+/* Helper function to calculate C = W * H for a packed symmetric W into an existing matrix
+ * W: Packed symmetric matrix (n x n)
+ * H: Second matrix (n x k)
+ * C: Output matrix (n x k), overwritten
+ */
+void multiply_packed_into(const packed_matrix_t *W, const matrix_t *H, matrix_t *C);
+
+/* Helper function to calculate the mean of all n x n elements of a packed symmetric matrix
+ * matrix: The packed matrix (n x n)
+ * Returns: The mean (0 for an empty matrix)
+ */
+double packed_matrix_mean(const packed_matrix_t *matrix);
+
+/* Function to optimize H using the iterative update rule with a packed W
+ * H: Initial H matrix (n x k)
+ * W: Packed normalized similarity matrix (n x n)
+ * Returns: Optimized H matrix (n x k)
+ */
+matrix_t *optimize_h_packed(const matrix_t *H, const packed_matrix_t *W);
+
+/* Function to optimize H with a packed W with the given options (see optimize_h_options) */
+matrix_t *optimize_h_packed_options(const matrix_t *H, const packed_matrix_t *W, const solver_options_t *options,
+                                    symnmf_stats_t *stats);
+
+/* Helper function to calculate the squared Frobenius norm of a packed symmetric matrix
+ * matrix: The packed matrix (n x n)
+ * Returns: The sum of the squares of all n x n elements
+ */
+double packed_matrix_squared_norm(const packed_matrix_t *matrix);
+
+/* Function to optimize a batch of H matrices against a packed W (see optimize_h_batch) */
+void optimize_h_packed_batch(const matrix_t *const *initial_H, int count, const packed_matrix_t *W,
+                             const solver_options_t *options, matrix_t **final_H, double *objectives,
+                             int *iterations);
+
+/* Function to run the symNMF pipeline for a batch of (k, seed) pairs, building W once
+ * Member m starts from the H that symnmf_from_data(data, ks[m], seeds[m], ...)
+ * would draw, and all members are solved together by optimize_h_batch.
+ * data: Data points (n x d)
+ * count: The number of members (at least 1)
+ * ks, seeds: The k (1 <= k <= n) and seed of each member
+ * options: Solver parameters, or NULL for the defaults
+ * final_H, objectives, iterations: Outputs, as for optimize_h_batch
+ */
+void symnmf_batch_from_data(const matrix_t *data, int count, const int *ks, const unsigned long *seeds,
+                            const solver_options_t *options, matrix_t **final_H, double *objectives,
+                            int *iterations);
+
+/* Float32 mode: the same packed kernels with W stored in float (generated
+ * from packed_template.h). Only the storage is single precision: degrees,
+ * the mean and the products accumulate in double, H stays double, and so
+ * does the convergence check of optimize_h.
+ */
+packed_matrix_f32_t *allocate_packed_matrix_f32(int n);
+void free_packed_matrix_f32(packed_matrix_f32_t *matrix);
+matrix_t *unpack_matrix_f32(const packed_matrix_f32_t *matrix);
+packed_matrix_f32_t *calculate_packed_similarity_matrix_f32(const matrix_t *data);
+double *calculate_packed_degree_vector_f32(const packed_matrix_f32_t *similarity_matrix);
+void normalize_packed_similarity_matrix_f32(packed_matrix_f32_t *similarity_matrix, const double *degrees);
+void multiply_packed_into_f32(const packed_matrix_f32_t *W, const matrix_t *H, matrix_t *C);
+double packed_matrix_mean_f32(const packed_matrix_f32_t *matrix);
+matrix_t *optimize_h_packed_f32(const matrix_t *H, const packed_matrix_f32_t *W);
+matrix_t *optimize_h_packed_options_f32(const matrix_t *H, const packed_matrix_f32_t *W,
+                                        const solver_options_t *options, symnmf_stats_t *stats);
+double packed_matrix_squared_norm_f32(const packed_matrix_f32_t *matrix);
+void optimize_h_packed_batch_f32(const matrix_t *const *initial_H, int count, const packed_matrix_f32_t *W,
+                                 const solver_options_t *options, matrix_t **final_H, double *objectives,
+                                 int *iterations);
+void symnmf_batch_from_data_f32(const matrix_t *data, int count, const int *ks, const unsigned long *seeds,
+                                const solver_options_t *options, matrix_t **final_H, double *objectives,
+                                int *iterations);
+matrix_t *symnmf_from_data_f32(const matrix_t *data, int k, unsigned long seed, const matrix_t *initial_H,
+                               const solver_options_t *options, symnmf_stats_t *stats);
+
+/* Sparse affinity mode (implemented in sparse.c) */
+
+/* Helper function to allocate a CSR matrix with empty rows
+ * n: The number of rows (and columns)
+ * nnz: The number of elements to make room for
+ * Returns: Allocated CSR matrix
+ */
+csr_matrix_t *allocate_csr_matrix(int n, size_t nnz);
+
+/* Helper function to free a CSR matrix
+ * matrix: The matrix to free (may be NULL)
+ */
+void free_csr_matrix(csr_matrix_t *matrix);
+
+/* Helper function to check that the kNN graph of n points fits in memory sizes
+ * n: The number of data points
+ * neighbors: Number of nearest neighbours kept per point (at most n - 1 are used)
+ * Returns: 1 if the neighbour lists and the CSR matrix can be sized in size_t, 0 otherwise
+ */
+int sparse_neighbors_fit(int n, int neighbors);
+
+/* Function to calculate a sparse similarity matrix
+ * Keeps A_ij for the `neighbors` nearest neighbours of every point, made
+ * symmetric by keeping an element if either point lists the other, and
+ * drops every affinity below threshold. With neighbors = 0 only the
+ * threshold applies, and it must then be positive.
+ * data: Matrix of data points (n x d)
+ * neighbors: Number of nearest neighbours kept per point, or 0
+ * threshold: Smallest affinity kept (0 keeps every positive affinity, with neighbors >= 1)
+ * Returns: Sparse similarity matrix (n x n)
+ */
+csr_matrix_t *calculate_sparse_similarity_matrix(const matrix_t *data, int neighbors, double threshold);
+
+/* Function to calculate the degree vector of a sparse similarity matrix
+ * similarity_matrix: The sparse similarity matrix (n x n)
+ * Returns: Allocated vector of the n degrees, to be released with free
+ */
+double *calculate_sparse_degree_vector(const csr_matrix_t *similarity_matrix);
+
+/* Function to normalize a sparse similarity matrix in place, W_ij = A_ij / sqrt(d_i * d_j)
+ * similarity_matrix: The sparse similarity matrix (n x n), overwritten with W
+ * degrees: The degree vector (n)
+ */
+void normalize_sparse_similarity_matrix(csr_matrix_t *similarity_matrix, const double *degrees);
+
+/* Helper function to calculate C = W * H for a sparse W into an existing matrix
+ * W: Sparse matrix (n x n)
+ * H: Second matrix (n x k)
+ * C: Output matrix (n x k), overwritten
+ */
+void multiply_sparse_into(const csr_matrix_t *W, const matrix_t *H, matrix_t *C);
+
+/* Function to optimize H using the iterative update rule with a sparse W
+ * H: Initial H matrix (n x k)
+ * W: Sparse normalized similarity matrix (n x n)
+ * Returns: Optimized H matrix (n x k)
+ */
+matrix_t *optimize_h_sparse(const matrix_t *H, const csr_matrix_t *W);
+
+/* Function to optimize H with a sparse W with the given options (see optimize_h_options) */
+matrix_t *optimize_h_sparse_options(const matrix_t *H, const csr_matrix_t *W, const solver_options_t *options,
+                                    symnmf_stats_t *stats);
+
+/* Out-of-core mode (implemented in mapped.c) */
+
+/* Helper function to create a file-backed n x n matrix and map it into memory
+ * file_name: Path of the file, created or truncated (and kept afterwards)
+ * n: The number of rows (and columns)
+ * panel_rows: Rows per panel, or 0 for panels of about MAPPED_PANEL_BYTES
+ * Returns: The mapped matrix (contents zero), or NULL if the file cannot be created or mapped
+ */
+mapped_matrix_t *allocate_mapped_matrix(const char *file_name, int n, int panel_rows);
+
+/* Helper function to unmap a file-backed matrix; the file itself is kept
+ * W: The matrix to free (may be NULL)
+ */
+void free_mapped_matrix(mapped_matrix_t *W);
+
+/* Helper function to describe rows of a mapped matrix as a dense matrix, without copying
+ * W: The mapped matrix
+ * row: First row
+ * rows: Number of rows
+ * Returns: View of W[row:row+rows, :] (block is NULL)
+ */
+matrix_t mapped_rows_view(const mapped_matrix_t *W, int row, int rows);
+
+/* Function to calculate the similarity matrix into a memory-mapped file, panel by panel
+ * data: Matrix of data points (n x d)
+ * file_name: Path of the file holding the matrix
+ * panel_rows: Rows per panel, or 0 for the default
+ * degrees: Vector of n filled with the degrees (row sums), or NULL
+ * Returns: Mapped similarity matrix (n x n), or NULL if the file cannot be created
+ */
+mapped_matrix_t *calculate_mapped_similarity_matrix(const matrix_t *data, const char *file_name,
+                                                    int panel_rows, double *degrees);
+
+/* Function to normalize a mapped similarity matrix in place, W_ij = A_ij / sqrt(d_i * d_j)
+ * W: The mapped similarity matrix (n x n), overwritten with W
+ * degrees: The degree vector (n)
+ * Returns: The mean of all n x n elements of the normalized matrix
+ */
+double normalize_mapped_similarity_matrix(mapped_matrix_t *W, const double *degrees);
+
+/* Helper function to calculate C = W * H for a mapped W into an existing matrix
+ * W: Mapped matrix (n x n), streamed one panel at a time
+ * H: Second matrix (n x k)
+ * C: Output matrix (n x k), overwritten
+ */
+void multiply_mapped_into(const mapped_matrix_t *W, const matrix_t *H, matrix_t *C);
+
+/* Function to optimize H using the iterative update rule with a mapped W
+ * H: Initial H matrix (n x k)
+ * W: Mapped normalized similarity matrix (n x n)
+ * Returns: Optimized H matrix (n x k)
+ */
+matrix_t *optimize_h_mapped(const matrix_t *H, const mapped_matrix_t *W);
+
+/* Helper function to calculate the squared Frobenius norm of a mapped matrix, panel by panel
+ * W: Mapped matrix (n x n)
+ * Returns: The sum of the squares of all n x n elements
+ */
+double mapped_matrix_squared_norm(const mapped_matrix_t *W);
+
+/* Function to run the whole symNMF pipeline with W kept in a memory-mapped file
+ * Same as symnmf_from_data, except that W is written to file_name and streamed in panels.
+ * file_name: Path of the file holding W (created or truncated, and kept afterwards)
+ * panel_rows: Rows of W per panel, or 0 for the default
+ * Returns: Optimized H matrix (n x k), or NULL if the file cannot be created
+ * (With stats, the degrees are timed as part of the similarity matrix, which sums them.)
+ */
+matrix_t *symnmf_from_data_mapped(const matrix_t *data, int k, unsigned long seed, const matrix_t *initial_H,
+                                  const char *file_name, int panel_rows, const solver_options_t *options,
+                                  symnmf_stats_t *stats);
+
+/* Incremental mode (implemented in incremental.c) */
+
+/* Function to calculate the similarity matrix of data points in incremental storage
+ * data: Matrix of data points (n x d)
+ * Returns: The similarity matrix with its degrees, to be grown with extend_affinity_matrix
+ */
+affinity_matrix_t *calculate_affinity_matrix(const matrix_t *data);
+
+/* Function to append data points to a similarity matrix in incremental storage
+ * Computes the affinities of the new points only and adds them to the
+ * degrees, in O(n * new points); the previous rows are not touched.
+ * A: The similarity matrix, grown in place
+ * points: The new data points (m x d, with the d of A)
+ */
+void extend_affinity_matrix(affinity_matrix_t *A, const matrix_t *points);
+
+/* Helper function to free a similarity matrix in incremental storage
+ * A: The matrix to free (may be NULL)
+ */
+void free_affinity_matrix(affinity_matrix_t *A);
+
+/* Function to expand the normalized similarity matrix W = D^(-1/2) A D^(-1/2) into a dense matrix
+ * A: The similarity matrix in incremental storage (n x n)
+ * Returns: The normalized similarity matrix (n x n)
+ */
+matrix_t *unpack_normalized_affinity(const affinity_matrix_t *A);
+
+/* Helper function to calculate C = W * H with W = D^(-1/2) A D^(-1/2) into an existing matrix
+ * A: The similarity matrix in incremental storage (n x n)
+ * H: The right-hand side (n x k)
+ * C: Output matrix (n x k), overwritten
+ */
+void multiply_normalized_affinity_into(const affinity_matrix_t *A, const matrix_t *H, matrix_t *C);
+
+/* Helper function to calculate ||W||_F^2 for W = D^(-1/2) A D^(-1/2)
+ * A: The similarity matrix in incremental storage
+ * Returns: The squared Frobenius norm of W
+ */
+double normalized_affinity_squared_norm(const affinity_matrix_t *A);
+
+/* Function to optimize H against W = D^(-1/2) A D^(-1/2) with the given options
+ * (see optimize_h_with_options; ||W||_F^2 is calculated here for the statistics)
+ */
+matrix_t *optimize_h_affinity_options(const matrix_t *H, const affinity_matrix_t *A, const solver_options_t *options,
+                                      symnmf_stats_t *stats);
+
+/* Function to extend H to the rows of new points, as a warm start for optimize_h
+ * Each new row is the average of the previous rows weighted by the point's
+ * normalized affinities to the previous points (the average of all previous
+ * rows for a point without any).
+ * H: The previous H (n0 x k, n0 >= 1)
+ * A: The similarity matrix of all the points (n x n), the n0 previous ones first
+ * Returns: H with n rows, the first n0 copied
+ */
+matrix_t *extend_h(const matrix_t *H, const affinity_matrix_t *A);
+
+/* k-means (implemented in kmeans.c) */
+
+/* Function to cluster data points with k-means, as kmeans.py does
+ * The first k points start as the centroids; each iteration assigns every
+ * point to its nearest centroid (the first one on ties) and moves the
+ * centroids to the means of their points, until they moved less than
+ * epsilon in total or after max_iter iterations.
+ * data: Data points (n x d)
+ * k: The number of clusters (1 <= k <= n)
+ * max_iter: The maximum number of iterations (0 keeps the initial centroids)
+ * epsilon: Threshold on the total distance the centroids moved (KMEANS_EPSILON by default)
+ * labels: Output array of n cluster indices, for the final centroids
+ * iterations: Set to the number of iterations run, or NULL
+ * Returns: The final centroids (k x d)
+ */
+matrix_t *kmeans(const matrix_t *data, int k, int max_iter, double epsilon, int *labels, int *iterations);
+
+/* Silhouette scores (implemented in silhouette.c) */
+
+/* Function to check that a labeling can be scored
+ * labels: The cluster index of every point
+ * n: The number of points
+ * clusters: The number of clusters; every label must be in 0 .. clusters - 1
+ * Returns: 1 if the labels are in range and use between 2 and n - 1 clusters, 0 otherwise
+ */
+int valid_labeling(const int *labels, int n, int clusters);
+
+/* Function to calculate the silhouette scores of several labelings of the same data points
+ * The distances are streamed in tiles and computed once for all the
+ * labelings, with O(n * clusters) memory per labeling; the scores are those
+ * of sklearn.metrics.silhouette_score with the Euclidean distance.
+ * data: Data points (n x d)
+ * labelings: count labelings, each accepted by valid_labeling
+ * clusters: The number of clusters of each labeling
+ * count: The number of labelings
+ * scores: Output array of count scores
+ */
+void silhouette_scores(const matrix_t *data, const int *const *labelings, const int *clusters, int count,
+                       double *scores);
+
+/* Matrix files and output (implemented in io.c) */
+
+/* Function to read data points from a file
+ * Comma-separated text, or a binary matrix file starting with BINARY_MAGIC.
+ * Malformed files are reported (with their line on stderr) and exit.
+ * file_name: Path of the file
+ * n: Set to the number of rows
+ * d: Set to the number of columns
+ * Returns: Matrix of data points (n x d), or NULL for an empty file
+ */
+matrix_t *read_data_from_file(const char *file_name, int *n, int *d);
+
+/* Helper function to read a binary matrix file
+ * file_name: Path of the file
+ * Returns: The matrix, or NULL if the file cannot be read, is not a float64 binary matrix
+ *          or does not hold exactly the rows and columns of its header
+ */
+matrix_t *load_binary_matrix(const char *file_name);
+
+/* Helper function to write a binary matrix file
+ * file_name: Path of the file, created or truncated
+ * matrix: The matrix to write
+ * Returns: 0 on success, 1 on failure
+ */
+int save_binary_matrix(const char *file_name, const matrix_t *matrix);
+
+/* Function to write a matrix as text or in the binary format
+ * Text has one line per row with values to 4 decimal places separated by commas.
+ * file: Destination, opened in binary mode for the binary format
+ * matrix: The matrix to write
+ * binary: Nonzero for the binary format
+ * Returns: 0 on success, 1 if writing failed
+ */
+int write_matrix(FILE *file, const matrix_t *matrix, int binary);
+
+/* Function to write a packed symmetric matrix as text or in the binary format
+ * Same as write_matrix, for the full n x n matrix.
+ */
+int write_packed_matrix(FILE *file, const packed_matrix_t *matrix, int binary);
+
+/* Function to write a float32 packed symmetric matrix as text or in the binary format
+ * Same as write_packed_matrix; the values are written as doubles.
+ */
+int write_packed_matrix_f32(FILE *file, const packed_matrix_f32_t *matrix, int binary);
+
+/* Function to write a diagonal matrix given by its diagonal as text or in the binary format
+ * Same as write_matrix, for the full n x n matrix.
+ */
+int write_diagonal_matrix(FILE *file, const double *diagonal, int n, int binary);
+
+/* Function to write run statistics as text
+ * One "name value" line per stage time and for the iteration count, then
+ * one "iteration delta objective" line per recorded iteration.
+ * file: Destination
+ * stats: The statistics to write
+ * Returns: 0 on success, 1 if writing failed
+ */
+int write_stats(FILE *file, const symnmf_stats_t *stats);
+
+/* Function to format a matrix as text, as write_matrix does
+ * matrix: The matrix to format
+ * length: Set to the length of the text
+ * Returns: The text (not terminated), to be released with free
+ */
+char *format_matrix(const matrix_t *matrix, size_t *length);
+
+#endif /* SYMNMF_H */
@@ -9,51 +9,108 @@ import sys
 import numpy as np
 import symnmfmodule # This will import the C extension module
 
-# Set random seed for reproducibility as required
-np.random.seed(1234)
+# Seed of the H initialization, for reproducibility as required
+SEED = 1234
+
+# Set random seed for reproducibility as required (the fused C pipeline seeds its own
+# generator with SEED, drawing the same values NumPy would)
+np.random.seed(SEED)
+
+# Default number of nearest neighbours kept per point by the 'symnmf_knn' goal
+DEFAULT_NEIGHBORS = 10
+
+# Leading bytes of a binary matrix file (see io.c)
+BINARY_MAGIC = b'SYMNMFB1'
+
+# Command line flags setting solver parameters, and the keyword and type each one maps to
+SOLVER_FLAGS = {
+    '--epsilon': ('epsilon', float),
+    '--rtol': ('rtol', float),
+    '--time-budget': ('time_budget', float),
+    '--max-iter': ('max_iter', int),
+    '--beta': ('beta', float),
+    '--method': ('method', str),
+}
+
+def parse_solver_options(args):
+    """
+    Removes leading solver flags (see SOLVER_FLAGS) from the command line arguments.
+
+    Args:
+        args (list): The arguments after the script name.
+
+    Returns:
+        tuple: (remaining arguments, dict of solver keywords for symnmfmodule)
+    """
+    options = {}
+    while len(args) >= 2 and args[0] in SOLVER_FLAGS:
+        keyword, kind = SOLVER_FLAGS[args[0]]
+        try:
+            options[keyword] = kind(args[1])
+        except ValueError:
+            print("An Error Has Occurred")
+            exit(1)
+        args = args[2:]
+    return args, options
 
 def parse_arguments():
     """
     Parses command line arguments.
 
-    Expected arguments:
+    Expected arguments, after any solver flags (see SOLVER_FLAGS):
     1. k (int): Number of required clusters.
-    2. goal (str): Can be 'symnmf', 'sym', 'ddg', or 'norm'.
+    2. goal (str): Can be 'symnmf', 'symnmf_knn', 'sym', 'ddg', or 'norm'.
     3. file_name (str): Path to the input data file (.txt).
+    4. neighbors (int, optional): Nearest neighbours kept per point ('symnmf_knn' only).
 
     Returns:
-        tuple: (k, goal, file_name)
+        tuple: (k, goal, file_name, neighbors, solver keywords)
     """
+    args, options = parse_solver_options(sys.argv[1:])
     # Assuming arguments are always provided and valid as per instructions
-    if len(sys.argv) != 4:
+    if len(args) not in (3, 4):
         print("An Error Has Occurred")
         exit(1)
 
-    k = sys.argv[1]
-    goal = sys.argv[2]
-    file_name = sys.argv[3]
+    k = args[0]
+    goal = args[1]
+    file_name = args[2]
 
     # goal validation and k value validation (whole number and larger than 1)
-    valid_goals = ['symnmf', 'sym', 'ddg', 'norm']
+    valid_goals = ['symnmf', 'symnmf_knn', 'sym', 'ddg', 'norm']
     if goal not in valid_goals:
         print("An Error Has Occurred")
         exit(1)
 
-    return k, goal, file_name
+    # The neighbour count is only accepted by the sparse goal
+    neighbors = DEFAULT_NEIGHBORS
+    if len(args) == 4:
+        if goal != 'symnmf_knn' or not args[3].isdigit() or int(args[3]) < 1:
+            print("An Error Has Occurred")
+            exit(1)
+        neighbors = int(args[3])
+
+    return k, goal, file_name, neighbors, options
 
 def load_data(file_name):
     """
     Loads data points from the specified file.
 
     Args:
-        file_name (str): Path to the input data file (.txt).
+        file_name (str): Path to the input data file (.txt), or a binary matrix file.
 
     Returns:
         np.ndarray: A numpy array of data points.
     """
     try:
-        # Data points are expected to be comma-separated floats
-        data = np.loadtxt(file_name, delimiter=',')
+        with open(file_name, 'rb') as file:
+            is_binary = file.read(len(BINARY_MAGIC)) == BINARY_MAGIC
+        if is_binary:
+            # Binary matrix files are read by the C extension, without parsing text
+            data = np.asarray(symnmfmodule.load(file_name))
+        else:
+            # Data points are expected to be comma-separated floats
+            data = np.loadtxt(file_name, delimiter=',')
         if len(data) == 0:
             print("An Error Has Occurred")
             exit(1)
@@ -63,23 +120,22 @@ def load_data(file_name):
         print("An Error Has Occurred")
         exit(1)
 
-def initialize_h(W, k):
+def initialize_h(m, n, k):
     """
     Initializes the matrix H for symNMF.
 
     Initialization is random with values from [0, 2 * sqrt(m/k)],
-    where m is the average of all entries of W.
+    where m is the average of all entries of W. Used by the sparse goal;
+    symnmfmodule.fit does the same in C for the dense one.
 
     Args:
-        W (np.ndarray): The normalized similarity matrix.
+        m (float): The average of all n * n entries of W.
+        n (int): The number of data points.
         k (int): The number of clusters.
 
     Returns:
         np.ndarray: The initialized H matrix.
     """
-    n = W.shape[0]
-    # Calculate the average of all entries in W
-    m = np.mean(W)
     # Calculate the upper bound for uniform distribution
     upper_bound = 2 * np.sqrt(m / k)
 
@@ -94,50 +150,86 @@ def print_matrix(matrix):
     Args:
         matrix (np.ndarray): The matrix to print.
     """
-    # Iterate through rows
-    for row in matrix:
-        # Format each element to 4 decimal places and join with commas
-        print(','.join([f'{x:.4f}' for x in row]))
+    # Each element is formatted to 4 decimal places and joined with commas by the C extension
+    sys.stdout.write(symnmfmodule.to_text(np.ascontiguousarray(matrix, dtype=np.float64)))
+
+def parse_k(sk, n):
+    """
+    Parses and validates the number of clusters.
+
+    Args:
+        sk (str): k as given on the command line.
+        n (int): The number of data points.
+
+    Returns:
+        int: k, a whole number with 1 < k < n.
+    """
+    try:
+        fk = float(sk)
+    except:
+        print("An Error Has Occurred")
+        exit(1)
+
+    k = int(fk)
+
+    if n <= k or k != fk or k <= 1:
+        print("An Error Has Occurred")
+        exit(1)
+    return k
+
+def run_solver(solver, *args, **options):
+    """
+    Calls a symnmfmodule solver, reporting solver options it rejects as an error.
+
+    Args:
+        solver (callable): symnmfmodule.fit or symnmfmodule.symnmf_sparse.
+        *args: Its positional arguments.
+        **options: Solver keywords from the command line.
+
+    Returns:
+        The optimized H.
+    """
+    try:
+        return solver(*args, **options)
+    except RuntimeError:
+        print("An Error Has Occurred")
+        exit(1)
 
 def main():
     """
     Main function to execute the symNMF process based on arguments.
     """
-    sk, goal, file_name = parse_arguments()
+    sk, goal, file_name, neighbors, options = parse_arguments()
     data = load_data(file_name)
 
     # Determine which C function to call based on the goal
     if goal == 'sym':
         # Call the C function for similarity matrix
-        similarity_matrix = symnmfmodule.sym(data.tolist()) # Convert numpy array to list
-        print_matrix(np.array(similarity_matrix)) # Convert list back to numpy for printing
+        similarity_matrix = symnmfmodule.sym(data) # The array is passed as a buffer, without copying
+        print_matrix(np.asarray(similarity_matrix)) # Wrap the returned buffer for printing
     elif goal == 'ddg':
         # Call the C function for diagonal degree matrix
-        ddg_matrix = symnmfmodule.ddg(data.tolist())
-        print_matrix(np.array(ddg_matrix))
+        ddg_matrix = symnmfmodule.ddg(data)
+        print_matrix(np.asarray(ddg_matrix))
     elif goal == 'norm':
         # Call the C function for normalized similarity matrix
-        norm_matrix = symnmfmodule.norm(data.tolist())
-        print_matrix(np.array(norm_matrix))
+        norm_matrix = symnmfmodule.norm(data)
+        print_matrix(np.asarray(norm_matrix))
     elif goal == 'symnmf':
-        try:
-            fk = float(sk)
-        except:
-            print("An Error Has Occurred")
-            exit(1)
-
-        k = int(fk)
-
-        if len(data) <= k or k != fk or k <= 1:
-            print("An Error Has Occurred")
-            exit(1)
-        # For symnmf, first get the normalized similarity matrix W
-        W = np.array(symnmfmodule.norm(data.tolist()))
-        # Initialize H
-        H = initialize_h(W, k)
-        # Call the C function for symNMF optimization
-        final_H = symnmfmodule.symnmf(H.tolist(), W.tolist()) # Pass initial H and W
-        print_matrix(np.array(final_H))
+        k = parse_k(sk, len(data))
+        # W, its mean, the seeded H initialization and the optimization all run in C,
+        # so W never crosses into Python
+        final_H = run_solver(symnmfmodule.fit, data, k, SEED, **options)
+        print_matrix(np.asarray(final_H))
+    elif goal == 'symnmf_knn':
+        k = parse_k(sk, len(data))
+        # Sparse W from the k-nearest-neighbour graph, as CSR lists
+        indptr, indices, values = symnmfmodule.knn_norm(data, neighbors)
+        n = len(data)
+        # The mean over all n * n entries; the ones not stored are zero
+        H = initialize_h(sum(values) / (n * n), n, k)
+        final_H = run_solver(symnmfmodule.symnmf_sparse, H, indptr, indices, values, **options)
+        print_matrix(np.asarray(final_H))
 
 if __name__ == "__main__":
     main()
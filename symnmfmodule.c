@@ -1,281 +1,1828 @@
-#define PY_SSIZE_T_CLEAN
-#include <Python.h>
-#include "symnmf.h" /* Include the C header file */
-
-/*
- * Python C API wrapper for the symNMF functions.
- * Exposes C functions to Python.
- */
-
-/* Fill c matrix data with py matrix data */
-double **populate_matrix(PyObject *py_matrix, double **c_matrix, int *n, int *d)
-{
-    int i, j;
-    PyObject *row, *item;
-
-    for (i = 0; i < *n; i++)
-    {
-        row = PyList_GetItem(py_matrix, i);
-        if (!PyList_Check(row) || PyList_Size(row) != *d)
-        {
-            /* Free allocated memory before returning error */
-            free_matrix(c_matrix, i + 1);
-            return NULL;
-        }
-        for (j = 0; j < *d; j++)
-        {
-            item = PyList_GetItem(row, j);
-            if (!PyFloat_Check(item) && !PyLong_Check(item))
-            {
-                /* Free allocated memory before returning error */
-                free_matrix(c_matrix, i + 1);
-                return NULL;
-            }
-            c_matrix[i][j] = PyFloat_AsDouble(item);
-        }
-    }
-    return c_matrix;
-}
-
-/* Helper function to convert a Python list of lists (representing a matrix) to a C 2D array */
-double **py_list_to_c_matrix(PyObject *py_matrix, int *n, int *d)
-{
-    PyObject *first_row;
-    double **c_matrix;
-
-    /* Check if the input is a list */
-    if (!PyList_Check(py_matrix))
-    {
-        return NULL;
-    }
-
-    *n = PyList_Size(py_matrix); /* Number of rows */
-    if (*n == 0)
-    {
-        *d = 0;
-    }
-    else
-    {
-        /* Assume all rows have the same number of columns */
-        first_row = PyList_GetItem(py_matrix, 0);
-        if (!PyList_Check(first_row))
-        {
-            return NULL;
-        }
-        *d = PyList_Size(first_row); /* Number of columns */
-    }
-    c_matrix = allocate_matrix(*n, *d);
-    if (c_matrix == NULL)
-    {
-        return NULL;
-    }
-    c_matrix = populate_matrix(py_matrix, c_matrix, n, d);
-    return c_matrix;
-}
-
-/* Helper function to convert a C 2D array to a Python list of lists */
-PyObject *c_matrix_to_py_list(double **c_matrix, int n, int d)
-{
-    PyObject *py_matrix, *row, *item;
-    int i, j;
-    py_matrix = PyList_New(n);
-    if (py_matrix == NULL)
-    {
-        return NULL;
-    }
-
-    for (i = 0; i < n; i++)
-    {
-        row = PyList_New(d);
-        for (j = 0; j < d; j++)
-        {
-            item = PyFloat_FromDouble(c_matrix[i][j]);
-            PyList_SetItem(row, j, item);
-        }
-        PyList_SetItem(py_matrix, i, row);
-    }
-    return py_matrix;
-}
-
-/* symnmf(H, W) function exposed to Python */
-static PyObject *symnmf_symnmf(PyObject *self, PyObject *args)
-{
-    PyObject *py_H, *py_W, *py_final_H;
-    int n_H, k, n_W, d_W;
-    double **c_H, **c_W, **final_c_H;
-
-    /* Set error string in advance */
-    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
-    /* Parse arguments: two lists of lists (H and W) */
-    if (!PyArg_ParseTuple(args, "OO", &py_H, &py_W))
-        return NULL;
-
-    /* Convert Python lists to C matrices */
-    c_H = py_list_to_c_matrix(py_H, &n_H, &k);
-    if (c_H == NULL)
-        return NULL;
-
-    c_W = py_list_to_c_matrix(py_W, &n_W, &d_W);
-    if (c_W == NULL)
-    {
-        free_matrix(c_H, n_H); /* Free H if W conversion fails */
-        return NULL;
-    }
-
-    /* Call the C optimization function */
-    final_c_H = optimize_h(c_H, c_W, n_H, k);
-
-    /* Free the input C matrices (they were copies) */
-    free_matrix(c_H, n_H);
-    free_matrix(c_W, n_W);
-
-    if (final_c_H == NULL)
-        return NULL;
-
-    /* Convert the result back to a Python list of lists and free the result C matrix */
-    py_final_H = c_matrix_to_py_list(final_c_H, n_H, k);
-    free_matrix(final_c_H, n_H);
-    PyErr_Clear();
-    return py_final_H;
-}
-
-/* sym(data) function exposed to Python */
-static PyObject *symnmf_sym(PyObject *self, PyObject *args)
-{
-    PyObject *py_data, *py_similarity_matrix;
-    double **c_data, **similarity_matrix;
-    int n, d;
-
-    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
-    /* Parse arguments: one list of lists (data points) */
-    if (!PyArg_ParseTuple(args, "O", &py_data))
-        return NULL;
-
-    /* Convert Python list to C matrix */
-    c_data = py_list_to_c_matrix(py_data, &n, &d);
-    if (c_data == NULL)
-        return NULL;
-
-    /* Calculate the similarity matrix */
-    similarity_matrix = calculate_similarity_matrix(c_data, n, d);
-
-    /* Free the input data matrix */
-    free_matrix(c_data, n);
-
-    if (similarity_matrix == NULL)
-        return NULL;
-
-    /* Convert the result back to a Python list of lists */
-    py_similarity_matrix = c_matrix_to_py_list(similarity_matrix, n, n);
-
-    /* Free the result C matrix */
-    free_matrix(similarity_matrix, n);
-    PyErr_Clear();
-    return py_similarity_matrix;
-}
-
-/* ddg(data) function exposed to Python */
-static PyObject *symnmf_ddg(PyObject *self, PyObject *args)
-{
-    PyObject *py_data, *py_ddg_matrix;
-    double **c_data, **similarity_matrix, **ddg_matrix;
-    int n, d;
-
-    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
-    /* Parse arguments: one list of lists (data points) */
-    if (!PyArg_ParseTuple(args, "O", &py_data))
-        return NULL;
-
-    /* Convert Python list to C matrix */
-    c_data = py_list_to_c_matrix(py_data, &n, &d);
-    if (c_data == NULL)
-        return NULL;
-
-    /* Calculate the similarity matrix (needed for DDG) */
-    similarity_matrix = calculate_similarity_matrix(c_data, n, d);
-    /* Free the input data matrix */
-    free_matrix(c_data, n);
-
-    if (similarity_matrix == NULL)
-        return NULL;
-
-    /* Calculate the diagonal degree matrix */
-    ddg_matrix = calculate_ddg_matrix(similarity_matrix, n);
-    /* Free the intermediate similarity matrix */
-    free_matrix(similarity_matrix, n);
-
-    if (ddg_matrix == NULL)
-        return NULL;
-
-    /* Convert the result back to a Python list of lists */
-    py_ddg_matrix = c_matrix_to_py_list(ddg_matrix, n, n);
-    /* Free the result C matrix */
-    free_matrix(ddg_matrix, n);
-    PyErr_Clear();
-    return py_ddg_matrix;
-}
-
-/* norm(data) function exposed to Python */
-static PyObject *symnmf_norm(PyObject *self, PyObject *args)
-{
-    PyObject *py_data, *py_normalized_matrix;
-    int n, d;
-    double **c_data, **similarity_matrix, **ddg_matrix, **normalized_matrix;
-
-    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
-    /* Parse arguments: one list of lists (data points) */
-    if (!PyArg_ParseTuple(args, "O", &py_data))
-        return NULL;
-    /* Convert Python list to C matrix */
-    c_data = py_list_to_c_matrix(py_data, &n, &d);
-    if (c_data == NULL)
-        return NULL;
-    /* Calculate the similarity matrix */
-    similarity_matrix = calculate_similarity_matrix(c_data, n, d);
-    /* Free the input data matrix */
-    free_matrix(c_data, n);
-    if (similarity_matrix == NULL)
-        return NULL;
-    /* Calculate the diagonal degree matrix */
-    ddg_matrix = calculate_ddg_matrix(similarity_matrix, n);
-    if (ddg_matrix == NULL)
-    {
-        free_matrix(similarity_matrix, n); /* Free similarity if DDG fails */
-        return NULL;
-    }
-    /* Calculate the normalized similarity matrix then free used matrices*/
-    normalized_matrix = calculate_normalized_similarity_matrix(similarity_matrix, ddg_matrix, n);
-    free_matrix(similarity_matrix, n);
-    free_matrix(ddg_matrix, n);
-    if (normalized_matrix == NULL)
-        return NULL;
-    /* Convert the result back to a Python list of lists */
-    py_normalized_matrix = c_matrix_to_py_list(normalized_matrix, n, n);
-    /* Free the result C matrix */
-    free_matrix(normalized_matrix, n);
-    PyErr_Clear();
-    return py_normalized_matrix;
-}
-
-/* Method definitions */
-static PyMethodDef symnmf_methods[] = {
-    {"symnmf", symnmf_symnmf, METH_VARARGS, "Performs symNMF optimization."},
-    {"sym", symnmf_sym, METH_VARARGS, "Calculates the similarity matrix."},
-    {"ddg", symnmf_ddg, METH_VARARGS, "Calculates the diagonal degree matrix."},
-    {"norm", symnmf_norm, METH_VARARGS, "Calculates the normalized similarity matrix."},
-    {NULL, NULL, 0, NULL} /* Sentinel */
-};
-
-/* Module definition */
-static struct PyModuleDef symnmfmodule = {
-    PyModuleDef_HEAD_INIT,
-    "symnmfmodule", /* name of module */
-    NULL,           /* module documentation, may be NULL */
-    -1,             /* size of per-interpreter state of the module, or -1 if the module keeps state in global variables. */
-    symnmf_methods};
-
-/* Module initialization function */
-PyMODINIT_FUNC PyInit_symnmfmodule(void)
-{
-    return PyModule_Create(&symnmfmodule);
-}
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "symnmf.h" /* Include the C header file */
+
+/*
+ * Python C API wrapper for the symNMF functions.
+ * Exposes C functions to Python.
+ * Inputs are converted (lists) or pinned (buffers) while holding the GIL, and
+ * the GIL is released for the computation itself, so calls from several
+ * Python threads run concurrently.
+ */
+
+/* Fill c matrix data with py matrix data */
+matrix_t *populate_matrix(PyObject *py_matrix, matrix_t *c_matrix, int *n, int *d)
+{
+    int i, j;
+    PyObject *row, *item;
+    double *c_row;
+
+    for (i = 0; i < *n; i++)
+    {
+        row = PyList_GetItem(py_matrix, i);
+        if (!PyList_Check(row) || PyList_Size(row) != *d)
+        {
+            /* Free allocated memory before returning error */
+            free_matrix(c_matrix);
+            return NULL;
+        }
+        c_row = MATRIX_ROW(c_matrix, i);
+        for (j = 0; j < *d; j++)
+        {
+            item = PyList_GetItem(row, j);
+            if (!PyFloat_Check(item) && !PyLong_Check(item))
+            {
+                /* Free allocated memory before returning error */
+                free_matrix(c_matrix);
+                return NULL;
+            }
+            c_row[j] = PyFloat_AsDouble(item);
+        }
+    }
+    return c_matrix;
+}
+
+/* Helper function to convert a Python list of lists (representing a matrix) to a C matrix */
+matrix_t *py_list_to_c_matrix(PyObject *py_matrix, int *n, int *d)
+{
+    PyObject *first_row;
+    matrix_t *c_matrix;
+
+    /* Check if the input is a list */
+    if (!PyList_Check(py_matrix))
+    {
+        return NULL;
+    }
+
+    *n = PyList_Size(py_matrix); /* Number of rows */
+    if (*n == 0)
+    {
+        *d = 0;
+    }
+    else
+    {
+        /* Assume all rows have the same number of columns */
+        first_row = PyList_GetItem(py_matrix, 0);
+        if (!PyList_Check(first_row))
+        {
+            return NULL;
+        }
+        *d = PyList_Size(first_row); /* Number of columns */
+    }
+    c_matrix = allocate_matrix(*n, *d);
+    if (c_matrix == NULL)
+    {
+        return NULL;
+    }
+    c_matrix = populate_matrix(py_matrix, c_matrix, n, d);
+    return c_matrix;
+}
+
+/* Helper function to convert a C matrix to a Python list of lists */
+PyObject *c_matrix_to_py_list(const matrix_t *c_matrix)
+{
+    PyObject *py_matrix, *row, *item;
+    const double *c_row;
+    int i, j, n = c_matrix->rows, d = c_matrix->cols;
+    py_matrix = PyList_New(n);
+    if (py_matrix == NULL)
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        row = PyList_New(d);
+        c_row = MATRIX_ROW(c_matrix, i);
+        for (j = 0; j < d; j++)
+        {
+            item = PyFloat_FromDouble(c_row[j]);
+            PyList_SetItem(row, j, item);
+        }
+        PyList_SetItem(py_matrix, i, row);
+    }
+    return py_matrix;
+}
+
+/* Helper function to convert a square Python list of lists holding a symmetric
+ * matrix to packed C storage; only the upper triangle of the list is read
+ */
+packed_matrix_t *py_list_to_c_packed(PyObject *py_matrix, int *n)
+{
+    packed_matrix_t *c_matrix;
+    PyObject *row, *item;
+    double *c_row;
+    int i, j;
+
+    if (!PyList_Check(py_matrix))
+        return NULL;
+    *n = PyList_Size(py_matrix);
+    c_matrix = allocate_packed_matrix(*n);
+    for (i = 0; i < *n; i++)
+    {
+        row = PyList_GetItem(py_matrix, i);
+        if (!PyList_Check(row) || PyList_Size(row) != *n)
+        {
+            free_packed_matrix(c_matrix);
+            return NULL;
+        }
+        c_row = PACKED_ROW(c_matrix, i);
+        for (j = i; j < *n; j++)
+        {
+            item = PyList_GetItem(row, j);
+            if (!PyFloat_Check(item) && !PyLong_Check(item))
+            {
+                free_packed_matrix(c_matrix);
+                return NULL;
+            }
+            c_row[j - i] = PyFloat_AsDouble(item);
+        }
+    }
+    return c_matrix;
+}
+
+/* Helper function to convert a packed symmetric C matrix to a Python list of lists
+ * Elements (i, j) and (j, i) share one float object.
+ */
+PyObject *c_packed_to_py_list(const packed_matrix_t *c_matrix)
+{
+    PyObject *py_matrix, *row, *item;
+    const double *c_row;
+    int i, j, n = c_matrix->n;
+
+    py_matrix = PyList_New(n);
+    if (py_matrix == NULL)
+    {
+        return NULL;
+    }
+    for (i = 0; i < n; i++)
+    {
+        PyList_SetItem(py_matrix, i, PyList_New(n));
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        row = PyList_GetItem(py_matrix, i);
+        c_row = PACKED_ROW(c_matrix, i);
+        for (j = i; j < n; j++)
+        {
+            item = PyFloat_FromDouble(c_row[j - i]);
+            PyList_SetItem(row, j, item);
+            if (j != i)
+            {
+                Py_INCREF(item);
+                PyList_SetItem(PyList_GetItem(py_matrix, j), i, item);
+            }
+        }
+    }
+    return py_matrix;
+}
+
+/* Helper function to convert a diagonal matrix given by its diagonal to a Python list of lists
+ * All off-diagonal entries share one zero float object.
+ */
+PyObject *c_diagonal_to_py_list(const double *diagonal, int n)
+{
+    PyObject *py_matrix, *row, *zero;
+    int i, j;
+
+    py_matrix = PyList_New(n);
+    zero = PyFloat_FromDouble(0.0);
+    if (py_matrix == NULL || zero == NULL)
+    {
+        Py_XDECREF(py_matrix);
+        Py_XDECREF(zero);
+        return NULL;
+    }
+    for (i = 0; i < n; i++)
+    {
+        row = PyList_New(n);
+        for (j = 0; j < n; j++)
+        {
+            if (j == i)
+            {
+                PyList_SetItem(row, j, PyFloat_FromDouble(diagonal[i]));
+            }
+            else
+            {
+                Py_INCREF(zero);
+                PyList_SetItem(row, j, zero);
+            }
+        }
+        PyList_SetItem(py_matrix, i, row);
+    }
+    Py_DECREF(zero);
+    return py_matrix;
+}
+
+/* Python object owning a C matrix and exporting it through the buffer protocol
+ * (a 2-D float64 buffer, so numpy.asarray wraps it without copying)
+ */
+typedef struct
+{
+    PyObject_HEAD
+    matrix_t *matrix;       /* The owned matrix */
+    Py_ssize_t shape[2];    /* (rows, cols) */
+    Py_ssize_t strides[2];  /* Row and element strides in bytes */
+} MatrixObject;
+
+/* The Matrix type, created when the module is initialized */
+static PyObject *matrix_type = NULL;
+
+/* Matrix deallocator: frees the owned C matrix */
+static void Matrix_dealloc(PyObject *self)
+{
+    PyTypeObject *type = Py_TYPE(self);
+
+    free_matrix(((MatrixObject *)self)->matrix);
+    type->tp_free(self);
+    Py_DECREF(type);
+}
+
+/* Buffer export: rows may be padded, so only strided requests are served */
+static int Matrix_getbuffer(PyObject *self, Py_buffer *view, int flags)
+{
+    MatrixObject *object = (MatrixObject *)self;
+    matrix_t *matrix = object->matrix;
+
+    int contiguous = matrix->stride == matrix->cols || matrix->rows <= 1;
+
+    /* Without strides (or when contiguity is requested) the rows must not be padded */
+    if (!contiguous && ((flags & PyBUF_STRIDES) != PyBUF_STRIDES ||
+                        (flags & (PyBUF_C_CONTIGUOUS | PyBUF_F_CONTIGUOUS | PyBUF_ANY_CONTIGUOUS) & ~PyBUF_STRIDES)))
+    {
+        PyErr_SetString(PyExc_BufferError, "Matrix rows are padded; request a strided buffer");
+        return -1;
+    }
+    if ((flags & PyBUF_F_CONTIGUOUS) == PyBUF_F_CONTIGUOUS && (flags & PyBUF_ANY_CONTIGUOUS) != PyBUF_ANY_CONTIGUOUS &&
+        matrix->rows > 1 && matrix->cols > 1)
+    {
+        PyErr_SetString(PyExc_BufferError, "Matrix is row-major, not Fortran-contiguous");
+        return -1;
+    }
+
+    view->obj = self;
+    Py_INCREF(self);
+    view->buf = matrix->data;
+    view->len = object->shape[0] * object->shape[1] * (Py_ssize_t)sizeof(double);
+    view->readonly = 0;
+    view->itemsize = sizeof(double);
+    view->format = (flags & PyBUF_FORMAT) ? "d" : NULL;
+    view->ndim = (flags & PyBUF_ND) ? 2 : 1;
+    view->shape = (flags & PyBUF_ND) ? object->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? object->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+/* Matrix.tolist(): the matrix as a Python list of lists */
+static PyObject *Matrix_tolist(PyObject *self, PyObject *unused)
+{
+    return c_matrix_to_py_list(((MatrixObject *)self)->matrix);
+}
+
+/* Matrix.shape: the (rows, cols) tuple */
+static PyObject *Matrix_shape(PyObject *self, void *closure)
+{
+    return Py_BuildValue("(nn)", ((MatrixObject *)self)->shape[0], ((MatrixObject *)self)->shape[1]);
+}
+
+static PyMethodDef matrix_methods[] = {
+    {"tolist", Matrix_tolist, METH_NOARGS, "Returns the matrix as a list of lists."},
+    {NULL, NULL, 0, NULL} /* Sentinel */
+};
+
+static PyGetSetDef matrix_getset[] = {
+    {"shape", Matrix_shape, NULL, "The (rows, cols) of the matrix.", NULL},
+    {NULL, NULL, NULL, NULL, NULL} /* Sentinel */
+};
+
+static PyType_Slot matrix_type_slots[] = {
+    {Py_tp_dealloc, (void *)Matrix_dealloc},
+    {Py_tp_methods, matrix_methods},
+    {Py_tp_getset, matrix_getset},
+    {Py_bf_getbuffer, (void *)Matrix_getbuffer},
+    {Py_tp_doc, "Matrix of float64 values exported through the buffer protocol."},
+    {0, NULL} /* Sentinel */
+};
+
+static PyType_Spec matrix_type_spec = {
+    "symnmfmodule.Matrix", /* name of the type */
+    sizeof(MatrixObject),  /* size of the instances */
+    0,                     /* size of the items (not variable-sized) */
+    Py_TPFLAGS_DEFAULT,    /* flags */
+    matrix_type_slots};
+
+/* Helper function to wrap a C matrix in a Matrix object, which takes ownership of it */
+PyObject *c_matrix_to_py_buffer(matrix_t *c_matrix)
+{
+    MatrixObject *object;
+
+    object = PyObject_New(MatrixObject, (PyTypeObject *)matrix_type);
+    if (object == NULL)
+    {
+        free_matrix(c_matrix);
+        return NULL;
+    }
+    object->matrix = c_matrix;
+    object->shape[0] = c_matrix->rows;
+    object->shape[1] = c_matrix->cols;
+    object->strides[0] = (Py_ssize_t)c_matrix->stride * (Py_ssize_t)sizeof(double);
+    object->strides[1] = sizeof(double);
+    return (PyObject *)object;
+}
+
+/* Helper function to convert a C matrix to the kind of Python object the input was
+ * A Matrix buffer object (taking ownership) when as_buffer is set, otherwise a
+ * list of lists (and the C matrix is freed).
+ */
+PyObject *c_matrix_to_py_object(matrix_t *c_matrix, int as_buffer)
+{
+    PyObject *py_matrix;
+
+    if (as_buffer)
+        return c_matrix_to_py_buffer(c_matrix);
+    py_matrix = c_matrix_to_py_list(c_matrix);
+    free_matrix(c_matrix);
+    return py_matrix;
+}
+
+/* Helper function to check that a buffer holds a 2-D float64 matrix with contiguous rows */
+static int is_matrix_buffer(const Py_buffer *view)
+{
+    const char *format = view->format;
+
+    if (format != NULL && (format[0] == '@' || format[0] == '=' || format[0] == '<'))
+        format++;
+    return view->ndim == 2 && view->itemsize == sizeof(double) && format != NULL && strcmp(format, "d") == 0 &&
+           view->suboffsets == NULL && view->strides[1] == (Py_ssize_t)sizeof(double) &&
+           view->strides[0] % (Py_ssize_t)sizeof(double) == 0 && view->strides[0] >= view->shape[1] * view->strides[1] &&
+           view->shape[0] <= INT_MAX && view->shape[1] <= INT_MAX && view->strides[0] / (Py_ssize_t)sizeof(double) <= INT_MAX;
+}
+
+/* Helper function to get a C matrix from a Python object
+ * A float64 buffer (e.g. a C-contiguous NumPy array) is used in place without
+ * copying, and the C matrix only describes it; a list of lists is copied.
+ * view: Set up for a buffer; release it with PyBuffer_Release once the matrix is no longer used
+ * Returns: The matrix, to be freed with free_matrix (which leaves a buffer alone), or NULL
+ */
+matrix_t *py_to_c_matrix(PyObject *py_matrix, Py_buffer *view, int *n, int *d)
+{
+    matrix_t *c_matrix;
+
+    view->obj = NULL;
+    if (!PyObject_CheckBuffer(py_matrix))
+        return py_list_to_c_matrix(py_matrix, n, d);
+
+    if (PyObject_GetBuffer(py_matrix, view, PyBUF_STRIDES | PyBUF_FORMAT) != 0)
+        return NULL;
+    if (!is_matrix_buffer(view))
+    {
+        PyBuffer_Release(view);
+        return NULL;
+    }
+
+    c_matrix = (matrix_t *)malloc(sizeof(matrix_t));
+    if (c_matrix == NULL)
+    {
+        PyBuffer_Release(view);
+        return NULL;
+    }
+    *n = (int)view->shape[0];
+    *d = (int)view->shape[1];
+    c_matrix->data = (double *)view->buf;
+    c_matrix->block = NULL; /* Not owned: free_matrix only frees the header */
+    c_matrix->rows = *n;
+    c_matrix->cols = *d;
+    c_matrix->stride = (int)(view->strides[0] / (Py_ssize_t)sizeof(double));
+    return c_matrix;
+}
+
+/* Helper function to release a matrix obtained from py_to_c_matrix */
+void release_c_matrix(matrix_t *c_matrix, Py_buffer *view)
+{
+    free_matrix(c_matrix);
+    PyBuffer_Release(view);
+}
+
+/* Python object owning a similarity matrix in incremental storage (see affinity) */
+typedef struct
+{
+    PyObject_HEAD
+    affinity_matrix_t *affinity; /* The owned matrix */
+    int users;                   /* Calls using it without the GIL: readers (> 0) or the one extending it (-1) */
+} AffinityObject;
+
+/* The Affinity type, created when the module is initialized */
+static PyObject *affinity_type = NULL;
+
+/* Affinity deallocator: frees the owned C matrix */
+static void Affinity_dealloc(PyObject *self)
+{
+    PyTypeObject *type = Py_TYPE(self);
+
+    free_affinity_matrix(((AffinityObject *)self)->affinity);
+    type->tp_free(self);
+    Py_DECREF(type);
+}
+
+/* Helper function to get the C matrix of an Affinity object for a call running without the GIL
+ * Returns: The matrix, to be handed back with release_c_affinity, or NULL if py_affinity
+ *          is not an Affinity or is being extended
+ */
+static affinity_matrix_t *py_to_c_affinity(PyObject *py_affinity)
+{
+    AffinityObject *object;
+
+    if (!PyObject_TypeCheck(py_affinity, (PyTypeObject *)affinity_type))
+        return NULL;
+    object = (AffinityObject *)py_affinity;
+    if (object->users < 0)
+        return NULL;
+    object->users++;
+    return object->affinity;
+}
+
+/* Helper function to hand back the matrix of an Affinity object obtained from py_to_c_affinity */
+static void release_c_affinity(PyObject *py_affinity)
+{
+    ((AffinityObject *)py_affinity)->users--;
+}
+
+/* Affinity.extend(points): appends data points, computing only their affinities (O(n * new points)) */
+static PyObject *Affinity_extend(PyObject *self, PyObject *args)
+{
+    AffinityObject *object = (AffinityObject *)self;
+    PyObject *py_points;
+    Py_buffer view;
+    matrix_t *c_points;
+    int m, d;
+
+    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    if (!PyArg_ParseTuple(args, "O", &py_points))
+        return NULL;
+    /* The matrix moves as it grows, so it must not be in use by another call */
+    if (object->users != 0)
+        return NULL;
+    c_points = py_to_c_matrix(py_points, &view, &m, &d);
+    if (c_points == NULL)
+        return NULL;
+    if (d != object->affinity->points->cols || m > INT_MAX - object->affinity->n)
+    {
+        release_c_matrix(c_points, &view);
+        return NULL;
+    }
+
+    object->users = -1;
+    Py_BEGIN_ALLOW_THREADS
+    extend_affinity_matrix(object->affinity, c_points);
+    Py_END_ALLOW_THREADS
+    object->users = 0;
+    release_c_matrix(c_points, &view);
+    PyErr_Clear();
+    Py_RETURN_NONE;
+}
+
+/* Affinity.norm(): the normalized similarity matrix W as a dense Matrix (O(n^2), for inspection) */
+static PyObject *Affinity_norm(PyObject *self, PyObject *unused)
+{
+    affinity_matrix_t *affinity;
+    PyObject *py_norm;
+
+    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    /* The matrix may be moving under a concurrent extend() */
+    affinity = py_to_c_affinity(self);
+    if (affinity == NULL)
+        return NULL;
+    py_norm = c_matrix_to_py_buffer(unpack_normalized_affinity(affinity));
+    release_c_affinity(self);
+    if (py_norm == NULL)
+        return NULL;
+    PyErr_Clear();
+    return py_norm;
+}
+
+/* Affinity.n: the number of data points */
+static PyObject *Affinity_n(PyObject *self, void *closure)
+{
+    return PyLong_FromLong(((AffinityObject *)self)->affinity->n);
+}
+
+/* Affinity.degrees: the degree vector as a list */
+static PyObject *Affinity_degrees(PyObject *self, void *closure)
+{
+    affinity_matrix_t *affinity;
+    PyObject *py_degrees;
+    int i;
+
+    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    /* The degrees may be moving under a concurrent extend() */
+    affinity = py_to_c_affinity(self);
+    if (affinity == NULL)
+        return NULL;
+    py_degrees = PyList_New(affinity->n);
+    for (i = 0; py_degrees != NULL && i < affinity->n; i++)
+    {
+        PyList_SET_ITEM(py_degrees, i, PyFloat_FromDouble(affinity->degrees[i]));
+    }
+    release_c_affinity(self);
+    if (py_degrees == NULL)
+        return NULL;
+    PyErr_Clear();
+    return py_degrees;
+}
+
+static PyMethodDef affinity_methods[] = {
+    {"extend", Affinity_extend, METH_VARARGS, "Appends data points, computing only their affinities."},
+    {"norm", Affinity_norm, METH_NOARGS, "Returns the normalized similarity matrix as a dense Matrix."},
+    {NULL, NULL, 0, NULL} /* Sentinel */
+};
+
+static PyGetSetDef affinity_getset[] = {
+    {"n", Affinity_n, NULL, "The number of data points.", NULL},
+    {"degrees", Affinity_degrees, NULL, "The degree vector as a list.", NULL},
+    {NULL, NULL, NULL, NULL, NULL} /* Sentinel */
+};
+
+static PyType_Slot affinity_type_slots[] = {
+    {Py_tp_dealloc, (void *)Affinity_dealloc},
+    {Py_tp_methods, affinity_methods},
+    {Py_tp_getset, affinity_getset},
+    {Py_tp_doc, "Similarity matrix and degrees of a growing set of data points (incremental mode)."},
+    {0, NULL} /* Sentinel */
+};
+
+static PyType_Spec affinity_type_spec = {
+    "symnmfmodule.Affinity", /* name of the type */
+    sizeof(AffinityObject),  /* size of the instances */
+    0,                       /* size of the items (not variable-sized) */
+    Py_TPFLAGS_DEFAULT,      /* flags */
+    affinity_type_slots};
+
+/* Helper function to convert a CSR C matrix to a Python tuple (indptr, indices, values) of lists */
+PyObject *c_csr_to_py_tuple(const csr_matrix_t *c_matrix)
+{
+    PyObject *indptr, *indices, *values;
+    size_t e;
+    int i;
+
+    indptr = PyList_New(c_matrix->n + 1);
+    indices = PyList_New((Py_ssize_t)c_matrix->nnz);
+    values = PyList_New((Py_ssize_t)c_matrix->nnz);
+    if (indptr == NULL || indices == NULL || values == NULL)
+    {
+        Py_XDECREF(indptr);
+        Py_XDECREF(indices);
+        Py_XDECREF(values);
+        return NULL;
+    }
+    for (i = 0; i <= c_matrix->n; i++)
+    {
+        PyList_SetItem(indptr, i, PyLong_FromSize_t(c_matrix->row_ptr[i]));
+    }
+    for (e = 0; e < c_matrix->nnz; e++)
+    {
+        PyList_SetItem(indices, (Py_ssize_t)e, PyLong_FromLong(c_matrix->col_idx[e]));
+        PyList_SetItem(values, (Py_ssize_t)e, PyFloat_FromDouble(c_matrix->values[e]));
+    }
+    return Py_BuildValue("(NNN)", indptr, indices, values);
+}
+
+/* Helper function to convert Python lists (indptr, indices, values) to an n x n CSR C matrix
+ * The row pointers must be non-decreasing and every column within range.
+ */
+csr_matrix_t *py_lists_to_c_csr(PyObject *py_indptr, PyObject *py_indices, PyObject *py_values, int n)
+{
+    csr_matrix_t *c_matrix;
+    PyObject *item;
+    Py_ssize_t nnz, e;
+    long value;
+    int i;
+
+    if (!PyList_Check(py_indptr) || !PyList_Check(py_indices) || !PyList_Check(py_values))
+        return NULL;
+    nnz = PyList_Size(py_indices);
+    if (PyList_Size(py_indptr) != (Py_ssize_t)n + 1 || PyList_Size(py_values) != nnz)
+        return NULL;
+
+    c_matrix = allocate_csr_matrix(n, (size_t)nnz);
+    for (i = 0; i <= n; i++)
+    {
+        value = PyLong_AsLong(PyList_GetItem(py_indptr, i));
+        if (value < 0 || value > nnz || (i == 0 && value != 0) || (i > 0 && (size_t)value < c_matrix->row_ptr[i - 1]) ||
+            (i == n && value != nnz))
+        {
+            free_csr_matrix(c_matrix);
+            return NULL;
+        }
+        c_matrix->row_ptr[i] = (size_t)value;
+    }
+    for (e = 0; e < nnz; e++)
+    {
+        value = PyLong_AsLong(PyList_GetItem(py_indices, e));
+        item = PyList_GetItem(py_values, e);
+        if (value < 0 || value >= n || (!PyFloat_Check(item) && !PyLong_Check(item)))
+        {
+            free_csr_matrix(c_matrix);
+            return NULL;
+        }
+        c_matrix->col_idx[e] = (int)value;
+        c_matrix->values[e] = PyFloat_AsDouble(item);
+    }
+    return c_matrix;
+}
+
+/* Helper function to convert run statistics to a Python dict
+ * Stage times in seconds, the iteration count, whether the run converged,
+ * and the per-iteration "deltas" and "objectives" as lists.
+ */
+static PyObject *c_stats_to_py_dict(const symnmf_stats_t *stats)
+{
+    PyObject *py_deltas, *py_objectives, *py_stats;
+    int i, iterations = stats->deltas != NULL ? stats->iterations : 0;
+
+    py_deltas = PyList_New(iterations);
+    py_objectives = PyList_New(iterations);
+    if (py_deltas == NULL || py_objectives == NULL)
+    {
+        Py_XDECREF(py_deltas);
+        Py_XDECREF(py_objectives);
+        return NULL;
+    }
+    for (i = 0; i < iterations; i++)
+    {
+        PyList_SET_ITEM(py_deltas, i, PyFloat_FromDouble(stats->deltas[i]));
+        PyList_SET_ITEM(py_objectives, i, PyFloat_FromDouble(stats->objectives[i]));
+    }
+    py_stats = Py_BuildValue("{s:d,s:d,s:d,s:d,s:i,s:O,s:N,s:N}",
+                             "similarity_seconds", stats->similarity_seconds,
+                             "degree_seconds", stats->degree_seconds,
+                             "normalize_seconds", stats->normalize_seconds,
+                             "optimize_seconds", stats->optimize_seconds,
+                             "iterations", stats->iterations,
+                             "converged", stats->converged ? Py_True : Py_False,
+                             "deltas", py_deltas,
+                             "objectives", py_objectives);
+    return py_stats;
+}
+
+/* Helper function to return a result alone, or as (result, stats dict) when statistics were recorded
+ * The result reference is taken over and the statistics' history is freed.
+ */
+static PyObject *with_stats(PyObject *py_result, symnmf_stats_t *stats)
+{
+    PyObject *py_stats;
+
+    if (stats == NULL || py_result == NULL)
+    {
+        free_stats(stats);
+        return py_result;
+    }
+    py_stats = c_stats_to_py_dict(stats);
+    free_stats(stats);
+    if (py_stats == NULL)
+    {
+        Py_DECREF(py_result);
+        return NULL;
+    }
+    return Py_BuildValue("(NN)", py_result, py_stats);
+}
+
+/* Helper function to read a seed, 0 .. 2^32 - 1 as for numpy.random.seed
+ * Returns: 1 on success, 0 otherwise (with an error that callers replace)
+ */
+static int py_to_seed(PyObject *py_seed, unsigned long *seed)
+{
+    *seed = PyLong_AsUnsignedLong(py_seed);
+    return !((*seed == (unsigned long)-1 && PyErr_Occurred() != NULL) || *seed > 0xffffffffUL);
+}
+
+/* symnmf(H, W, stats=False, epsilon=1e-4, rtol=0, time_budget=0, max_iter=300, beta=0.5, method="multiplicative")
+ * function exposed to Python
+ * With W as a float64 buffer it is used in place as a dense matrix; a list W
+ * is read into packed storage, and an Affinity (see affinity) is normalized
+ * as it is used. H comes back in the same kind as it was given,
+ * or as (H, stats dict) when stats is true (see c_stats_to_py_dict).
+ * The remaining keywords are the solver parameters of solver_options_t, with
+ * the update engine given by name ("multiplicative", "nesterov" or "bcd").
+ */
+static PyObject *symnmf_symnmf(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"H", "W", "stats", "epsilon", "rtol", "time_budget", "max_iter", "beta", "method", NULL};
+    PyObject *py_H, *py_W;
+    Py_buffer H_view, W_view;
+    int n_H, k, n_W, d_W, as_buffer, parsed, want_stats = 0;
+    matrix_t *c_H, *c_W_dense, *final_c_H;
+    packed_matrix_t *c_W;
+    affinity_matrix_t *c_affinity;
+    solver_options_t options;
+    const char *method = NULL;
+    symnmf_stats_t stats, *stats_target = NULL;
+
+    /* Parse arguments: H and W, each a float64 buffer or a list of lists, whether to record statistics
+     * and the solver parameters (before the error is set: keyword parsing fails whenever an error is pending)
+     */
+    default_solver_options(&options);
+    parsed = PyArg_ParseTupleAndKeywords(args, kwargs, "OO|pdddids", kwlist, &py_H, &py_W, &want_stats,
+                                         &options.epsilon, &options.relative_tolerance, &options.time_budget,
+                                         &options.max_iter, &options.beta, &method);
+    /* Set error string in advance */
+    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    if (method != NULL)
+        options.method = solver_method_from_name(method);
+    if (!parsed || !valid_solver_options(&options))
+        return NULL;
+    if (want_stats)
+    {
+        clear_stats(&stats);
+        stats_target = &stats;
+    }
+
+    c_H = py_to_c_matrix(py_H, &H_view, &n_H, &k);
+    if (c_H == NULL)
+        return NULL;
+    as_buffer = H_view.obj != NULL;
+
+    if (PyObject_TypeCheck(py_W, (PyTypeObject *)affinity_type))
+    {
+        /* W normalized from an Affinity as it is used */
+        c_affinity = py_to_c_affinity(py_W);
+        if (c_affinity == NULL || c_affinity->n != n_H)
+        {
+            release_c_matrix(c_H, &H_view);
+            if (c_affinity != NULL)
+                release_c_affinity(py_W);
+            return NULL;
+        }
+        Py_BEGIN_ALLOW_THREADS
+        final_c_H = optimize_h_affinity_options(c_H, c_affinity, &options, stats_target);
+        Py_END_ALLOW_THREADS
+        release_c_affinity(py_W);
+    }
+    else if (PyObject_CheckBuffer(py_W))
+    {
+        /* Dense W straight from the caller's buffer */
+        c_W_dense = py_to_c_matrix(py_W, &W_view, &n_W, &d_W);
+        if (c_W_dense == NULL || n_W != n_H || d_W != n_W)
+        {
+            release_c_matrix(c_H, &H_view);
+            if (c_W_dense != NULL)
+                release_c_matrix(c_W_dense, &W_view);
+            return NULL;
+        }
+        Py_BEGIN_ALLOW_THREADS
+        final_c_H = optimize_h_options(c_H, c_W_dense, &options, stats_target);
+        Py_END_ALLOW_THREADS
+        release_c_matrix(c_W_dense, &W_view);
+    }
+    else
+    {
+        /* W is symmetric, so a list W is packed */
+        c_W = py_list_to_c_packed(py_W, &n_W);
+        if (c_W == NULL || n_W != n_H)
+        {
+            release_c_matrix(c_H, &H_view);
+            free_packed_matrix(c_W);
+            return NULL;
+        }
+        Py_BEGIN_ALLOW_THREADS
+        final_c_H = optimize_h_packed_options(c_H, c_W, &options, stats_target);
+        Py_END_ALLOW_THREADS
+        free_packed_matrix(c_W);
+    }
+
+    /* Free the input H (a copy, or a description of the caller's buffer) */
+    release_c_matrix(c_H, &H_view);
+
+    PyErr_Clear();
+    return with_stats(c_matrix_to_py_object(final_c_H, as_buffer), stats_target);
+}
+
+/* fit(data, k, seed=1234, H=None, w_file=None, panel_rows=0, precision="float64", stats=False,
+ *     epsilon=1e-4, rtol=0, time_budget=0, max_iter=300, beta=0.5, method="multiplicative") function exposed to Python
+ * Runs the whole pipeline in C (W, its mean, the seeded H initialization
+ * and the optimization) and returns only the optimized H, in the same kind
+ * (buffer or list) as data. An explicit initial H replaces the drawn one.
+ * With w_file, W is kept in that memory-mapped file (out-of-core mode) and
+ * streamed in panels of panel_rows rows (0 for the default size).
+ * precision="float32" stores W in single precision (in memory only).
+ * With stats, returns (H, stats dict) with the time of each stage as well.
+ * The solver keywords are as for symnmf.
+ */
+static PyObject *symnmf_fit(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"data", "k", "seed", "H", "w_file", "panel_rows", "precision", "stats",
+                             "epsilon", "rtol", "time_budget", "max_iter", "beta", "method", NULL};
+    PyObject *py_data, *py_seed = NULL, *py_H = Py_None, *py_w_file = Py_None, *py_w_path = NULL;
+    Py_buffer data_view, H_view;
+    unsigned long seed = DEFAULT_SEED;
+    matrix_t *c_data, *c_H = NULL, *final_c_H;
+    const char *precision = "float64";
+    solver_options_t options;
+    const char *method = NULL;
+    symnmf_stats_t stats, *stats_target = NULL;
+    int n, d, k, n_H, k_H, as_buffer, single, want_stats = 0, panel_rows = 0;
+
+    /* Parse arguments: data points, the number of clusters, an optional seed, initial H and W file
+     * (before the error is set: keyword parsing fails whenever an error is pending)
+     */
+    default_solver_options(&options);
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oi|OOOispdddids", kwlist, &py_data, &k, &py_seed, &py_H,
+                                     &py_w_file, &panel_rows, &precision, &want_stats, &options.epsilon,
+                                     &options.relative_tolerance, &options.time_budget, &options.max_iter,
+                                     &options.beta, &method))
+        panel_rows = -1;
+    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    if (method != NULL)
+        options.method = solver_method_from_name(method);
+    if (panel_rows < 0 || !valid_solver_options(&options))
+        return NULL;
+    /* float32 or float64; the out-of-core mode is float64 only */
+    single = strcmp(precision, "float32") == 0;
+    if ((!single && strcmp(precision, "float64") != 0) || (single && py_w_file != Py_None))
+        return NULL;
+    if (want_stats)
+    {
+        clear_stats(&stats);
+        stats_target = &stats;
+    }
+    if (py_seed != NULL && py_seed != Py_None)
+    {
+        if (!py_to_seed(py_seed, &seed))
+        {
+            PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+            return NULL;
+        }
+    }
+
+    c_data = py_to_c_matrix(py_data, &data_view, &n, &d);
+    if (c_data == NULL)
+        return NULL;
+    as_buffer = data_view.obj != NULL;
+    H_view.obj = NULL;
+    if (k < 1 || k > n || d < 1)
+    {
+        release_c_matrix(c_data, &data_view);
+        return NULL;
+    }
+    if (py_H != Py_None)
+    {
+        c_H = py_to_c_matrix(py_H, &H_view, &n_H, &k_H);
+        if (c_H == NULL || n_H != n || k_H != k)
+        {
+            release_c_matrix(c_data, &data_view);
+            if (c_H != NULL)
+                release_c_matrix(c_H, &H_view);
+            return NULL;
+        }
+    }
+
+    if (py_w_file != Py_None && !PyUnicode_FSConverter(py_w_file, &py_w_path))
+    {
+        release_c_matrix(c_data, &data_view);
+        if (c_H != NULL)
+            release_c_matrix(c_H, &H_view);
+        PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    if (py_w_path != NULL)
+        final_c_H = symnmf_from_data_mapped(c_data, k, seed, c_H, PyBytes_AS_STRING(py_w_path), panel_rows,
+                                            &options, stats_target);
+    else if (single)
+        final_c_H = symnmf_from_data_f32(c_data, k, seed, c_H, &options, stats_target);
+    else
+        final_c_H = symnmf_from_data(c_data, k, seed, c_H, &options, stats_target);
+    Py_END_ALLOW_THREADS
+
+    release_c_matrix(c_data, &data_view);
+    if (c_H != NULL)
+        release_c_matrix(c_H, &H_view);
+    Py_XDECREF(py_w_path);
+    if (final_c_H == NULL)
+        return NULL; /* The W file could not be created */
+    PyErr_Clear();
+    return with_stats(c_matrix_to_py_object(final_c_H, as_buffer), stats_target);
+}
+
+/* Helper function to convert the results of a batch to a Python list of (H, objective, iterations) tuples
+ * Each H is converted as c_matrix_to_py_object does (as_buffer per member) and taken over.
+ */
+static PyObject *c_batch_to_py_list(matrix_t **final_H, const double *objectives, const int *iterations, int count,
+                                    const int *as_buffer)
+{
+    PyObject *py_results, *py_H;
+    int m;
+
+    py_results = PyList_New(count);
+    for (m = 0; m < count; m++)
+    {
+        py_H = py_results != NULL ? c_matrix_to_py_object(final_H[m], as_buffer[m]) : NULL;
+        if (py_H == NULL)
+        {
+            if (py_results == NULL)
+                free_matrix(final_H[m]);
+            Py_CLEAR(py_results);
+            continue;
+        }
+        PyList_SET_ITEM(py_results, m, Py_BuildValue("(Ndi)", py_H, objectives[m], iterations[m]));
+    }
+    return py_results;
+}
+
+/* Helper function to allocate the output arrays of a batch of count members
+ * Returns: 1 on success, 0 (with nothing allocated) otherwise
+ */
+static int allocate_batch_outputs(int count, matrix_t ***final_H, double **objectives, int **iterations,
+                                  int **as_buffer)
+{
+    *final_H = (matrix_t **)malloc((size_t)count * sizeof(matrix_t *));
+    *objectives = (double *)malloc((size_t)count * sizeof(double));
+    *iterations = (int *)malloc((size_t)count * sizeof(int));
+    *as_buffer = (int *)malloc((size_t)count * sizeof(int));
+    if (*final_H == NULL || *objectives == NULL || *iterations == NULL || *as_buffer == NULL)
+    {
+        free(*final_H);
+        free(*objectives);
+        free(*iterations);
+        free(*as_buffer);
+        return 0;
+    }
+    return 1;
+}
+
+/* Helper function to free the output arrays of a batch (the matrices themselves are taken over elsewhere) */
+static void free_batch_outputs(matrix_t **final_H, double *objectives, int *iterations, int *as_buffer)
+{
+    free(final_H);
+    free(objectives);
+    free(iterations);
+    free(as_buffer);
+}
+
+/* symnmf_batch(Hs, W, epsilon=1e-4, rtol=0, time_budget=0, max_iter=300, beta=0.5, method="multiplicative")
+ * function exposed to Python
+ * Optimizes every H of the list Hs (same n, any k) against the one W, with a
+ * single wide W * [H_1 H_2 ...] product per iteration (see optimize_h_batch).
+ * W is taken as for symnmf. Returns a list of (H, objective, iterations),
+ * one per member in order, each H in the same kind as it was given, and the
+ * objective ||W - H H^T||_F. The keywords are as for symnmf.
+ */
+static PyObject *symnmf_symnmf_batch(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"Hs", "W", "epsilon", "rtol", "time_budget", "max_iter", "beta", "method", NULL};
+    PyObject *py_Hs, *py_W, *py_results = NULL;
+    Py_buffer *H_views = NULL, W_view;
+    matrix_t **c_Hs = NULL, **final_c_H, *c_W_dense = NULL;
+    packed_matrix_t *c_W = NULL;
+    double *objectives;
+    solver_options_t options;
+    const char *method = NULL;
+    int *iterations, *as_buffer, count, m, n_H, k, n_W = -1, d_W, parsed, loaded = 0, valid = 1;
+
+    /* Parse arguments: the list of H, W and the solver parameters (before the error is set) */
+    default_solver_options(&options);
+    parsed = PyArg_ParseTupleAndKeywords(args, kwargs, "OO|dddids", kwlist, &py_Hs, &py_W, &options.epsilon,
+                                         &options.relative_tolerance, &options.time_budget, &options.max_iter,
+                                         &options.beta, &method);
+    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    if (method != NULL)
+        options.method = solver_method_from_name(method);
+    if (!parsed || !valid_solver_options(&options) || !PyList_Check(py_Hs) || PyList_Size(py_Hs) < 1 ||
+        PyList_Size(py_Hs) > INT_MAX)
+        return NULL;
+    count = (int)PyList_Size(py_Hs);
+    if (!allocate_batch_outputs(count, &final_c_H, &objectives, &iterations, &as_buffer))
+        return NULL;
+    c_Hs = (matrix_t **)malloc((size_t)count * sizeof(matrix_t *));
+    H_views = (Py_buffer *)malloc((size_t)count * sizeof(Py_buffer));
+    if (c_Hs == NULL || H_views == NULL)
+        valid = 0;
+
+    /* W first, for its size */
+    if (valid && PyObject_CheckBuffer(py_W))
+    {
+        c_W_dense = py_to_c_matrix(py_W, &W_view, &n_W, &d_W);
+        valid = c_W_dense != NULL && d_W == n_W;
+    }
+    else if (valid)
+    {
+        c_W = py_list_to_c_packed(py_W, &n_W);
+        valid = c_W != NULL;
+    }
+    for (m = 0; valid && m < count; m++)
+    {
+        c_Hs[m] = py_to_c_matrix(PyList_GET_ITEM(py_Hs, m), &H_views[m], &n_H, &k);
+        if (c_Hs[m] == NULL)
+            break;
+        loaded++;
+        as_buffer[m] = H_views[m].obj != NULL;
+        valid = n_H == n_W && k >= 1;
+    }
+    valid = valid && loaded == count;
+
+    if (valid)
+    {
+        Py_BEGIN_ALLOW_THREADS
+        if (c_W_dense != NULL)
+            optimize_h_batch_dense((const matrix_t *const *)c_Hs, count, c_W_dense, &options, final_c_H, objectives,
+                                   iterations);
+        else
+            optimize_h_packed_batch((const matrix_t *const *)c_Hs, count, c_W, &options, final_c_H, objectives,
+                                    iterations);
+        Py_END_ALLOW_THREADS
+    }
+
+    for (m = 0; m < loaded; m++)
+    {
+        release_c_matrix(c_Hs[m], &H_views[m]);
+    }
+    if (c_W_dense != NULL)
+        release_c_matrix(c_W_dense, &W_view);
+    free_packed_matrix(c_W);
+    free(c_Hs);
+    free(H_views);
+    if (valid)
+    {
+        PyErr_Clear();
+        py_results = c_batch_to_py_list(final_c_H, objectives, iterations, count, as_buffer);
+    }
+    free_batch_outputs(final_c_H, objectives, iterations, as_buffer);
+    return py_results;
+}
+
+/* fit_batch(data, ks, seeds=None, precision="float64", epsilon=1e-4, rtol=0, time_budget=0, max_iter=300, beta=0.5,
+ *           method="multiplicative") function exposed to Python
+ * Runs fit for every k of the list ks with every seed of the list seeds
+ * (the default seed alone when None), building W once and solving all the
+ * members together (see symnmf_batch_from_data). Returns a list of
+ * (H, objective, iterations) ordered by k, then seed, each H in the same kind
+ * as data; a member matches fit(data, k, seed) with the same keywords.
+ */
+static PyObject *symnmf_fit_batch(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"data", "ks", "seeds", "precision",
+                             "epsilon", "rtol", "time_budget", "max_iter", "beta", "method", NULL};
+    PyObject *py_data, *py_ks, *py_seeds = Py_None, *py_results = NULL;
+    Py_buffer data_view;
+    matrix_t *c_data, **final_c_H;
+    const char *precision = "float64";
+    double *objectives;
+    solver_options_t options;
+    const char *method = NULL;
+    unsigned long *seeds, *member_seeds;
+    int *ks, *member_ks, *iterations, *as_buffer, n, d, k_count, seed_count, count, i, j, parsed, single, valid = 1;
+
+    /* Parse arguments: data points, the list of k, the list of seeds and the keywords (before the error is set) */
+    default_solver_options(&options);
+    parsed = PyArg_ParseTupleAndKeywords(args, kwargs, "OO|Osdddids", kwlist, &py_data, &py_ks, &py_seeds, &precision,
+                                         &options.epsilon, &options.relative_tolerance, &options.time_budget,
+                                         &options.max_iter, &options.beta, &method);
+    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    if (method != NULL)
+        options.method = solver_method_from_name(method);
+    if (!parsed || !valid_solver_options(&options) || !PyList_Check(py_ks) ||
+        (py_seeds != Py_None && !PyList_Check(py_seeds)))
+        return NULL;
+    single = strcmp(precision, "float32") == 0;
+    if (!single && strcmp(precision, "float64") != 0)
+        return NULL;
+    k_count = (int)PyList_Size(py_ks);
+    seed_count = py_seeds != Py_None ? (int)PyList_Size(py_seeds) : 1;
+    if (k_count < 1 || seed_count < 1 || PyList_Size(py_ks) > INT_MAX / seed_count)
+        return NULL;
+    count = k_count * seed_count;
+
+    c_data = py_to_c_matrix(py_data, &data_view, &n, &d);
+    if (c_data == NULL)
+        return NULL;
+    if (d < 1 || !allocate_batch_outputs(count, &final_c_H, &objectives, &iterations, &as_buffer))
+    {
+        release_c_matrix(c_data, &data_view);
+        return NULL;
+    }
+    ks = (int *)malloc((size_t)k_count * sizeof(int));
+    seeds = (unsigned long *)malloc((size_t)seed_count * sizeof(unsigned long));
+    member_ks = (int *)malloc((size_t)count * sizeof(int));
+    member_seeds = (unsigned long *)malloc((size_t)count * sizeof(unsigned long));
+    valid = ks != NULL && seeds != NULL && member_ks != NULL && member_seeds != NULL;
+
+    /* Every k in 1 .. n, every seed in range (the conversions report through the error indicator) */
+    PyErr_Clear();
+    for (i = 0; valid && i < k_count; i++)
+    {
+        ks[i] = (int)PyLong_AsLong(PyList_GET_ITEM(py_ks, i));
+        valid = ks[i] >= 1 && ks[i] <= n && PyErr_Occurred() == NULL;
+        PyErr_Clear();
+    }
+    seeds[0] = DEFAULT_SEED;
+    for (j = 0; valid && py_seeds != Py_None && j < seed_count; j++)
+    {
+        valid = py_to_seed(PyList_GET_ITEM(py_seeds, j), &seeds[j]);
+        PyErr_Clear();
+    }
+    for (i = 0; valid && i < k_count; i++)
+    {
+        for (j = 0; j < seed_count; j++)
+        {
+            member_ks[i * seed_count + j] = ks[i];
+            member_seeds[i * seed_count + j] = seeds[j];
+            as_buffer[i * seed_count + j] = data_view.obj != NULL;
+        }
+    }
+
+    if (valid)
+    {
+        Py_BEGIN_ALLOW_THREADS
+        if (single)
+            symnmf_batch_from_data_f32(c_data, count, member_ks, member_seeds, &options, final_c_H, objectives,
+                                       iterations);
+        else
+            symnmf_batch_from_data(c_data, count, member_ks, member_seeds, &options, final_c_H, objectives,
+                                   iterations);
+        Py_END_ALLOW_THREADS
+        py_results = c_batch_to_py_list(final_c_H, objectives, iterations, count, as_buffer);
+    }
+    else
+    {
+        PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    }
+
+    release_c_matrix(c_data, &data_view);
+    free(ks);
+    free(seeds);
+    free(member_ks);
+    free(member_seeds);
+    free_batch_outputs(final_c_H, objectives, iterations, as_buffer);
+    return py_results;
+}
+
+/* kmeans(data, k, iters=200, epsilon=0.001) function exposed to Python
+ * Clusters the data points as kmeans.fit does (the first k points as the
+ * initial centroids, the same stopping rule and the same labels) and
+ * returns (centroids, labels): the centroids in the same kind (buffer or
+ * list) as data and the labels as a list of cluster indices.
+ */
+static PyObject *symnmf_kmeans(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"data", "k", "iters", "epsilon", NULL};
+    PyObject *py_data, *py_labels;
+    Py_buffer view;
+    matrix_t *c_data, *centroids;
+    double epsilon = KMEANS_EPSILON;
+    int *labels, n, d, k, i, as_buffer, parsed, max_iter = KMEANS_MAX_ITER;
+
+    /* Parse arguments: data points, the number of clusters and the stopping rule (before the error is set) */
+    parsed = PyArg_ParseTupleAndKeywords(args, kwargs, "Oi|id", kwlist, &py_data, &k, &max_iter, &epsilon);
+    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    if (!parsed || max_iter < 0 || !(epsilon >= 0.0))
+        return NULL;
+
+    c_data = py_to_c_matrix(py_data, &view, &n, &d);
+    if (c_data == NULL)
+        return NULL;
+    as_buffer = view.obj != NULL;
+    labels = k >= 1 && k <= n && d >= 1 ? (int *)malloc((size_t)n * sizeof(int)) : NULL;
+    if (labels == NULL)
+    {
+        release_c_matrix(c_data, &view);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    centroids = kmeans(c_data, k, max_iter, epsilon, labels, NULL);
+    Py_END_ALLOW_THREADS
+    release_c_matrix(c_data, &view);
+
+    py_labels = PyList_New(n);
+    for (i = 0; py_labels != NULL && i < n; i++)
+    {
+        PyList_SET_ITEM(py_labels, i, PyLong_FromLong(labels[i]));
+    }
+    free(labels);
+    if (py_labels == NULL)
+    {
+        free_matrix(centroids);
+        return NULL;
+    }
+    PyErr_Clear();
+    return Py_BuildValue("(NN)", c_matrix_to_py_object(centroids, as_buffer), py_labels);
+}
+
+/* affinity(data) function exposed to Python
+ * Incremental mode: builds the similarity matrix and degrees of the data
+ * points as an Affinity object, which extend(points) grows by appended points
+ * and symnmf takes as W (normalized as it is used). Pair it with extend_h.
+ */
+static PyObject *symnmf_affinity(PyObject *self, PyObject *args)
+{
+    PyObject *py_data;
+    Py_buffer view;
+    AffinityObject *object;
+    matrix_t *c_data;
+    affinity_matrix_t *affinity;
+    int n, d;
+
+    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    if (!PyArg_ParseTuple(args, "O", &py_data))
+        return NULL;
+    c_data = py_to_c_matrix(py_data, &view, &n, &d);
+    if (c_data == NULL)
+        return NULL;
+    Py_BEGIN_ALLOW_THREADS
+    affinity = calculate_affinity_matrix(c_data);
+    Py_END_ALLOW_THREADS
+    release_c_matrix(c_data, &view);
+
+    object = PyObject_New(AffinityObject, (PyTypeObject *)affinity_type);
+    if (object == NULL)
+    {
+        free_affinity_matrix(affinity);
+        return NULL;
+    }
+    object->affinity = affinity;
+    object->users = 0;
+    PyErr_Clear();
+    return (PyObject *)object;
+}
+
+/* extend_h(H, affinity) function exposed to Python
+ * Extends the H of the first n0 points to all the n points of an Affinity
+ * that has since been extended, as a warm start for symnmf; H comes back in
+ * the same kind as it was given.
+ */
+static PyObject *symnmf_extend_h(PyObject *self, PyObject *args)
+{
+    PyObject *py_H, *py_affinity;
+    Py_buffer H_view;
+    matrix_t *c_H, *extended = NULL;
+    affinity_matrix_t *c_affinity;
+    int n_H, k, as_buffer;
+
+    /* Set error string in advance */
+    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    if (!PyArg_ParseTuple(args, "OO", &py_H, &py_affinity))
+        return NULL;
+    c_H = py_to_c_matrix(py_H, &H_view, &n_H, &k);
+    if (c_H == NULL)
+        return NULL;
+    as_buffer = H_view.obj != NULL;
+    c_affinity = py_to_c_affinity(py_affinity);
+    if (c_affinity != NULL)
+    {
+        if (n_H >= 1 && n_H <= c_affinity->n && k >= 1)
+        {
+            Py_BEGIN_ALLOW_THREADS
+            extended = extend_h(c_H, c_affinity);
+            Py_END_ALLOW_THREADS
+        }
+        release_c_affinity(py_affinity);
+    }
+    release_c_matrix(c_H, &H_view);
+    if (extended == NULL)
+        return NULL;
+    PyErr_Clear();
+    return c_matrix_to_py_object(extended, as_buffer);
+}
+
+/* Helper function to convert a Python sequence of n non-negative cluster indices (e.g. a NumPy array) to C
+ * clusters: Set to the largest label plus one
+ * Returns: The labels, to be released with free, or NULL
+ */
+static int *py_to_c_labels(PyObject *py_labels, int n, int *clusters)
+{
+    PyObject *py_sequence;
+    int *labels;
+    long value;
+    Py_ssize_t i;
+
+    py_sequence = PySequence_Fast(py_labels, "An Error Has Occurred");
+    if (py_sequence == NULL)
+        return NULL;
+    labels = PySequence_Fast_GET_SIZE(py_sequence) == n ? (int *)malloc((size_t)(n > 0 ? n : 1) * sizeof(int)) : NULL;
+    *clusters = 0;
+    for (i = 0; labels != NULL && i < n; i++)
+    {
+        value = PyLong_AsLong(PySequence_Fast_GET_ITEM(py_sequence, i));
+        if (value < 0 || value >= n)
+        {
+            free(labels);
+            labels = NULL;
+            break;
+        }
+        labels[i] = (int)value;
+        if (labels[i] >= *clusters)
+            *clusters = labels[i] + 1;
+    }
+    Py_DECREF(py_sequence);
+    return labels;
+}
+
+/* silhouette(data, labelings) function exposed to Python
+ * Scores every labeling of the list labelings (each a sequence of cluster
+ * indices 0 .. n - 1 per point, e.g. from kmeans or the argmax of H) with
+ * one pass over the pairwise distances, and returns the list of scores, as
+ * sklearn.metrics.silhouette_score gives them. Every labeling must use
+ * between 2 and n - 1 clusters.
+ */
+static PyObject *symnmf_silhouette(PyObject *self, PyObject *args)
+{
+    PyObject *py_data, *py_labelings, *py_scores = NULL;
+    Py_buffer view;
+    matrix_t *c_data;
+    int **labelings;
+    int *clusters;
+    double *scores;
+    int n, d, count, m, loaded = 0, valid;
+
+    /* Parse arguments: data points and the list of labelings */
+    if (!PyArg_ParseTuple(args, "OO", &py_data, &py_labelings) || !PyList_Check(py_labelings) ||
+        PyList_Size(py_labelings) > INT_MAX)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+        return NULL;
+    }
+    count = (int)PyList_Size(py_labelings);
+
+    c_data = py_to_c_matrix(py_data, &view, &n, &d);
+    if (c_data == NULL)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+        return NULL;
+    }
+    labelings = (int **)malloc((size_t)(count > 0 ? count : 1) * sizeof(int *));
+    clusters = (int *)malloc((size_t)(count > 0 ? count : 1) * sizeof(int));
+    scores = (double *)malloc((size_t)(count > 0 ? count : 1) * sizeof(double));
+    valid = labelings != NULL && clusters != NULL && scores != NULL && d >= 1;
+    for (m = 0; valid && m < count; m++)
+    {
+        labelings[m] = py_to_c_labels(PyList_GET_ITEM(py_labelings, m), n, &clusters[m]);
+        valid = labelings[m] != NULL;
+        if (valid)
+        {
+            loaded++;
+            valid = valid_labeling(labelings[m], n, clusters[m]);
+        }
+    }
+
+    if (valid)
+    {
+        Py_BEGIN_ALLOW_THREADS
+        silhouette_scores(c_data, (const int *const *)labelings, clusters, count, scores);
+        Py_END_ALLOW_THREADS
+        py_scores = PyList_New(count);
+        for (m = 0; py_scores != NULL && m < count; m++)
+        {
+            PyList_SET_ITEM(py_scores, m, PyFloat_FromDouble(scores[m]));
+        }
+    }
+    else
+    {
+        PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    }
+
+    release_c_matrix(c_data, &view);
+    for (m = 0; m < loaded; m++)
+    {
+        free(labelings[m]);
+    }
+    free(labelings);
+    free(clusters);
+    free(scores);
+    return py_scores;
+}
+
+/* sym(data) function exposed to Python
+ * Buffer input gives a dense Matrix result, list input a list of lists.
+ */
+static PyObject *symnmf_sym(PyObject *self, PyObject *args)
+{
+    PyObject *py_data, *py_similarity_matrix;
+    Py_buffer view;
+    matrix_t *c_data, *dense_matrix = NULL;
+    packed_matrix_t *similarity_matrix = NULL;
+    int n, d;
+
+    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    /* Parse arguments: the data points */
+    if (!PyArg_ParseTuple(args, "O", &py_data))
+        return NULL;
+
+    c_data = py_to_c_matrix(py_data, &view, &n, &d);
+    if (c_data == NULL)
+        return NULL;
+
+    /* Calculate the similarity matrix: dense for a buffer result, packed for a list */
+    Py_BEGIN_ALLOW_THREADS
+    if (view.obj != NULL)
+        dense_matrix = calculate_similarity_matrix(c_data);
+    else
+        similarity_matrix = calculate_packed_similarity_matrix(c_data);
+    Py_END_ALLOW_THREADS
+
+    /* Free the input data matrix */
+    release_c_matrix(c_data, &view);
+
+    if (dense_matrix != NULL)
+    {
+        /* Dense result handed over as a buffer */
+        PyErr_Clear();
+        return c_matrix_to_py_buffer(dense_matrix);
+    }
+
+    /* Convert the result back to a Python list of lists */
+    py_similarity_matrix = c_packed_to_py_list(similarity_matrix);
+
+    /* Free the result C matrix */
+    free_packed_matrix(similarity_matrix);
+    PyErr_Clear();
+    return py_similarity_matrix;
+}
+
+/* ddg(data) function exposed to Python
+ * Buffer input gives a dense Matrix result, list input a list of lists.
+ */
+static PyObject *symnmf_ddg(PyObject *self, PyObject *args)
+{
+    PyObject *py_data, *py_ddg_matrix;
+    Py_buffer view;
+    matrix_t *c_data, *ddg_matrix = NULL;
+    packed_matrix_t *similarity_matrix;
+    double *degrees;
+    int i, n, d;
+
+    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    /* Parse arguments: the data points */
+    if (!PyArg_ParseTuple(args, "O", &py_data))
+        return NULL;
+
+    c_data = py_to_c_matrix(py_data, &view, &n, &d);
+    if (c_data == NULL)
+        return NULL;
+
+    Py_BEGIN_ALLOW_THREADS
+    /* Calculate the similarity matrix (needed for DDG) */
+    similarity_matrix = calculate_packed_similarity_matrix(c_data);
+
+    /* Calculate the degrees (the diagonal of the DDG) */
+    degrees = calculate_packed_degree_vector(similarity_matrix);
+    /* Free the intermediate similarity matrix */
+    free_packed_matrix(similarity_matrix);
+
+    if (view.obj != NULL)
+    {
+        /* Dense diagonal matrix for a buffer result */
+        ddg_matrix = allocate_matrix(n, n);
+        for (i = 0; i < n; i++)
+        {
+            MATRIX_AT(ddg_matrix, i, i) = degrees[i];
+        }
+    }
+    Py_END_ALLOW_THREADS
+
+    if (ddg_matrix != NULL)
+    {
+        py_ddg_matrix = c_matrix_to_py_buffer(ddg_matrix);
+    }
+    else
+    {
+        /* Convert the diagonal matrix to a Python list of lists */
+        py_ddg_matrix = c_diagonal_to_py_list(degrees, n);
+    }
+    release_c_matrix(c_data, &view);
+    free(degrees);
+    PyErr_Clear();
+    return py_ddg_matrix;
+}
+
+/* norm(data) function exposed to Python
+ * Buffer input gives a dense Matrix result, list input a list of lists.
+ */
+static PyObject *symnmf_norm(PyObject *self, PyObject *args)
+{
+    PyObject *py_data, *py_normalized_matrix;
+    Py_buffer view;
+    int n, d;
+    matrix_t *c_data, *dense_matrix = NULL;
+    packed_matrix_t *similarity_matrix = NULL;
+    double *degrees;
+
+    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    /* Parse arguments: the data points */
+    if (!PyArg_ParseTuple(args, "O", &py_data))
+        return NULL;
+    c_data = py_to_c_matrix(py_data, &view, &n, &d);
+    if (c_data == NULL)
+        return NULL;
+
+    Py_BEGIN_ALLOW_THREADS
+    if (view.obj != NULL)
+    {
+        /* Dense result (for a buffer), normalized in place */
+        dense_matrix = calculate_similarity_matrix(c_data);
+        degrees = calculate_degree_vector(dense_matrix);
+        normalize_similarity_matrix(dense_matrix, degrees);
+    }
+    else
+    {
+        /* Calculate the similarity matrix, the degree vector and normalize in place */
+        similarity_matrix = calculate_packed_similarity_matrix(c_data);
+        degrees = calculate_packed_degree_vector(similarity_matrix);
+        normalize_packed_similarity_matrix(similarity_matrix, degrees);
+    }
+    free(degrees);
+    Py_END_ALLOW_THREADS
+
+    /* Free the input data matrix */
+    release_c_matrix(c_data, &view);
+
+    if (dense_matrix != NULL)
+    {
+        /* Dense result handed over as a buffer */
+        PyErr_Clear();
+        return c_matrix_to_py_buffer(dense_matrix);
+    }
+    /* Convert the result back to a Python list of lists */
+    py_normalized_matrix = c_packed_to_py_list(similarity_matrix);
+    /* Free the result C matrix */
+    free_packed_matrix(similarity_matrix);
+    PyErr_Clear();
+    return py_normalized_matrix;
+}
+
+/* knn_norm(data, neighbors, threshold=0.0) function exposed to Python
+ * neighbors = 0 keeps the pairs above threshold only, which must then be positive.
+ */
+static PyObject *symnmf_knn_norm(PyObject *self, PyObject *args)
+{
+    PyObject *py_data, *py_normalized_matrix;
+    Py_buffer view;
+    int n, d, neighbors;
+    double threshold = 0.0;
+    matrix_t *c_data;
+    csr_matrix_t *similarity_matrix;
+    double *degrees;
+
+    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    /* Parse arguments: data points, the number of neighbours and an optional threshold */
+    if (!PyArg_ParseTuple(args, "Oi|d", &py_data, &neighbors, &threshold))
+        return NULL;
+    if (neighbors < 0 || threshold < 0.0 || (neighbors == 0 && threshold <= 0.0))
+        return NULL;
+    c_data = py_to_c_matrix(py_data, &view, &n, &d);
+    if (c_data == NULL)
+        return NULL;
+    /* Reject neighbour counts whose lists could not be sized */
+    if (!sparse_neighbors_fit(n, neighbors))
+    {
+        release_c_matrix(c_data, &view);
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    /* Calculate the sparse similarity matrix */
+    similarity_matrix = calculate_sparse_similarity_matrix(c_data, neighbors, threshold);
+    /* Calculate the degree vector and normalize the similarity matrix in place */
+    degrees = calculate_sparse_degree_vector(similarity_matrix);
+    normalize_sparse_similarity_matrix(similarity_matrix, degrees);
+    free(degrees);
+    Py_END_ALLOW_THREADS
+    /* Free the input data matrix */
+    release_c_matrix(c_data, &view);
+    /* Convert the result to a (indptr, indices, values) tuple */
+    py_normalized_matrix = c_csr_to_py_tuple(similarity_matrix);
+    free_csr_matrix(similarity_matrix);
+    PyErr_Clear();
+    return py_normalized_matrix;
+}
+
+/* symnmf_sparse(H, indptr, indices, values, stats=False, epsilon=1e-4, rtol=0, time_budget=0, max_iter=300, beta=0.5,
+ *               method="multiplicative") function exposed to Python; the keywords are as for symnmf
+ */
+static PyObject *symnmf_symnmf_sparse(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"H", "indptr", "indices", "values", "stats",
+                             "epsilon", "rtol", "time_budget", "max_iter", "beta", "method", NULL};
+    PyObject *py_H, *py_indptr, *py_indices, *py_values;
+    Py_buffer view;
+    int n, k, as_buffer, parsed, want_stats = 0;
+    matrix_t *c_H, *final_c_H;
+    csr_matrix_t *c_W;
+    solver_options_t options;
+    const char *method = NULL;
+    symnmf_stats_t stats, *stats_target = NULL;
+
+    /* Parse arguments: H and the CSR lists of W as returned by knn_norm, then the keywords */
+    default_solver_options(&options);
+    parsed = PyArg_ParseTupleAndKeywords(args, kwargs, "OOOO|pdddids", kwlist, &py_H, &py_indptr, &py_indices,
+                                         &py_values, &want_stats, &options.epsilon, &options.relative_tolerance,
+                                         &options.time_budget, &options.max_iter, &options.beta, &method);
+    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    if (method != NULL)
+        options.method = solver_method_from_name(method);
+    if (!parsed || !valid_solver_options(&options))
+        return NULL;
+    if (want_stats)
+    {
+        clear_stats(&stats);
+        stats_target = &stats;
+    }
+
+    c_H = py_to_c_matrix(py_H, &view, &n, &k);
+    if (c_H == NULL)
+        return NULL;
+    as_buffer = view.obj != NULL;
+    c_W = py_lists_to_c_csr(py_indptr, py_indices, py_values, n);
+    if (c_W == NULL)
+    {
+        release_c_matrix(c_H, &view);
+        return NULL;
+    }
+
+    /* Call the C optimization function */
+    Py_BEGIN_ALLOW_THREADS
+    final_c_H = optimize_h_sparse_options(c_H, c_W, &options, stats_target);
+    Py_END_ALLOW_THREADS
+    release_c_matrix(c_H, &view);
+    free_csr_matrix(c_W);
+
+    /* H comes back in the same kind as it was given */
+    PyErr_Clear();
+    return with_stats(c_matrix_to_py_object(final_c_H, as_buffer), stats_target);
+}
+
+/* load(path) function exposed to Python
+ * Reads a binary matrix file into a Matrix buffer object.
+ */
+static PyObject *symnmf_load(PyObject *self, PyObject *args)
+{
+    PyObject *py_path;
+    matrix_t *c_matrix;
+
+    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    if (!PyArg_ParseTuple(args, "O&", PyUnicode_FSConverter, &py_path))
+        return NULL;
+
+    Py_BEGIN_ALLOW_THREADS
+    c_matrix = load_binary_matrix(PyBytes_AS_STRING(py_path));
+    Py_END_ALLOW_THREADS
+
+    Py_DECREF(py_path);
+    if (c_matrix == NULL)
+        return NULL;
+    PyErr_Clear();
+    return c_matrix_to_py_buffer(c_matrix);
+}
+
+/* save(path, matrix) function exposed to Python
+ * Writes a float64 buffer or a list of lists as a binary matrix file.
+ */
+static PyObject *symnmf_save(PyObject *self, PyObject *args)
+{
+    PyObject *py_path, *py_matrix;
+    Py_buffer view;
+    matrix_t *c_matrix;
+    int n, d, failed;
+
+    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    if (!PyArg_ParseTuple(args, "O&O", PyUnicode_FSConverter, &py_path, &py_matrix))
+        return NULL;
+
+    c_matrix = py_to_c_matrix(py_matrix, &view, &n, &d);
+    if (c_matrix == NULL)
+    {
+        Py_DECREF(py_path);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    failed = save_binary_matrix(PyBytes_AS_STRING(py_path), c_matrix);
+    Py_END_ALLOW_THREADS
+
+    release_c_matrix(c_matrix, &view);
+    Py_DECREF(py_path);
+    if (failed)
+        return NULL;
+    PyErr_Clear();
+    Py_RETURN_NONE;
+}
+
+/* to_text(matrix) function exposed to Python
+ * Formats a matrix as the CLI prints it: one line per row, values to 4 decimal places.
+ */
+static PyObject *symnmf_to_text(PyObject *self, PyObject *args)
+{
+    PyObject *py_matrix, *py_text;
+    Py_buffer view;
+    matrix_t *c_matrix;
+    char *text;
+    size_t length;
+    int n, d;
+
+    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    if (!PyArg_ParseTuple(args, "O", &py_matrix))
+        return NULL;
+
+    c_matrix = py_to_c_matrix(py_matrix, &view, &n, &d);
+    if (c_matrix == NULL)
+        return NULL;
+
+    Py_BEGIN_ALLOW_THREADS
+    text = format_matrix(c_matrix, &length);
+    Py_END_ALLOW_THREADS
+
+    release_c_matrix(c_matrix, &view);
+    py_text = PyUnicode_DecodeASCII(text, (Py_ssize_t)length, NULL);
+    free(text);
+    if (py_text == NULL)
+        return NULL;
+    PyErr_Clear();
+    return py_text;
+}
+
+/* set_threads(n) function exposed to Python */
+static PyObject *symnmf_set_threads(PyObject *self, PyObject *args)
+{
+    int threads;
+
+    PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+    if (!PyArg_ParseTuple(args, "i", &threads) || threads < 1)
+        return NULL;
+    set_thread_count(threads);
+    PyErr_Clear();
+    Py_RETURN_NONE;
+}
+
+/* get_threads() function exposed to Python */
+static PyObject *symnmf_get_threads(PyObject *self, PyObject *args)
+{
+    return PyLong_FromLong(get_thread_count());
+}
+
+/* Method definitions */
+static PyMethodDef symnmf_methods[] = {
+    {"symnmf", (PyCFunction)(void (*)(void))symnmf_symnmf, METH_VARARGS | METH_KEYWORDS,
+     "Performs symNMF optimization."},
+    {"fit", (PyCFunction)(void (*)(void))symnmf_fit, METH_VARARGS | METH_KEYWORDS,
+     "Runs the whole symNMF pipeline on the data points and returns the optimized H."},
+    {"symnmf_batch", (PyCFunction)(void (*)(void))symnmf_symnmf_batch, METH_VARARGS | METH_KEYWORDS,
+     "Performs symNMF optimization of several H against one W."},
+    {"fit_batch", (PyCFunction)(void (*)(void))symnmf_fit_batch, METH_VARARGS | METH_KEYWORDS,
+     "Runs the symNMF pipeline for several k and seeds, building W once."},
+    {"kmeans", (PyCFunction)(void (*)(void))symnmf_kmeans, METH_VARARGS | METH_KEYWORDS,
+     "Clusters the data points with k-means, as kmeans.fit does."},
+    {"silhouette", symnmf_silhouette, METH_VARARGS, "Calculates the silhouette scores of labelings of the data points."},
+    {"affinity", symnmf_affinity, METH_VARARGS,
+     "Calculates the similarity matrix and degrees of the data points as a growable Affinity."},
+    {"extend_h", symnmf_extend_h, METH_VARARGS, "Extends H to appended data points, as a warm start for symnmf."},
+    {"sym", symnmf_sym, METH_VARARGS, "Calculates the similarity matrix."},
+    {"ddg", symnmf_ddg, METH_VARARGS, "Calculates the diagonal degree matrix."},
+    {"norm", symnmf_norm, METH_VARARGS, "Calculates the normalized similarity matrix."},
+    {"knn_norm", symnmf_knn_norm, METH_VARARGS, "Calculates the sparse normalized k-nearest-neighbour similarity matrix."},
+    {"symnmf_sparse", (PyCFunction)(void (*)(void))symnmf_symnmf_sparse, METH_VARARGS | METH_KEYWORDS,
+     "Performs symNMF optimization with a sparse W."},
+    {"load", symnmf_load, METH_VARARGS, "Reads a binary matrix file."},
+    {"save", symnmf_save, METH_VARARGS, "Writes a matrix as a binary matrix file."},
+    {"to_text", symnmf_to_text, METH_VARARGS, "Formats a matrix as text with 4 decimal places."},
+    {"set_threads", symnmf_set_threads, METH_VARARGS, "Sets the number of threads (OpenMP builds only)."},
+    {"get_threads", symnmf_get_threads, METH_NOARGS, "Returns the number of threads used."},
+    {NULL, NULL, 0, NULL} /* Sentinel */
+};
+
+/* Module definition */
+static struct PyModuleDef symnmfmodule = {
+    PyModuleDef_HEAD_INIT,
+    "symnmfmodule", /* name of module */
+    NULL,           /* module documentation, may be NULL */
+    -1,             /* size of per-interpreter state of the module, or -1 if the module keeps state in global variables. */
+    symnmf_methods};
+
+/* Module initialization function */
+PyMODINIT_FUNC PyInit_symnmfmodule(void)
+{
+    PyObject *module;
+
+    module = PyModule_Create(&symnmfmodule);
+    if (module == NULL)
+        return NULL;
+    /* Choose the kernels now, before calls can run in parallel without the GIL */
+    select_kernels();
+    matrix_type = PyType_FromSpec(&matrix_type_spec);
+    if (matrix_type == NULL || PyModule_AddObject(module, "Matrix", matrix_type) != 0)
+    {
+        Py_XDECREF(matrix_type);
+        Py_DECREF(module);
+        return NULL;
+    }
+    Py_INCREF(matrix_type); /* One reference for the module, one kept in matrix_type */
+    affinity_type = PyType_FromSpec(&affinity_type_spec);
+    if (affinity_type == NULL || PyModule_AddObject(module, "Affinity", affinity_type) != 0)
+    {
+        Py_XDECREF(affinity_type);
+        Py_DECREF(module);
+        return NULL;
+    }
+    Py_INCREF(affinity_type); /* One reference for the module, one kept in affinity_type */
+    return module;
+}